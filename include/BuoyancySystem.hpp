@@ -0,0 +1,138 @@
+/** @file BuoyancySystem.hpp
+ *  @brief Box shaped rigid bodies floating on the gerstner waves.
+ *
+ *  Every body samples the exact surface height (SurfaceQuery) above the
+ *  centres of the eight octants of its box. Each octant counts as submerged
+ *  by how far the surface reaches up its vertical extent and pushes up at
+ *  its centre with the weight of the water it displaces, so bodies rise,
+ *  sink and tilt with the waves and right themselves in every orientation.
+ *  Drag scaled by how deep a body sits calms them down. Each hull point
+ *  keeps the wave source it was solved for and starts the next step's
+ *  query from it. On waves steep enough to loop, a cold query picks any of
+ *  the folds above a point and the water under a hull jumps up and down by
+ *  the wave height between steps, which throws bodies out of the water or
+ *  under it; a warm one follows the same fold as the body moves.
+ *
+ *  Body state is stored one array per component. The bodies are updated in
+ *  fixed size batches that JobSystem threads take in turn, each thread with
+ *  its own SurfaceQuery, at a fixed time step so the motion does not depend on
+ *  the frame rate. WriteInstances() packs position, orientation and size
+ *  per body for an instanced draw.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef BUOYANCYSYSTEM_HPP
+#define BUOYANCYSYSTEM_HPP
+
+#include "SurfaceQuery.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <vector>
+
+struct BuoyancySettings{
+    // Bodies a thread updates at a time
+    int batchSize = 64;
+    // Threads at most, 0 uses every thread of the JobSystem
+    int threadCount = 0;
+    // Seconds per physics step, Update runs as many as fit
+    float step = 1.0f / 60.0f;
+    // Steps one Update may run at most, the rest of a long frame is dropped
+    int maxSteps = 4;
+    float gravity = 9.81f;
+    // Fraction of the velocity and spin lost per second when fully submerged
+    float linearDrag = 1.0f;
+    float angularDrag = 2.0f;
+    // Newton steps and tolerance of the surface height queries, coarser than
+    // SurfaceQuery's defaults since a hull point is much larger than that
+    int queryIterations = 8;
+    float queryTolerance = 1e-2f;
+};
+
+// State of every body, one entry per body in each array
+struct BodyArrays{
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+    std::vector<float> velocityX;
+    std::vector<float> velocityY;
+    std::vector<float> velocityZ;
+    // Unit quaternion from body to world
+    std::vector<float> orientationW;
+    std::vector<float> orientationX;
+    std::vector<float> orientationY;
+    std::vector<float> orientationZ;
+    // World space angular velocity in radians per second
+    std::vector<float> spinX;
+    std::vector<float> spinY;
+    std::vector<float> spinZ;
+    // Half the size of the box along its own axes
+    std::vector<float> halfX;
+    std::vector<float> halfY;
+    std::vector<float> halfZ;
+    // Mass with water weighing 1 per unit volume
+    std::vector<float> mass;
+    // 1 / the moments of inertia of the box about its own axes
+    std::vector<float> inverseInertiaX;
+    std::vector<float> inverseInertiaY;
+    std::vector<float> inverseInertiaZ;
+    // Fraction of the hull under water in the last step: 0 in the air, 1 sunk
+    std::vector<float> submerged;
+    // Wave source each hull point was last solved for, kHullPoints entries
+    // per body, point k of body i at i * kHullPoints + k
+    std::vector<float> hullSourceX;
+    std::vector<float> hullSourceZ;
+
+    // Returns the number of bodies
+    inline size_t size() const { return mass.size(); }
+};
+
+class BuoyancySystem{
+public:
+    // Hull points sampled per body
+    static const int kHullPoints = 8;
+
+    // Constructor, the bodies float on the first 'activeWaves' waves of 'waves'
+    BuoyancySystem(const WaveSet& waves, int activeWaves, const BuoyancySettings& settings = BuoyancySettings());
+    // Switches to other waves, the bodies keep their state
+    void SetWaves(const WaveSet& waves, int activeWaves);
+    // Adds a box at rest. 'density' is relative to water, below 1 floats.
+    void AddBody(const glm::vec3& position, const glm::vec3& halfExtents, float density, float yaw);
+    // Runs the physics steps that fit up to wave time 'time', 'dt' seconds
+    // after the last Update
+    void Update(double time, float dt);
+    // Runs one physics step, ending at wave time 'time'
+    void Step(double time);
+    // Writes three vec4 per body: position, orientation (x, y, z, w) and half extents
+    void WriteInstances(std::vector<glm::vec4>& instances) const;
+    // Returns the bodies
+    inline const BodyArrays& bodies() const { return m_bodies; }
+    // Returns the number of bodies
+    inline size_t size() const { return m_bodies.size(); }
+    // Returns the settings
+    inline const BuoyancySettings& settings() const { return m_settings; }
+    // Returns the number of threads
+    inline int getThreadCount() const { return m_threadCount; }
+    // Returns the physics steps the last Update ran
+    inline int getLastSteps() const { return m_lastSteps; }
+    // Returns how long the last Step took in milliseconds
+    inline double getStepMs() const { return m_stepMs; }
+private:
+    // Updates the bodies [begin, end) with the calling thread's query and samples
+    void StepBatch(size_t begin, size_t end, SurfaceQuery& query, SurfaceQueryBatch& samples);
+
+    BuoyancySettings m_settings;
+    int m_threadCount{1};
+    BodyArrays m_bodies;
+    // One surface query and sample batch per thread
+    std::vector<SurfaceQuery> m_queries;
+    std::vector<SurfaceQueryBatch> m_samples;
+    // Simulated time not yet stepped
+    float m_accumulator{0.0f};
+    int m_lastSteps{0};
+    double m_stepMs{0.0};
+};
+
+#endif
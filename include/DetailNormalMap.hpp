@@ -0,0 +1,56 @@
+/** @file DetailNormalMap.hpp
+ *  @brief Tileable normal map of the short gerstner waves.
+ *
+ *  Waves too short for the tessellated mesh are left out of the
+ *  evaluation shader and drawn here instead: a copy of the WaveSet is
+ *  snapped to the lattice of one tile, and every update sums the normal
+ *  terms of those waves at the current time into a map that frag.glsl
+ *  adds to the interpolated mesh normal.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef DETAILNORMALMAP_HPP
+#define DETAILNORMALMAP_HPP
+
+#include "WaveSet.hpp"
+
+#include <vector>
+
+struct DetailNormalSettings{
+    // Texels along one side of the tile and its world size
+    int resolution = 128;
+    float tileSize = 32.0f;
+    // Waves shorter than this go into the map, 0 picks twice the vertex spacing
+    float wavelength = 0.0f;
+};
+
+class DetailNormalMap{
+public:
+    // Constructor keeps a copy of 'waves' that tiles every settings.tileSize
+    DetailNormalMap(const WaveSet& waves, const DetailNormalSettings& settings);
+    // Sums the first 'activeWaves' waves whose wave number is at least
+    // 'minWaveNumber' into the map at 'time' seconds
+    void Update(double time, int activeWaves, float minWaveNumber);
+    // Normal terms (x, y - 1, z) of the summed waves, 3 floats per texel
+    inline const std::vector<float>& normalData() const { return m_normals; }
+    // Number of waves in the last update
+    inline int getWaveCount() const { return m_waveCount; }
+    // Returns texels along one side
+    inline int getResolution() const { return m_settings.resolution; }
+    // Returns the world size of one tile
+    inline float getTileSize() const { return m_settings.tileSize; }
+private:
+    DetailNormalSettings m_settings;
+    // Wave numbers of the original waves, the split has to match the shader's
+    std::vector<float> m_waveNumbers;
+    WaveSet m_periodic;
+    int m_waveCount{0};
+    // Indices of the waves in the last update and their sin/cos tables,
+    // sin x, cos x, sin z, cos z for each
+    std::vector<int> m_selected;
+    std::vector<float> m_tables;
+    std::vector<float> m_normals;
+};
+
+#endif
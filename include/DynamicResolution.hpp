@@ -0,0 +1,49 @@
+/** @file DynamicResolution.hpp
+ *  @brief Picks the render scale that keeps the GPU time of a frame under a target.
+ *
+ *  Update() is given the rolling GPU time of the scene every frame. When it
+ *  is over the target the scale is lowered, when it is well under it the
+ *  scale is raised, assuming the cost grows with the pixel count, i.e.
+ *  with the square of the scale. Between the target and 'headroom' times
+ *  the target the scale stays, which keeps it from flipping back and forth
+ *  around the target.
+ *
+ *  After a change nothing is decided for 'settleFrames' frames, until the
+ *  rolling time only covers frames drawn at the new scale. Scales are
+ *  multiples of 'step' so small noise does not reallocate the target.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef DYNAMICRESOLUTION_HPP
+#define DYNAMICRESOLUTION_HPP
+
+struct DynamicResolutionSettings{
+    // GPU milliseconds per frame to stay under
+    double targetMs = 16.6;
+    // Scale of the render target on each axis
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float step = 0.05f;
+    // The scale only goes up while the time is below headroom * targetMs
+    double headroom = 0.8;
+    // Frames without a decision after a change, the profiler's window plus its latency
+    int settleFrames = 64;
+};
+
+class DynamicResolution{
+public:
+    // Constructor, starts at the maximum scale
+    DynamicResolution(const DynamicResolutionSettings& settings);
+    // Takes the rolling GPU time of a frame, returns true when the scale changed
+    bool Update(double gpuMs);
+    // Returns the scale the scene is rendered at
+    inline float getScale() const { return m_scale; }
+    inline const DynamicResolutionSettings& settings() const { return m_settings; }
+private:
+    DynamicResolutionSettings m_settings;
+    float m_scale;
+    int m_framesSinceChange{0};
+};
+
+#endif
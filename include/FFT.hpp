@@ -0,0 +1,47 @@
+/** @file FFT.hpp
+ *  @brief Inverse 2D FFT used by the CPU ocean simulation.
+ *
+ *  Square power-of-two transforms on split real/imaginary grids.
+ *  Butterflies are radix-4 (with a single radix-2 stage when log2(N)
+ *  is odd) and are evaluated four rows or four columns at a time with
+ *  SIMD, one lane per row/column. Rows and columns are exposed as
+ *  separate passes so that callers can spread them over threads. Each
+ *  job that runs at the same time passes its own job index, which picks
+ *  the scratch buffers it gathers into, so no pass allocates.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include <vector>
+
+class FFT2D{
+public:
+    // Creates a transform for an n x n grid, with scratch for 'jobs' passes
+    // running at once. n must be a power of two >= 4.
+    explicit FFT2D(int n, int jobs = 1);
+    // Inverse transform (e^{+i}, unnormalized) of rows [firstRow, firstRow + rowCount)
+    // of a row-major n x n grid. firstRow and rowCount must be multiples of 4.
+    // 'job' in [0, jobs) must not be used by another pass at the same time.
+    void InverseRows(float* re, float* im, int firstRow, int rowCount, int job = 0);
+    // Inverse transform of columns [firstColumn, firstColumn + columnCount).
+    // firstColumn and columnCount must be multiples of 4.
+    void InverseColumns(float* re, float* im, int firstColumn, int columnCount, int job = 0);
+    // Returns the grid size
+    inline int getSize() const { return m_size; }
+private:
+    int m_size{0};
+    // Bit reversal permutation applied while gathering into the scratch buffer
+    std::vector<int> m_bitReverse;
+    // Twiddles w^1, w^2, w^3 for every radix-4 stage, stored back to back
+    std::vector<float> m_twiddleRe;
+    std::vector<float> m_twiddleIm;
+    // Bit reversed lanes of the 4 rows or columns in flight, 4 * n floats
+    // per buffer and one pair per job
+    std::vector<std::vector<float>> m_scratchRe;
+    std::vector<std::vector<float>> m_scratchIm;
+};
+
+#endif
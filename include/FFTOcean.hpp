@@ -0,0 +1,94 @@
+/** @file FFTOcean.hpp
+ *  @brief Tessendorf style FFT ocean simulated on the CPU.
+ *
+ *  Builds a Phillips or JONSWAP spectrum once, then every update
+ *  evolves it in time and runs inverse 2D FFTs to produce a tileable
+ *  displacement map (choppy x, height, choppy z) and a normal map.
+ *  Everything here is plain CPU code so it also works as the reference
+ *  implementation on machines without a GPU.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef FFTOCEAN_HPP
+#define FFTOCEAN_HPP
+
+#include "FFT.hpp"
+
+#include "glm/glm.hpp"
+
+#include <functional>
+#include <vector>
+
+// Which wave spectrum to sample the initial amplitudes from
+enum class OceanSpectrum{
+    Phillips,
+    JONSWAP
+};
+
+struct FFTOceanSettings{
+    // Grid resolution (power of two) and world size of one tile
+    int resolution = 256;
+    float patchSize = 256.0f;
+    // Wind speed in m/s and the direction it is blowing towards
+    float windSpeed = 16.0f;
+    glm::vec2 windDirection = glm::vec2(0.8f, 0.6f);
+    // Distance in metres the wind has blown over water (JONSWAP only)
+    float fetch = 120000.0f;
+    // Overall height scale of the Phillips spectrum
+    float phillipsAmplitude = 1.5e-3f;
+    // Horizontal displacement scale, 0 gives a plain height field
+    float choppiness = 1.2f;
+    OceanSpectrum spectrum = OceanSpectrum::Phillips;
+    unsigned int seed = 1337;
+    // Threads for the FFT passes at most, 0 uses every thread of the JobSystem
+    int threadCount = 0;
+};
+
+class FFTOcean{
+public:
+    // Constructor samples the initial spectrum
+    FFTOcean(const FFTOceanSettings& settings);
+    // Evolves the spectrum to 'time' seconds and rebuilds both maps
+    void Update(double time);
+    // Displacement map, 3 floats per texel: choppy x, height, choppy z
+    inline const std::vector<float>& displacementData() const { return m_displacement; }
+    // Normal map, 3 floats per texel
+    inline const std::vector<float>& normalData() const { return m_normals; }
+    // Returns grid resolution
+    inline int getResolution() const { return m_settings.resolution; }
+    // Returns the world size of one tile
+    inline float getPatchSize() const { return m_settings.patchSize; }
+private:
+    // Fills m_h0 and m_omega from the chosen spectrum
+    void GenerateSpectrum();
+    // Spectral density (already multiplied by the grid cell area) at wave vector k
+    float SpectrumAt(const glm::vec2& k) const;
+    // Evolves rows [first, first + count) of the spectrum and runs the row FFTs
+    // with the scratch of 'job'
+    void EvolveRows(int job, int first, int count, double time);
+    // Runs the column FFTs and writes the output maps for the given columns
+    void ResolveColumns(int job, int first, int count);
+    // Splits 'count' items into contiguous ranges of multiples of 4 over threads,
+    // work(job, first, count) gets a different job index for each range
+    void ParallelFor(int count, const std::function<void(int, int, int)>& work) const;
+
+    FFTOceanSettings m_settings;
+    FFT2D m_fft;
+    int m_threadCount{1};
+
+    // Initial amplitudes h0(k), conj(h0(-k)) and angular frequencies
+    std::vector<float> m_h0Re, m_h0Im;
+    std::vector<float> m_h0ConjRe, m_h0ConjIm;
+    std::vector<float> m_omega;
+
+    // Working grids, each one packs two real valued outputs:
+    // 0: height + i*dx, 1: dz + i*slope x, 2: slope z
+    std::vector<float> m_gridRe[3];
+    std::vector<float> m_gridIm[3];
+
+    std::vector<float> m_displacement;
+    std::vector<float> m_normals;
+};
+
+#endif
@@ -0,0 +1,133 @@
+/** @file FrameGraph.hpp
+ *  @brief Declarative scheduler for the render passes of one frame.
+ *
+ *  Passes declare the target they draw into, the targets they read and
+ *  the fixed function state they need. Compile() drops passes whose output
+ *  nobody uses, orders the rest so that every target is written before it
+ *  is read while keeping passes on the same target together, and backs the
+ *  transient targets with as few framebuffers as their lifetimes allow.
+ *  Execute() then runs the passes, clearing each target once per frame on
+ *  its first write and setting state through the GLStateCache so that
+ *  nothing is issued twice.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef FRAMEGRAPH_HPP
+#define FRAMEGRAPH_HPP
+
+#include "GLStateCache.hpp"
+#include "GPUProfiler.hpp"
+
+#include "glm/glm.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Index returned by FrameGraph::CreateTarget, or FrameGraph::kBackbuffer
+typedef int RenderTargetHandle;
+
+struct RenderTargetDesc{
+    int width = 0;
+    int height = 0;
+    // Internal format of the color texture, GL_NONE for a depth only target
+    GLenum colorFormat = GL_RGBA8;
+    bool depth = true;
+    // What the first pass of the frame that writes the target starts from
+    bool clearColor = true;
+    glm::vec4 clearColorValue = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
+    bool clearDepth = true;
+};
+
+// Fixed function state a pass needs, applied before it runs
+struct PassState{
+    bool depthTest = true;
+    GLenum depthFunc = GL_LESS;
+    bool depthWrite = true;
+};
+
+struct RenderPass{
+    std::string name;
+    RenderTargetHandle target = -1;
+    // Targets sampled by the pass, their writers run first
+    std::vector<RenderTargetHandle> reads;
+    PassState state;
+    // Keep the pass even though nothing reads its target (captures, readbacks)
+    bool sideEffects = false;
+    std::function<void()> execute;
+};
+
+class FrameGraph{
+public:
+    static const RenderTargetHandle kBackbuffer = -1;
+
+    // Constructor, 'state' is used for every state change the graph makes
+    FrameGraph(GLStateCache& state);
+    // Destructor deletes the framebuffers and textures of transient targets
+    ~FrameGraph();
+    // Size and clear values of the window's framebuffer. Offscreen
+    // rendering passes its own 'framebuffer' to stand in for the window
+    void SetBackbuffer(const RenderTargetDesc& desc, GLuint framebuffer = 0);
+    // Declares a transient target, it only gets GL storage in Compile()
+    RenderTargetHandle CreateTarget(const RenderTargetDesc& desc);
+    // Changes the size of a transient target, it is reallocated by the next Execute()
+    void ResizeTarget(RenderTargetHandle target, int width, int height);
+    // Declares a pass, passes on the same target run in declaration order
+    void AddPass(const RenderPass& pass);
+    // Culls, orders and allocates. Has to be called after the last AddPass
+    void Compile();
+    // Runs the compiled passes
+    void Execute();
+    // Forgets all passes and targets, e.g. to rebuild for a new resolution
+    void Reset();
+    // Color texture of a transient target, valid after Compile()
+    GLuint GetTexture(RenderTargetHandle target) const;
+    // Framebuffer of a target, valid after Compile()
+    GLuint GetFramebuffer(RenderTargetHandle target) const;
+    // Description of a target
+    const RenderTargetDesc& GetDesc(RenderTargetHandle target) const;
+    // Prints the compiled pass order and target allocation
+    void PrintSchedule() const;
+    // Times every pass, clear included, under its name. nullptr turns it off
+    inline void SetProfiler(GPUProfiler* profiler) { m_profiler = profiler; }
+    // Returns the clears and passes that Compile()/Execute() avoided so far
+    inline unsigned long long getClearsSkipped() const { return m_clearsSkipped; }
+    inline int getCulledPasses() const { return m_culledPasses; }
+private:
+    // GL storage shared by transient targets whose lifetimes do not overlap
+    struct Framebuffer{
+        RenderTargetDesc desc;
+        GLuint framebuffer{0};
+        GLuint colorTexture{0};
+        GLuint depthRenderbuffer{0};
+        // Last position in m_order that uses it
+        int busyUntil{-1};
+    };
+
+    // Creates the GL objects of 'framebuffer'
+    void CreateFramebuffer(Framebuffer& framebuffer);
+    // Deletes every Framebuffer
+    void ReleaseFramebuffers();
+    // Binds 'target' and sets its viewport, clears it if this is its first write of the frame
+    void BeginTarget(RenderTargetHandle target, std::vector<bool>& written);
+
+    GLStateCache& m_state;
+    GPUProfiler* m_profiler{nullptr};
+    RenderTargetDesc m_backbuffer;
+    GLuint m_backbufferFramebuffer{0};
+    std::vector<RenderTargetDesc> m_targets;
+    std::vector<RenderPass> m_passes;
+
+    // Compiled schedule: pass indices in execution order, and which
+    // Framebuffer backs each transient target
+    std::vector<int> m_order;
+    std::vector<int> m_targetFramebuffer;
+    std::vector<Framebuffer> m_framebuffers;
+    bool m_compiled{false};
+
+    unsigned long long m_clearsSkipped{0};
+    int m_culledPasses{0};
+};
+
+#endif
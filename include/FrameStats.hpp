@@ -0,0 +1,58 @@
+/** @file FrameStats.hpp
+ *  @brief Histogram of frame times with percentiles and hitch counts.
+ *
+ *  Record() takes the time between two consecutive frames. Times go into
+ *  fixed width bins, so recording is constant time and memory no matter
+ *  how long the session runs, and percentiles are read from the bins to
+ *  within one bin width. Times past the last bin are counted in it and
+ *  reported as the longest frame.
+ *
+ *  A frame is a hitch when it takes more than 'hitchFactor' times the
+ *  running average of the frames before it, which catches one off stalls
+ *  such as texture loads whatever the normal frame rate is. Hitches are
+ *  kept out of the average, unless several come in a row: then the frame
+ *  rate has dropped for good and the average starts over from them, so
+ *  the frames after a lasting slowdown are not all counted as hitches.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef FRAMESTATS_HPP
+#define FRAMESTATS_HPP
+
+#include <string>
+#include <vector>
+
+class FrameStats{
+public:
+    // Constructor, 'binMs' wide bins up to 'maxMs'
+    FrameStats(double binMs = 0.1, double maxMs = 250.0, double hitchFactor = 2.0);
+    // Records one frame that took 'ms' milliseconds
+    void Record(double ms);
+    // Frame time below which 'percent' of the frames fall, in milliseconds
+    double Percentile(double percent) const;
+    // One line with the frame count, average, p50/p95/p99, longest frame and hitches
+    std::string Summary() const;
+    inline unsigned long long getFrames() const { return m_frames; }
+    inline unsigned long long getHitches() const { return m_hitches; }
+    inline double getMax() const { return m_max; }
+    // Returns the running average hitches are measured against
+    inline double getAverage() const { return m_average; }
+private:
+    double m_binMs;
+    double m_hitchFactor;
+    std::vector<unsigned long long> m_bins;
+    unsigned long long m_frames{0};
+    unsigned long long m_hitches{0};
+    double m_total{0.0};
+    double m_max{0.0};
+    // Frame the longest time was recorded at, counted from 1
+    unsigned long long m_maxFrame{0};
+    // Exponential moving average the hitches are measured against
+    double m_average{0.0};
+    // Hitches in a row so far and their total time
+    unsigned long long m_hitchStreak{0};
+    double m_streakTotal{0.0};
+};
+
+#endif
@@ -0,0 +1,102 @@
+/** @file GLStateCache.hpp
+ *  @brief Thin state tracking layer in front of the OpenGL calls made every frame.
+ *
+ *  Remembers the last program, vertex array, framebuffer, texture bindings
+ *  per unit, enabled capabilities, depth function and mask, polygon mode,
+ *  viewport and patch size that were set, and only forwards a call to OpenGL when it changes
+ *  something. Every call is counted as either issued or dropped.
+ *
+ *  Code that changes the same state without going through the cache has to
+ *  call Invalidate() afterwards.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef GLSTATECACHE_HPP
+#define GLSTATECACHE_HPP
+
+#include <glad/glad.h>
+
+#include <map>
+
+class GLStateCache{
+public:
+    // Number of texture units tracked, higher units are always forwarded
+    static const int kMaxTextureUnits = 16;
+
+    // Constructor starts with every state unknown
+    GLStateCache();
+    // glUseProgram
+    void UseProgram(GLuint program);
+    // glBindVertexArray
+    void BindVertexArray(GLuint vertexArray);
+    // glBindFramebuffer(GL_FRAMEBUFFER, framebuffer)
+    void BindFramebuffer(GLuint framebuffer);
+    // glActiveTexture(GL_TEXTURE0 + unit) and glBindTexture, 'unit' is left
+    // active so the texture can be updated right after
+    void BindTexture(GLuint unit, GLenum target, GLuint texture);
+    // glEnable/glDisable
+    void SetCapability(GLenum capability, bool enabled);
+    // glDepthFunc
+    void DepthFunc(GLenum function);
+    // glDepthMask
+    void DepthMask(bool enabled);
+    // glPolygonMode(GL_FRONT_AND_BACK, mode)
+    void PolygonMode(GLenum mode);
+    // glViewport
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    // glPatchParameteri(GL_PATCH_VERTICES, count)
+    void PatchVertices(GLint count);
+    // Forgets everything, the next call of each kind is always issued
+    void Invalidate();
+    // Prints the issued and dropped counts for each kind of call
+    void PrintStats() const;
+    // Returns the calls forwarded to OpenGL
+    inline unsigned long long getIssued() const { return m_issuedTotal; }
+    // Returns the calls dropped because they would not change anything
+    inline unsigned long long getDropped() const { return m_droppedTotal; }
+private:
+    enum StateKind{
+        kProgram,
+        kVertexArray,
+        kFramebuffer,
+        kActiveTexture,
+        kTexture,
+        kCapability,
+        kDepthFunc,
+        kDepthMask,
+        kPolygonMode,
+        kViewport,
+        kPatchVertices,
+        kStateKinds
+    };
+
+    // Counts one call of 'kind', returns 'changed' so callers can write if(Count(...))
+    bool Count(StateKind kind, bool changed);
+    // Index of a texture target in m_textures, -1 if it is not tracked
+    static int TargetIndex(GLenum target);
+
+    // 0xFFFFFFFF marks a binding as unknown
+    GLuint m_program;
+    GLuint m_vertexArray;
+    GLuint m_framebuffer;
+    GLuint m_activeTexture;
+    GLuint m_textures[kMaxTextureUnits][4];
+    // Missing capabilities are unknown
+    std::map<GLenum, bool> m_capabilities;
+    // GL_NONE marks these as unknown
+    GLenum m_depthFunc;
+    GLenum m_polygonMode;
+    // 0 or 1 once known, -1 before
+    int m_depthMask;
+    GLint m_viewport[4];
+    bool m_viewportKnown;
+    GLint m_patchVertices;
+
+    unsigned long long m_issued[kStateKinds];
+    unsigned long long m_dropped[kStateKinds];
+    unsigned long long m_issuedTotal{0};
+    unsigned long long m_droppedTotal{0};
+};
+
+#endif
@@ -0,0 +1,97 @@
+/** @file GPUProfiler.hpp
+ *  @brief GPU time and pipeline counters per render pass from GL queries.
+ *
+ *  Begin()/End() put a GL_TIME_ELAPSED and a GL_PRIMITIVES_GENERATED query
+ *  around a pass, plus tessellation evaluation and fragment shader
+ *  invocation counts where GL_ARB_pipeline_statistics_query exists.
+ *  Queries are kept in a ring of 'latency' frames and read back when their
+ *  slot comes around again, only if they report GL_QUERY_RESULT_AVAILABLE,
+ *  so the CPU never waits on the GPU.
+ *  Each pass keeps a rolling average over the last 'window' results, which
+ *  can also be streamed to a CSV file.
+ *
+ *  Queries of the same kind cannot nest, so zones have to follow each other.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef GPUPROFILER_HPP
+#define GPUPROFILER_HPP
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class GPUProfiler{
+public:
+    // What is measured per zone. Only kTime and kPrimitives are always available
+    enum Counter{
+        kTime,              // milliseconds
+        kPrimitives,        // primitives out of the last geometry stage
+        kTessEvaluations,   // tessellation evaluation shader invocations
+        kFragments,         // fragment shader invocations
+        kCounters
+    };
+
+    // Constructor, results are read 'latency' frames after they were issued
+    // and averaged over the last 'window' of them
+    GPUProfiler(int latency = 4, int window = 60);
+    // Destructor deletes the queries and closes the CSV file
+    ~GPUProfiler();
+    // Writes every result as a 'frame,pass,gpu_ms,primitives,...' row to 'path'
+    bool OpenCsv(const std::string& path);
+    // Starts a frame, collects the results of the oldest one that are ready
+    void BeginFrame();
+    // Starts measuring 'name' on the GPU
+    void Begin(const std::string& name);
+    // Stops measuring the zone started last
+    void End();
+    // Rolling average of 'counter' for 'name', 0 before the first result
+    double Average(const std::string& name, Counter counter = kTime) const;
+    // Sum of the rolling averages of 'counter' over every zone
+    double TotalAverage(Counter counter = kTime) const;
+    // One line with the averages of every zone and their total time
+    std::string Summary() const;
+    // Returns true when the shader invocation counters are measured
+    inline bool hasPipelineStatistics() const { return m_counters == kCounters; }
+    // Returns the results that were still not available when their slot had to be reused
+    inline unsigned long long getDropped() const { return m_dropped; }
+private:
+    struct Sample{
+        double values[kCounters];
+    };
+
+    struct Zone{
+        std::string name;
+        // queries[counter * latency + slot], one per counter and frame in flight
+        std::vector<GLuint> queries;
+        std::vector<bool> issued;
+        std::deque<Sample> history;
+        Sample sum{};
+    };
+
+    // Index of 'name' in m_zones, adding it if needed
+    int FindZone(const std::string& name);
+    // Reads back the queries of 'slot' before it is reused, the ones that
+    // are still not available are counted as dropped instead of waited on
+    void Collect(int slot);
+
+    int m_latency;
+    int m_window;
+    // kCounters with pipeline statistics, kTessEvaluations without
+    int m_counters;
+    std::vector<Zone> m_zones;
+    // Frame counter and the ring slot of the current frame
+    unsigned long long m_frame{0};
+    int m_slot{0};
+    // Frame each slot was issued in, for the CSV rows
+    std::vector<unsigned long long> m_slotFrame;
+    int m_openZone{-1};
+    std::ofstream m_csv;
+    unsigned long long m_dropped{0};
+};
+
+#endif
@@ -0,0 +1,55 @@
+/** @file HeadlessContext.hpp
+ *  @brief OpenGL context without a window, rendering into a framebuffer object.
+ *
+ *  Creates a surfaceless EGL context, so it runs on machines without a
+ *  display server and with only Mesa's software rasterizer. libEGL is
+ *  loaded at run time, the build does not need EGL headers or libraries
+ *  and machines without libEGL only lose the headless mode. Frames are
+ *  drawn into a color and depth framebuffer of the requested size and can
+ *  be read back as a PPM.
+ *
+ *  Only available on Linux.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef HEADLESSCONTEXT_HPP
+#define HEADLESSCONTEXT_HPP
+
+#include <glad/glad.h>
+
+#include "PPM.hpp"
+
+#include <string>
+
+class HeadlessContext{
+public:
+    // Constructor does not touch EGL yet
+    HeadlessContext();
+    // Destructor deletes the framebuffer and the context
+    ~HeadlessContext();
+    // Creates the context and makes it current, false with getError() set on failure
+    bool CreateContext();
+    // Creates the 'width' x 'height' framebuffer, needs glad to be loaded
+    bool CreateFramebuffer(int width, int height);
+    // Looks up an OpenGL function, to be passed to gladLoadGLLoader
+    static void* GetProcAddress(const char* name);
+    // Reads the framebuffer back into a top to bottom RGB image
+    PPM Capture() const;
+    // Returns the framebuffer frames are drawn into
+    inline GLuint getFramebuffer() const { return m_framebuffer; }
+    // Returns why CreateContext or CreateFramebuffer failed
+    inline const std::string& getError() const { return m_error; }
+private:
+    void* m_library{nullptr};
+    void* m_display{nullptr};
+    void* m_context{nullptr};
+    GLuint m_framebuffer{0};
+    GLuint m_colorRenderbuffer{0};
+    GLuint m_depthRenderbuffer{0};
+    int m_width{0};
+    int m_height{0};
+    std::string m_error;
+};
+
+#endif
@@ -0,0 +1,50 @@
+/** @file InputTimeline.hpp
+ *  @brief How long each key was held, from timestamped key events.
+ *
+ *  Sampling the keyboard once per frame moves the camera by whole frames:
+ *  a key tapped during a hitch counts for the whole long frame, or not at
+ *  all if it was released before the frame looked. Instead every press and
+ *  release is recorded at the time it happened, and each frame asks how
+ *  many seconds of its window a key was down. Movement integrated from
+ *  that is the same at any frame rate and through any hitch.
+ *
+ *  Times are seconds on any clock, as long as the events and the windows
+ *  use the same one.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef INPUTTIMELINE_HPP
+#define INPUTTIMELINE_HPP
+
+#include <vector>
+
+class InputTimeline{
+public:
+    // Constructor tracks keys 0 to 'keyCount' - 1, all up
+    InputTimeline(int keyCount = 512);
+    // Records that 'key' went down or up at 'time' seconds. Events older
+    // than the current window count from its start.
+    void Press(int key, double time);
+    void Release(int key, double time);
+    // Seconds 'key' was down from the start of the window to 'now'
+    double HeldTime(int key, double now) const;
+    // Ends the window at 'now', the next one starts there
+    void EndWindow(double now);
+    // Returns true if 'key' is down
+    bool IsDown(int key) const;
+    // Returns the start of the current window
+    inline double getWindowStart() const { return m_windowStart; }
+private:
+    struct KeyState{
+        bool down{false};
+        // When it went down, no earlier than the window start
+        double downTime{0.0};
+        // Seconds held in the window before the last release
+        double heldTime{0.0};
+    };
+    std::vector<KeyState> m_keys;
+    double m_windowStart{0.0};
+};
+
+#endif
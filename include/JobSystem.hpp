@@ -0,0 +1,71 @@
+/** @file JobSystem.hpp
+ *  @brief Work stealing thread pool for the CPU side of the engine.
+ *
+ *  Start() launches the worker threads once, and every system hands its
+ *  parallel work to them as jobs instead of spawning threads of its own.
+ *  Each worker owns a deque of jobs: it pushes and pops at one end, and
+ *  idle workers steal from the other end of someone else's. Threads that
+ *  are not workers, like the render thread, submit into a shared queue.
+ *  Submitting never takes a lock.
+ *
+ *  Every job is counted in a JobCounter, and Wait() runs queued jobs on
+ *  the waiting thread until the counter drops to zero, so waiting on jobs
+ *  from inside a job does not block a worker. A counter can have a parent
+ *  that counts it as one job for as long as it has any left, so waiting on
+ *  the parent also waits for everything the children were given.
+ *
+ *  Without Start(), or after Shutdown(), jobs run right away on the thread
+ *  that submits them.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+// Counts the unfinished jobs of a group, see JobSystem::Wait
+class JobCounter{
+public:
+    // Constructor, 'parent' counts this group as one job while it is not done
+    explicit JobCounter(JobCounter* parent = nullptr) : m_parent(parent){
+    }
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+    // Returns true once every job counted so far has finished
+    inline bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+    // Counts one more job, and this group in the parent when it was done.
+    // JobSystem::Run calls it, call it directly for work that is not a job.
+    void Add();
+    // Counts one job as finished, and this group in the parent when it is done
+    void Finish();
+private:
+    std::atomic<int> m_pending{0};
+    JobCounter* m_parent;
+};
+
+class JobSystem{
+public:
+    // Starts 'workers' worker threads, 0 picks one less than the hardware
+    // concurrency since the thread that waits on jobs runs them as well
+    static void Start(int workers = 0);
+    // Runs the jobs that are left and joins the workers
+    static void Shutdown();
+    // Runs 'job' on some thread, counted in 'counter'
+    static void Run(JobCounter& counter, std::function<void()> job);
+    // Runs queued jobs on the calling thread until 'counter' is done
+    static void Wait(JobCounter& counter);
+    // Calls work(begin, end) on ranges of at most 'grain' items that cover
+    // [0, count), and returns once all of them are done. A grain of 0 makes
+    // about four ranges per thread. Without workers it is one call.
+    static void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& work);
+    // Returns the number of worker threads
+    static int getWorkerCount();
+    // Returns how many threads run jobs at once, the workers and the one waiting
+    static inline int getConcurrency() { return getWorkerCount() + 1; }
+};
+
+#endif
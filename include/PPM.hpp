@@ -19,6 +19,8 @@ public:
     PPM();
     // Constructor loads a filename with the .ppm extension
     PPM(std::string fileName);
+    // Constructor wraps 'width' x 'height' R,G,B pixels, top row first
+    PPM(int width, int height, const std::vector<uint8_t>& pixelData);
     // Destructor clears any memory that has been allocated
     ~PPM();
     // Saves a PPM Image to a new file.
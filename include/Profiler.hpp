@@ -0,0 +1,68 @@
+/** @file Profiler.hpp
+ *  @brief Scoped CPU zones recorded into per thread rings, exported as a Chrome trace.
+ *
+ *  PROFILE_ZONE("name") at the top of a scope records when the scope was
+ *  entered and left. Each thread writes into its own ring of events, so
+ *  recording never takes a lock; the oldest events are overwritten once a
+ *  ring is full. Threads that exit hand their ring back for the next thread
+ *  to reuse, which keeps short lived worker threads from growing the
+ *  profiler. While the profiler is disabled a zone costs one relaxed atomic
+ *  load.
+ *
+ *  WriteChromeTrace() writes the rings as JSON that chrome://tracing and
+ *  Perfetto open. It reads the rings without locking them, so it has to be
+ *  called while no other thread is recording.
+ *
+ *  Zone names must outlive the profiler, string literals are the intended use.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+class Profiler{
+public:
+    // Starts recording, every thread's ring keeps the last 'eventsPerThread' zones
+    static void Enable(int eventsPerThread = 1 << 16);
+    // Returns true while zones are recorded
+    static inline bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    // Nanoseconds on a steady clock
+    static uint64_t Now();
+    // Adds a finished zone to the calling thread's ring
+    static void Record(const char* name, uint64_t start, uint64_t end);
+    // Writes every ring as Chrome trace JSON, returns false if 'path' cannot be written
+    static bool WriteChromeTrace(const std::string& path);
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+// Records the lifetime of the enclosing scope, see PROFILE_ZONE
+class ProfileZone{
+public:
+    explicit ProfileZone(const char* name)
+        : m_name(name), m_start(Profiler::IsEnabled() ? Profiler::Now() : 0){
+    }
+    ~ProfileZone(){
+        if(m_start != 0){
+            Profiler::Record(m_name, m_start, Profiler::Now());
+        }
+    }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+private:
+    const char* m_name;
+    // 0 when the profiler was disabled on entry
+    uint64_t m_start;
+};
+
+#define PROFILE_ZONE_CONCAT_INNER(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing scope under 'name'
+#define PROFILE_ZONE(name) ProfileZone PROFILE_ZONE_CONCAT(profileZone, __LINE__)(name)
+
+#endif
@@ -0,0 +1,72 @@
+/** @file QualityGovernor.hpp
+ *  @brief Trades tessellation, wave count and render scale for a frame time budget.
+ *
+ *  The governor walks a fixed ladder of quality levels, from everything at
+ *  full quality down to the cheapest settings. Each frame it is given the
+ *  CPU time of the frame and the rolling GPU time of its passes. The cost
+ *  of a frame is the larger of the two, since CPU and GPU work overlap and
+ *  the slower one sets the frame rate; swap and frame cap waits are not
+ *  part of it, so vsync does not read as a full budget.
+ *
+ *  When the cost averaged over 'window' frames is over the budget the
+ *  governor steps one level down, when it is under 'headroom' times the
+ *  budget it steps one level up. Between the two it holds, and after every
+ *  change it waits 'cooldown' frames for the timings to reflect the new
+ *  level, so it does not oscillate between two neighbouring levels.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef QUALITYGOVERNOR_HPP
+#define QUALITYGOVERNOR_HPP
+
+#include <deque>
+#include <string>
+
+struct QualityLevel{
+    // Multiplies the tessellation level of every ocean mode
+    float tessScale;
+    // Most gerstner waves drawn, in quarters of the wave set
+    int maxWaves;
+    // Scale of the scene target on each axis
+    float renderScale;
+};
+
+struct QualityGovernorSettings{
+    // Milliseconds a frame may cost
+    double budgetMs = 16.6;
+    // Quality only goes up while the cost is below headroom * budgetMs
+    double headroom = 0.7;
+    // Frames the CPU time is averaged over
+    int window = 60;
+    // Frames without a decision after a change, longer than the window and
+    // the GPU profiler's window plus its latency
+    int cooldown = 90;
+};
+
+class QualityGovernor{
+public:
+    // Constructor, starts at the highest level
+    QualityGovernor(const QualityGovernorSettings& settings);
+    // Takes the CPU milliseconds of the frame and the rolling GPU
+    // milliseconds, returns true when the level changed
+    bool Update(double cpuMs, double gpuMs);
+    // Settings of the current level
+    const QualityLevel& getLevel() const;
+    // Current level, 0 is the highest quality
+    inline int getLevelIndex() const { return m_level; }
+    // Number of levels, the last one is the cheapest
+    static int getLevelCount();
+    // Why the last change was made
+    inline const std::string& getReason() const { return m_reason; }
+    inline const QualityGovernorSettings& settings() const { return m_settings; }
+private:
+    QualityGovernorSettings m_settings;
+    int m_level{0};
+    std::deque<double> m_cpuTimes;
+    double m_cpuSum{0.0};
+    int m_framesSinceChange{0};
+    std::string m_reason;
+};
+
+#endif
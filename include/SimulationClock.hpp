@@ -0,0 +1,67 @@
+/** @file SimulationClock.hpp
+ *  @brief Clock that everything animated reads its time from.
+ *
+ *  Tick() is called once at the start of every frame and advances the
+ *  simulation time. In real time mode a tick advances by the wall clock
+ *  time since the previous tick. In fixed step mode it advances by the
+ *  same step every frame no matter how long the frame took, so a run of N
+ *  frames always animates the same N instants. Either way the advance is
+ *  multiplied by the time scale, and a paused clock does not advance.
+ *
+ *  getFrameDelta() is the unscaled step of the last tick and keeps running
+ *  while paused, for things like camera movement that should not slow
+ *  down with the simulation.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef SIMULATIONCLOCK_HPP
+#define SIMULATIONCLOCK_HPP
+
+#include <chrono>
+
+enum class ClockMode{
+    RealTime,
+    FixedStep
+};
+
+class SimulationClock{
+public:
+    // Constructor, starts at 0 seconds in real time mode
+    SimulationClock();
+    // Advances the clock, call once per frame before anything reads it
+    void Tick();
+    // Fixed step mode advances by 'step' seconds per tick, real time mode by the wall clock
+    void SetMode(ClockMode mode, double step = 1.0 / 60.0);
+    // Moves the clock to 'time' seconds, --time-offset fast-forwards a long running session
+    inline void SetTime(double time) { m_time = time; }
+    // Multiplies every advance by 'scale', 0 freezes the simulation like a pause
+    inline void SetScale(double scale) { m_scale = scale; }
+    inline void SetPaused(bool paused) { m_paused = paused; }
+    inline void TogglePaused() { m_paused = !m_paused; }
+    // Simulation seconds at the last tick
+    inline double getTime() const { return m_time; }
+    // Simulation seconds advanced by the last tick, scaled and 0 while paused
+    inline double getDelta() const { return m_delta; }
+    // Unscaled seconds of the last tick, keeps running while paused
+    inline double getFrameDelta() const { return m_frameDelta; }
+    inline ClockMode getMode() const { return m_mode; }
+    inline double getStep() const { return m_step; }
+    inline double getScale() const { return m_scale; }
+    inline bool isPaused() const { return m_paused; }
+    // Ticks since the clock was created
+    inline unsigned long long getFrame() const { return m_frame; }
+private:
+    ClockMode m_mode{ClockMode::RealTime};
+    double m_step{1.0 / 60.0};
+    double m_scale{1.0};
+    bool m_paused{false};
+    double m_time{0.0};
+    double m_delta{0.0};
+    double m_frameDelta{0.0};
+    unsigned long long m_frame{0};
+    // Wall clock of the last tick, real time mode only
+    std::chrono::steady_clock::time_point m_lastTick;
+};
+
+#endif
@@ -0,0 +1,111 @@
+/** @file SimulationThread.hpp
+ *  @brief Steps the CPU simulation on its own thread, one frame ahead of the GL calls.
+ *
+ *  The render thread asks for a step with Request(), which returns at
+ *  once, and goes on issuing the GL calls of the frame it already has.
+ *  The step runs on the simulation thread and writes everything the
+ *  frame needs into a FrameSnapshot, which it publishes through a
+ *  TripleBuffer. The next frame Acquire()s the newest snapshot and only
+ *  uploads and draws it, so the CPU simulation of frame n + 1 overlaps
+ *  the GL submission and swap of frame n.
+ *
+ *  A snapshot is never changed once published. The step reads only the
+ *  SimulationRequest it was given and the objects it owns; the render
+ *  thread calls WaitIdle() before it changes any of those.
+ *
+ *  Without a thread, Request() runs the step right away on the calling thread.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef SIMULATIONTHREAD_HPP
+#define SIMULATIONTHREAD_HPP
+
+#include "TripleBuffer.hpp"
+
+#include "glm/glm.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// What the render thread asks one step for, copied when it is requested
+struct SimulationRequest{
+    // Gerstner waves to simulate
+    int activeWaves = 0;
+    // Which oceans to step, the loop ocean is baked and needs no step
+    bool gerstner = true;
+    bool fft = false;
+    // Waves above this wave number go to the detail normal map, < 0 for no map
+    float detailWaveNumber = -1.0f;
+    // Waves above this wave number are left out of the mesh, and so out of
+    // the water the bodies float on
+    float meshWaveNumber = 1e30f;
+};
+
+// Everything one step produced for the render thread
+struct FrameSnapshot{
+    // Simulation frame and time it shows, frame 0 before the first step
+    unsigned long long frame = 0;
+    double time = 0.0;
+    // Request it answers
+    SimulationRequest request;
+    // gerstner_waves texels at 'time', see WaveSet::WriteTexels
+    std::vector<glm::vec4> waveTexels;
+    // Detail normal map, empty without one
+    std::vector<float> detailNormals;
+    // FFT displacement and normal maps, empty unless request.fft
+    std::vector<float> fftDisplacement;
+    std::vector<float> fftNormals;
+    // Floating body instances, three vec4 per body
+    std::vector<glm::vec4> bodyInstances;
+    // Milliseconds the step took
+    double stepMs = 0.0;
+};
+
+class SimulationThread{
+public:
+    // Fills the snapshot for one request, the snapshot is reused so its
+    // vectors keep their memory from step to step
+    typedef std::function<void(const SimulationRequest&, FrameSnapshot&)> StepFunction;
+
+    // Constructor starts the thread, or steps on the calling thread when 'threaded' is false
+    SimulationThread(StepFunction step, bool threaded = true);
+    // Destructor finishes the running step and joins the thread
+    ~SimulationThread();
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // Starts a step for 'request' unless one is still running. Returns
+    // false, and drops the request, if one is.
+    bool Request(const SimulationRequest& request);
+    // Waits until no step is running or requested
+    void WaitIdle();
+    // Takes the newest published snapshot, false if none since the last call
+    inline bool Acquire() { return m_snapshots.Acquire(); }
+    // Returns the snapshot taken by the last successful Acquire()
+    inline const FrameSnapshot& Latest() const { return m_snapshots.Front(); }
+    // Returns true if steps run on their own thread
+    inline bool isThreaded() const { return m_thread.joinable(); }
+private:
+    // Body of the simulation thread
+    void Run();
+    // Runs one step into the back snapshot and publishes it
+    void Step(const SimulationRequest& request);
+
+    StepFunction m_step;
+    TripleBuffer<FrameSnapshot> m_snapshots;
+    // Guard the request and the state below, the snapshots need no lock
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    SimulationRequest m_request;
+    bool m_pending{false};
+    bool m_busy{false};
+    bool m_quit{false};
+    std::thread m_thread;
+};
+
+#endif
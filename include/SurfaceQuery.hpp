@@ -0,0 +1,117 @@
+/** @file SurfaceQuery.hpp
+ *  @brief Height and normal of the gerstner surface at world xz points.
+ *
+ *  Gerstner waves move every surface point sideways as well as up, so the
+ *  height above a world point (x, z) is the height of the start point s
+ *  whose displaced position lands on (x, z), not the height of the wave sum
+ *  evaluated at (x, z). SurfaceQuery solves for s with Newton steps on the
+ *  horizontal displacement, using the jacobian from WaveEvaluator. Steps
+ *  that make the error worse are halved, and where the jacobian cannot be
+ *  inverted a damped fixed point step is taken instead.
+ *
+ *  Where the waves are steep enough to loop, a point lies over several
+ *  sources, any of which is returned, and the error can have dips that are
+ *  not a solution; points stuck in one restart from another start point.
+ *  Points that still do not land within the tolerance keep their best
+ *  source and are counted by getUnconverged(). With warmStart the solve
+ *  begins at the source already in the batch, so a point that is queried
+ *  again a step later stays on the same fold rather than jumping between
+ *  them.
+ *
+ *  Points are solved in chunks that JobSystem threads take in order. With
+ *  a time budget no new chunks are taken once it is spent, so a frame can
+ *  solve as many points as fit and continue with the rest next frame.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef SURFACEQUERY_HPP
+#define SURFACEQUERY_HPP
+
+#include "WaveEvaluator.hpp"
+
+#include <cstddef>
+#include <vector>
+
+struct SurfaceQuerySettings{
+    // Newton steps per point at most
+    int maxIterations = 16;
+    // World units a solved start point may land away from its query point
+    float tolerance = 1e-3f;
+    // Points a worker solves at a time
+    int chunkSize = 256;
+    // Threads at most, 0 uses every thread of the JobSystem
+    int threadCount = 0;
+    // Milliseconds a Solve call may take, 0 solves every point
+    double budgetMs = 0.0;
+    // Start from batch.sourceX and sourceZ instead of the point itself
+    bool warmStart = false;
+};
+
+// World xz points to query and their results, one array per component
+struct SurfaceQueryBatch{
+    std::vector<float> x;
+    std::vector<float> z;
+    // Surface height and unit normal above (x, z)
+    std::vector<float> height;
+    std::vector<float> normalX;
+    std::vector<float> normalY;
+    std::vector<float> normalZ;
+    // Start point on the water plane whose displaced position is (x, z)
+    std::vector<float> sourceX;
+    std::vector<float> sourceZ;
+    // Horizontal distance between where the source lands and (x, z)
+    std::vector<float> error;
+
+    // Resizes every array to 'count' points
+    void Resize(size_t count);
+    // Returns the number of points
+    inline size_t size() const { return x.size(); }
+};
+
+class SurfaceQuery{
+public:
+    // Constructor takes the first 'activeWaves' waves of 'waves' at time 0
+    SurfaceQuery(const WaveSet& waves, int activeWaves, const SurfaceQuerySettings& settings = SurfaceQuerySettings());
+    // Moves the waves to 'time' seconds
+    void SetTime(double time);
+    // Solves the points [begin, size) of 'batch'. Returns the end of the
+    // solved range, which is batch.size() unless the time budget ran out.
+    size_t Solve(SurfaceQueryBatch& batch, size_t begin = 0);
+    // Returns the settings
+    inline const SurfaceQuerySettings& settings() const { return m_settings; }
+    // Returns the points of the last Solve that are further than the tolerance from their source
+    inline size_t getUnconverged() const { return m_unconverged; }
+    // Returns how long the last Solve took in milliseconds
+    inline double getSolveMs() const { return m_solveMs; }
+    // Returns the number of threads
+    inline int getThreadCount() const { return m_threadCount; }
+private:
+    // Per thread working memory of SolveChunk, kept between calls
+    struct SolverScratch{
+        WaveBatch waves;
+        // Best guess so far, its residual and squared error
+        std::vector<float> lastX;
+        std::vector<float> lastZ;
+        std::vector<float> lastResidualX;
+        std::vector<float> lastResidualZ;
+        std::vector<float> lastErrorSquared;
+        // Steps in a row that made the error worse
+        std::vector<int> rejected;
+    };
+
+    // Solves the points [begin, end) with the calling thread's 'scratch'.
+    // Returns the number of points that did not converge.
+    size_t SolveChunk(SurfaceQueryBatch& batch, size_t begin, size_t end, SolverScratch& scratch) const;
+
+    SurfaceQuerySettings m_settings;
+    WaveEvaluator m_evaluator;
+    int m_threadCount{1};
+    // Largest horizontal displacement of the waves, no source is further from its point
+    float m_maxDisplacement{0.0f};
+    std::vector<SolverScratch> m_scratch;
+    size_t m_unconverged{0};
+    double m_solveMs{0.0};
+};
+
+#endif
@@ -0,0 +1,58 @@
+/** @file TripleBuffer.hpp
+ *  @brief Lock-free handoff of the newest value from one thread to another.
+ *
+ *  Three slots: the writer fills the back one, the reader looks at the
+ *  front one, and the middle one holds the newest value neither of them
+ *  is using. Publish() swaps the back slot with the middle one and
+ *  Acquire() swaps the middle slot with the front one if something new
+ *  was published since, each with a single atomic exchange. Neither side
+ *  ever waits for the other; a reader that falls behind skips to the
+ *  newest value, a writer that runs ahead overwrites values nobody read.
+ *
+ *  One writer thread and one reader thread.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <atomic>
+
+template<class T>
+class TripleBuffer{
+public:
+    // Constructor, all three slots default constructed
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Slot the writer fills, only the writer may touch it
+    inline T& Back() { return m_slots[m_back]; }
+    // Hands the back slot to the reader, the writer gets the old middle one
+    inline void Publish(){
+        m_back = m_middle.exchange(m_back | kFresh, std::memory_order_acq_rel) & kIndex;
+    }
+    // Takes the newest published slot as the front one. Returns false, and
+    // keeps the front slot, if nothing was published since the last call.
+    inline bool Acquire(){
+        if((m_middle.load(std::memory_order_relaxed) & kFresh) == 0){
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+    // Slot the reader looks at, only the reader may touch it
+    inline const T& Front() const { return m_slots[m_front]; }
+private:
+    // The middle index carries a flag set by Publish and cleared by Acquire
+    static const int kIndex = 3;
+    static const int kFresh = 4;
+
+    T m_slots[3];
+    int m_back{0};
+    std::atomic<int> m_middle{1};
+    int m_front{2};
+};
+
+#endif
@@ -0,0 +1,54 @@
+/** @file UniformRing.hpp
+ *  @brief Ring of uniform buffer slots written once per frame.
+ *
+ *  Each frame the CPU writes one packed block into the next slot and binds
+ *  that slot's range to a uniform block binding point, replacing a run of
+ *  glUniform* calls per program. The slots are aligned ranges of one
+ *  buffer, and a fence per slot keeps the CPU from overwriting a slot the
+ *  GPU is still reading. When GL_ARB_buffer_storage exists the buffer is
+ *  mapped once, persistently. Otherwise, or when persistent mapping is not
+ *  allowed, each frame maps just its slot, unsynchronized since the fence
+ *  already waited, and unmaps it again.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef UNIFORMRING_HPP
+#define UNIFORMRING_HPP
+
+#include <glad/glad.h>
+
+#include <vector>
+
+class UniformRing{
+public:
+    // Constructor, 'blockSize' bytes per slot. 'allowPersistent' false maps
+    // the slots one frame at a time even when buffer storage is available
+    UniformRing(GLsizeiptr blockSize, int slots = 3, bool allowPersistent = true);
+    // Destructor unmaps and deletes the buffer and any pending fences
+    ~UniformRing();
+    // Returns the memory of the next slot to write, waiting first if the GPU
+    // has not finished the frame that last used it
+    void* Begin();
+    // Makes the slot written since Begin() visible at 'bindingPoint'
+    void End(GLuint bindingPoint);
+    // Fences the current slot and moves on, call after its last draw
+    void Fence();
+    // Returns true when the buffer is persistently mapped
+    inline bool isPersistent() const { return m_mapped != nullptr; }
+    // Returns how often Begin() had to wait on a fence
+    inline unsigned long long getWaits() const { return m_waits; }
+private:
+    GLsizeiptr m_blockSize;
+    // Slot size rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    GLsizeiptr m_stride;
+    int m_slots;
+    int m_slot{0};
+    GLuint m_buffer{0};
+    // Persistent mapping of all slots, nullptr when mapped per frame
+    char* m_mapped{nullptr};
+    std::vector<GLsync> m_fences;
+    unsigned long long m_waits{0};
+};
+
+#endif
@@ -0,0 +1,145 @@
+/** @file WaveEvaluator.hpp
+ *  @brief Evaluates the gerstner surface for batches of points on the CPU.
+ *
+ *  Same wave sum as gerstner_wave() in gerstner_tese.glsl and
+ *  WaveSet::Evaluate, for code that needs the drawn surface many points at a
+ *  time. The wave constants and the points are kept in structure of arrays
+ *  layout, one array per field, so a kernel evaluates 4 (SSE) or 8 (AVX2)
+ *  points per instruction and shares one sin/cos pair between position and
+ *  normal like the shader does. sin and cos come from a polynomial that is
+ *  accurate to a few float ulps for the phases the ocean reaches (up to
+ *  about 8000 radians).
+ *
+ *  Each kernel is a template over the wave model, the outputs it writes and
+ *  the number of waves, so a combination pays neither for branches in the
+ *  inner loops nor for outputs nobody reads, and up to kMaxUnrolledWaves
+ *  waves the wave loop is unrolled completely. Evaluate() picks the
+ *  combination once per call.
+ *
+ *  The AVX2 kernel is compiled for AVX2 and FMA with a function attribute
+ *  and only picked when the CPU supports both, so the build flags do not
+ *  change. Outside of GCC and Clang on x86-64 only the scalar kernel exists.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef WAVEEVALUATOR_HPP
+#define WAVEEVALUATOR_HPP
+
+#include "WaveSet.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// Instruction sets the evaluator has kernels for
+enum class WaveKernel{
+    Scalar,
+    SSE,
+    AVX2
+};
+
+// Wave models the kernels are specialized for
+enum class WaveModel{
+    Gerstner,   // Trochoidal waves that also move the water sideways
+    Sine        // Height only: gerstner waves that all have no steepness
+};
+
+// Results a kernel writes, the position always
+enum class WaveOutputs{
+    Position,
+    PositionNormal,
+    PositionJacobian,
+    PositionNormalJacobian
+};
+
+// Query points and their results, one array per component. x and z are the
+// undisplaced positions on the water plane the waves start from.
+struct WaveBatch{
+    std::vector<float> x;
+    std::vector<float> z;
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+    std::vector<float> normalX;
+    std::vector<float> normalY;
+    std::vector<float> normalZ;
+    // Derivatives of the displaced x and z by the start x and z, only filled
+    // in when the batch was resized with them. The matrix is symmetric since
+    // every wave displaces along its own direction.
+    std::vector<float> jacobianXX;
+    std::vector<float> jacobianXZ;
+    std::vector<float> jacobianZZ;
+
+    // Resizes every array to 'count' points, the jacobian ones to 0 without 'jacobian'
+    void Resize(size_t count, bool jacobian = false);
+    // Returns true if the jacobian is evaluated
+    inline bool hasJacobian() const { return !jacobianXX.empty(); }
+    // Returns the number of points
+    inline size_t size() const { return x.size(); }
+};
+
+// Per wave constants, one entry per wave, see GerstnerWaveConstants
+struct WaveColumns{
+    std::vector<float> directionX;
+    std::vector<float> directionZ;
+    std::vector<float> waveVectorX;
+    std::vector<float> waveVectorZ;
+    std::vector<float> amplitude;
+    std::vector<float> width;
+    std::vector<float> slope;
+    std::vector<float> steepSlope;
+    // width * direction.x * waveVector.x, width * direction.x * waveVector.y
+    // and width * direction.y * waveVector.y, for the jacobian
+    std::vector<float> displacementXX;
+    std::vector<float> displacementXZ;
+    std::vector<float> displacementZZ;
+    // Wrapped phase speed * time
+    std::vector<float> phase;
+};
+
+class WaveEvaluator{
+public:
+    // Up to this many waves the kernels are unrolled for the exact count
+    static const int kMaxUnrolledWaves = 4;
+
+    // Constructor takes the first 'activeWaves' waves of 'waves' at time 0,
+    // as sine waves if none of them has any steepness
+    WaveEvaluator(const WaveSet& waves, int activeWaves);
+    // Moves the waves to 'time' seconds, with the phases wrapped in double
+    // precision by WaveSet::Phase, as they are uploaded for the shader
+    void SetTime(double time);
+    // Evaluates the points [begin, end) of 'batch' with 'kernel', which must
+    // be supported. Ranges that do not overlap can be evaluated concurrently.
+    void Evaluate(WaveBatch& batch, size_t begin, size_t end, WaveKernel kernel) const;
+    // Same, but writes only 'outputs' and leaves the other arrays as they are
+    void Evaluate(WaveBatch& batch, size_t begin, size_t end, WaveKernel kernel, WaveOutputs outputs) const;
+    // Evaluates every point of 'batch' with the fastest supported kernel
+    void Evaluate(WaveBatch& batch) const;
+    // Returns true if this build and CPU can run 'kernel'
+    static bool IsSupported(WaveKernel kernel);
+    // Returns the fastest kernel this build and CPU can run
+    static WaveKernel BestKernel();
+    // Returns the name of 'kernel' for printing
+    static const char* KernelName(WaveKernel kernel);
+    // Returns the name of 'model' for printing
+    static const char* ModelName(WaveModel model);
+    // Returns the name of 'outputs' for printing
+    static const char* OutputsName(WaveOutputs outputs);
+    // false evaluates small wave counts with the generic loop too, to compare
+    inline void SetUnrolled(bool unrolled) { m_unrolled = unrolled; }
+    // Returns the wave model the kernels are picked for
+    inline WaveModel getModel() const { return m_model; }
+    // Returns the number of waves summed
+    inline int getWaveCount() const { return static_cast<int>(m_columns.amplitude.size()); }
+    // Returns the time the waves are at
+    inline double getTime() const { return m_time; }
+private:
+    // Copy of the waves, for WaveSet::Phase
+    WaveSet m_waves;
+    double m_time{0.0};
+    WaveColumns m_columns;
+    WaveModel m_model{WaveModel::Gerstner};
+    bool m_unrolled{true};
+};
+
+#endif
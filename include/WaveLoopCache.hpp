@@ -0,0 +1,67 @@
+/** @file WaveLoopCache.hpp
+ *  @brief One baked loop of the gerstner ocean.
+ *
+ *  Evaluates a periodic WaveSet over one tile and one loop period and
+ *  stores displacement and normals as half floats, frame after frame, ready
+ *  to upload as 3D textures. Bakes are written to and read back from a
+ *  disk cache so the same sea state starts instantly the next time.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef WAVELOOPCACHE_HPP
+#define WAVELOOPCACHE_HPP
+
+#include "WaveSet.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct WaveLoopSettings{
+    // Texels along x and z of one tile, and frames in one loop
+    int resolution = 128;
+    int frames = 128;
+    // World size of the tile and length of the loop in seconds
+    float tileSize = 32.0f;
+    float period = 20.0f;
+    // Where baked loops are stored, empty disables the disk cache
+    std::string cacheDirectory = "./cache";
+};
+
+class WaveLoopCache{
+public:
+    // Constructor quantizes 'waves' so that they loop, nothing is baked yet
+    WaveLoopCache(const WaveSet& waves, int activeWaves, const WaveLoopSettings& settings);
+    // Loads the loop from the disk cache, or bakes it and stores it there.
+    // Returns true if the disk cache was used.
+    bool Build();
+    // Displacement (x, height, z, unused), 4 half floats per texel, frames stacked along r
+    inline const std::vector<uint16_t>& displacementData() const { return m_displacement; }
+    // Normals (x, y, z, unused), 4 half floats per texel
+    inline const std::vector<uint16_t>& normalData() const { return m_normals; }
+    // Returns the settings the loop was baked with
+    inline const WaveLoopSettings& settings() const { return m_settings; }
+    // Returns the periodic waves that were baked
+    inline const WaveSet& waves() const { return m_waves; }
+    // Number of waves that were baked
+    inline int activeWaves() const { return m_activeWaves; }
+private:
+    // Evaluates frames [first, first + count)
+    void BakeFrames(int first, int count);
+    // File name derived from a hash of everything that affects the bake
+    std::string CacheFileName() const;
+    // Writes/reads the cache file, reading fails on any mismatch
+    void WriteCache(const std::string& fileName) const;
+    bool ReadCache(const std::string& fileName);
+    // Serialized settings and waves, used as both the hash input and file header
+    std::vector<uint8_t> Header() const;
+
+    WaveSet m_waves;
+    int m_activeWaves{0};
+    WaveLoopSettings m_settings;
+    std::vector<uint16_t> m_displacement;
+    std::vector<uint16_t> m_normals;
+};
+
+#endif
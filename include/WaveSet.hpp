@@ -0,0 +1,103 @@
+/** @file WaveSet.hpp
+ *  @brief The set of gerstner waves drawn by the ocean.
+ *
+ *  Holds the wave parameters on the CPU, premultiplies the per wave
+ *  constants and uploads them to the gerstner_waves texture buffer, and
+ *  evaluates the same wave sum as gerstner_tese.glsl so the surface can
+ *  be sampled on the CPU.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef WAVESET_HPP
+#define WAVESET_HPP
+
+#include <glad/glad.h>
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+// Parameters of one gerstner wave
+struct GerstnerWave{
+    glm::vec2 direction;
+    float amplitude;
+    float steepness;
+    float frequency;
+    float speed;
+    // Phase at time 0 in radians
+    float phase = 0.0f;
+};
+
+// Mirrors struct GerstnerWave in gerstner_tese.glsl, every product the
+// shader needs is computed once here instead of once per vertex
+struct GerstnerWaveConstants{
+    glm::vec2 direction;    // d
+    glm::vec2 waveVector;   // d * frequency
+    float amplitude;        // A
+    float width;            // steepness * A
+    float slope;            // A * frequency
+    float steepSlope;       // steepness * A * frequency
+    float speed;            // uploaded as the wrapped phase speed * time + phase
+    float phaseOffset;      // phase at time 0
+    float waveNumber;       // length(d * frequency), for band limiting
+};
+
+class WaveSet{
+public:
+    // Waves the gerstner_waves texture buffer holds
+    static const int kMaxWaves = 1024;
+    // Texels (RGBA32F) per wave in the texture buffer
+    static const int kTexelsPerWave = 3;
+
+    // Constructor creates the default four waves
+    WaveSet();
+    // Constructor from an explicit list of waves
+    WaveSet(const std::vector<GerstnerWave>& waves);
+    // Writes the first 'activeWaves' waves at 'time' seconds as the texels
+    // of the gerstner_waves texture, kTexelsPerWave per wave. Needs no GL
+    // context, so the simulation thread can do it.
+    void WriteTexels(int activeWaves, double time, std::vector<glm::vec4>& texels) const;
+    // Uploads num_of_waves to 'program', which must be the program currently
+    // in use, and 'texels' from WriteTexels into 'buffer', the buffer behind
+    // its gerstner_waves texture
+    static void Upload(GLuint program, GLuint buffer, const std::vector<glm::vec4>& texels);
+    // Phase speed * time + phase of wave 'wave', computed in double and wrapped
+    // to [0, 2pi) so it keeps full float precision however long the app runs
+    float Phase(int wave, double time) const;
+    // Displaced position of the surface point that starts at 'position' (xz)
+    // and its normal there, sharing one sin/cos per wave. The position is the
+    // same math as gerstner_wave() in gerstner_tese.glsl without the distance
+    // based fade (i.e. as seen from up close). The normal is the one the CPU
+    // systems use, the shader shades with ShadingNormal() instead.
+    glm::vec3 Evaluate(const glm::vec2& position, double time, int activeWaves, glm::vec3& normal) const;
+    // Normal gerstner_tese.glsl shades a vertex displaced to 'position' (xz)
+    // with: the normal sum evaluated at the displaced position, as the
+    // separate normal loop always did, with the premultiplied constants
+    glm::vec3 ShadingNormal(const glm::vec2& position, double time, int activeWaves) const;
+    // The separate position and normal loops gerstner_tese.glsl used before the
+    // fused evaluator, kept as the reference for --verify-waves. The normal
+    // was evaluated at the displaced position.
+    glm::vec3 EvaluateLegacyPosition(const glm::vec2& position, float time, int activeWaves) const;
+    glm::vec3 EvaluateLegacyNormal(const glm::vec3& position, float time, int activeWaves) const;
+    // Returns a copy whose wave vectors lie on the lattice of a 'tileSize'
+    // square tile, so the surface tiles in space.
+    WaveSet MakeTileable(float tileSize) const;
+    // Same as MakeTileable, and the speeds also repeat every 'period'
+    // seconds, so the surface loops in time.
+    WaveSet MakePeriodic(float tileSize, float period) const;
+    // Returns the waves
+    inline const std::vector<GerstnerWave>& waves() const { return m_waves; }
+    // Returns the premultiplied constants, one per wave
+    inline const std::vector<GerstnerWaveConstants>& constants() const { return m_constants; }
+    // Returns the number of waves
+    inline int size() const { return static_cast<int>(m_waves.size()); }
+private:
+    // Recomputes m_constants from m_waves
+    void ComputeConstants();
+
+    std::vector<GerstnerWave> m_waves;
+    std::vector<GerstnerWaveConstants> m_constants;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/** @file WaveSpectrum.hpp
+ *  @brief Gerstner waves sampled from a wind sea spectrum.
+ *
+ *  Turns a sea state (wind speed, fetch and direction) into a Pierson-
+ *  Moskowitz or JONSWAP frequency spectrum and samples it with any number
+ *  of gerstner waves. The frequency band around the peak is split into
+ *  bins of equal width on a log scale; each wave takes a random frequency
+ *  in its bin, the energy of the bin as its amplitude, the deep water
+ *  wave number and phase speed of that frequency, a direction from a cos^2
+ *  lobe around the wind and a random phase.
+ *
+ *  All waves share one steepness, picked so the sum of steepness *
+ *  amplitude * wave number is at most the choppiness, which is at most 1:
+ *  the horizontal displacement then never folds the surface over itself.
+ *
+ *  Waves come out longest first, so the first few are the main swells.
+ *
+ *  @author Ateek Ujjawal
+ *  @bug No known bugs.
+ */
+#ifndef WAVESPECTRUM_HPP
+#define WAVESPECTRUM_HPP
+
+#include "WaveSet.hpp"
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+// Wind sea spectra, both in angular frequency
+enum class WindSeaSpectrum{
+    // Fully developed sea, the fetch does not matter
+    PiersonMoskowitz,
+    // Fetch limited sea with a sharper peak
+    JONSWAP
+};
+
+struct SeaStateSettings{
+    WindSeaSpectrum spectrum = WindSeaSpectrum::JONSWAP;
+    // Wind speed in m/s ten metres above the water and the direction it is blowing towards
+    float windSpeed = 10.0f;
+    glm::vec2 windDirection = glm::vec2(0.8f, 0.6f);
+    // Distance in metres the wind has blown over water (JONSWAP only)
+    float fetch = 100000.0f;
+    // Number of waves to sample
+    int waveCount = 64;
+    // Shortest wavelength in metres, the top of the sampled band
+    float minWavelength = 1.0f;
+    // Sum of steepness * amplitude * wave number over the waves, 0 to 1.
+    // 0 moves the water only up and down, at 1 the sharpest crests pinch.
+    float choppiness = 0.8f;
+    unsigned int seed = 1;
+};
+
+class WaveSpectrum{
+public:
+    // Constructor works out the peak and scale of the spectrum
+    WaveSpectrum(const SeaStateSettings& settings);
+    // Samples settings.waveCount waves, longest first
+    std::vector<GerstnerWave> Generate() const;
+    // Spectral density in m^2 s at angular frequency 'omega'
+    float Density(float omega) const;
+    // Significant wave height (4 standard deviations of the height) of the
+    // whole spectrum, integrated numerically
+    float SignificantWaveHeight() const;
+    // Returns the angular frequency of the peak
+    inline float getPeakFrequency() const { return m_peakFrequency; }
+    // Returns the settings
+    inline const SeaStateSettings& settings() const { return m_settings; }
+private:
+    SeaStateSettings m_settings;
+    // Phillips constant, peak angular frequency and peak enhancement
+    float m_alpha{0.0f};
+    float m_peakFrequency{1.0f};
+    float m_gamma{1.0f};
+};
+
+#endif
@@ -0,0 +1,17 @@
+#version 410
+out vec4 FragColor;
+
+in vec3 v_WorldPosition;
+in vec3 v_Color;
+
+// Same sun for every body
+const vec3 SUN_DIRECTION = normalize(vec3(0.4, 0.8, 0.3));
+
+void main()
+{
+    // Flat normal of the face from the screen space derivatives, it points
+    // towards the camera like the outside of every visible face does
+    vec3 normal = normalize(cross(dFdx(v_WorldPosition), dFdy(v_WorldPosition)));
+    float diffuse = max(dot(normal, SUN_DIRECTION), 0.0);
+    FragColor = vec4(v_Color * (0.35 + 0.65 * diffuse), 1.0);
+}
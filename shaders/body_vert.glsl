@@ -0,0 +1,39 @@
+#version 410
+// Unit cube, shared with the skybox
+layout (location = 0) in vec3 aPos;
+// Per body: position, orientation quaternion (x, y, z, w), half extents
+layout (location = 1) in vec4 i_Position;
+layout (location = 2) in vec4 i_Orientation;
+layout (location = 3) in vec4 i_HalfExtents;
+
+// Per frame data, one std140 block written by the CPU into a UniformRing slot.
+// Every shader that reads it declares it identically
+layout(std140) uniform FrameUniforms {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection; // We'll use a perspective projection
+    mat4 u_SkyboxView; // u_ViewMatrix without the translation
+    vec3 cameraPos;
+    // World size of one pixel per unit of distance from the camera
+    float u_PixelAngle;
+    // Shorter waves are drawn by the detail normal map in frag.glsl instead
+    float u_DetailWaveNumber;
+};
+
+out vec3 v_WorldPosition;
+out vec3 v_Color;
+
+// Rotates 'v' by the unit quaternion 'q'
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    v_WorldPosition = i_Position.xyz + rotate(i_Orientation, aPos * i_HalfExtents.xyz);
+    // A few shades of weathered wood, picked per body
+    float shade = fract(sin(float(gl_InstanceID) * 12.9898) * 43758.5453);
+    v_Color = mix(vec3(0.35, 0.22, 0.12), vec3(0.75, 0.62, 0.45), shade);
+    gl_Position = u_Projection * u_ViewMatrix * vec4(v_WorldPosition, 1.0);
+}
@@ -0,0 +1,40 @@
+#version 410
+
+// Fragment shader for the FFT ocean
+// Same refraction as frag.glsl, but the normal comes from the FFT normal map
+// so that small waves still shade correctly where the geometry is coarse.
+
+uniform samplerCube skybox;
+uniform sampler2D u_NormalMap;
+// Per frame data, one std140 block written by the CPU into a UniformRing slot.
+// Every shader that reads it declares it identically
+layout(std140) uniform FrameUniforms {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection; // We'll use a perspective projection
+    mat4 u_SkyboxView; // u_ViewMatrix without the translation
+    vec3 cameraPos;
+    // World size of one pixel per unit of distance from the camera
+    float u_PixelAngle;
+    // Shorter waves are drawn by the detail normal map in frag.glsl instead
+    float u_DetailWaveNumber;
+};
+
+in VertexData {
+    vec3 v_vertexPosition;
+    vec3 v_vertexNormals;
+    vec2 v_texCoords;
+} fs_in;
+
+out vec4 color;
+
+// Entry point of program
+void main()
+{
+    // Refractive index of water
+    float ratio = 1.00 / 1.33;
+    vec3 N = normalize(texture(u_NormalMap, fs_in.v_texCoords).xyz);
+    vec3 I = normalize(fs_in.v_vertexPosition - cameraPos);
+    vec3 R = refract(I, N, ratio);
+	color = vec4(texture(skybox, R).rgb, 1.0f);
+}
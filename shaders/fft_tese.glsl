@@ -0,0 +1,59 @@
+#version 410
+
+// Tessellation evaluation shader for the FFT ocean
+// Same patch interpolation as gerstner_tese.glsl, but instead of summing waves
+// analytically every vertex is displaced by the CPU generated FFT displacement
+// map. The map is tileable, so world xz coordinates are used directly as
+// texture coordinates scaled by the size of one tile.
+
+layout(quads, fractional_even_spacing) in;
+
+// Per frame data, one std140 block written by the CPU into a UniformRing slot.
+// Every shader that reads it declares it identically
+layout(std140) uniform FrameUniforms {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection; // We'll use a perspective projection
+    mat4 u_SkyboxView; // u_ViewMatrix without the translation
+    vec3 cameraPos;
+    // World size of one pixel per unit of distance from the camera
+    float u_PixelAngle;
+    // Shorter waves are drawn by the detail normal map in frag.glsl instead
+    float u_DetailWaveNumber;
+};
+
+// xyz = (choppy x, height, choppy z)
+uniform sampler2D u_Displacement;
+// World size of one tile of the displacement and normal maps
+uniform float u_PatchSize;
+// Mip level matching the spacing of the tessellated vertices
+uniform float u_DisplacementLod;
+
+in VertexData {
+    vec3 v_vertexPosition;
+    vec3 v_vertexNormals;
+} te_in[];
+
+out VertexData {
+    vec3 v_vertexPosition;
+    vec3 v_vertexNormals;
+    vec2 v_texCoords;
+} te_out;
+
+void main() {
+    // Interpolate positions, normals using gl_TessCoord as the weights
+    vec3 x_up_position_mix = mix(te_in[0].v_vertexPosition, te_in[3].v_vertexPosition, gl_TessCoord.x);
+    vec3 x_down_position_mix = mix(te_in[1].v_vertexPosition, te_in[2].v_vertexPosition, gl_TessCoord.x);
+    vec3 position = mix(x_down_position_mix, x_up_position_mix, gl_TessCoord.y);
+
+    vec3 x_up_normal_mix = mix(te_in[0].v_vertexNormals, te_in[3].v_vertexNormals, gl_TessCoord.x);
+    vec3 x_down_normal_mix = mix(te_in[1].v_vertexNormals, te_in[2].v_vertexNormals, gl_TessCoord.x);
+    te_out.v_vertexNormals = mix(x_down_normal_mix, x_up_normal_mix, gl_TessCoord.y);
+
+    // Displace the tessellated geometry by the FFT displacement map
+    te_out.v_texCoords = position.xz / u_PatchSize;
+    te_out.v_vertexPosition = position + textureLod(u_Displacement, te_out.v_texCoords, u_DisplacementLod).xyz;
+    vec4 world_position = vec4(te_out.v_vertexPosition, 1);
+
+    gl_Position = u_Projection * u_ViewMatrix * world_position;
+}
@@ -2,7 +2,35 @@
 
 //uniform sampler2D tex;
 uniform samplerCube skybox;
-uniform vec3 cameraPos;
+// Per frame data, one std140 block written by the CPU into a UniformRing slot.
+// Every shader that reads it declares it identically
+layout(std140) uniform FrameUniforms {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection; // We'll use a perspective projection
+    mat4 u_SkyboxView; // u_ViewMatrix without the translation
+    vec3 cameraPos;
+    // World size of one pixel per unit of distance from the camera
+    float u_PixelAngle;
+    // Shorter waves are drawn by the detail normal map in frag.glsl instead
+    float u_DetailWaveNumber;
+};
+
+// DETAIL_MAP is defined by the CPU for the gerstner ocean with --detail-map.
+// A compile time switch, since llvmpipe pays for a texture fetch even behind
+// a uniform that turns it off.
+#ifdef DETAIL_MAP
+// Normal terms of the waves too short for the mesh (see DetailNormalMap),
+// tiled every u_DetailTileSize and added to the mesh normal
+uniform sampler2D u_DetailNormals;
+uniform float u_DetailTileSize;
+
+// The map is also read a second time, turned by about 37 degrees and
+// stretched by the golden ratio, so the two lookups never repeat together
+// and the tile does not show as a grid
+const mat2 DETAIL_ROTATION = mat2(0.8, 0.6, -0.6, 0.8);
+const float DETAIL_STRETCH = 1.0 / 1.618034;
+#endif
 
 in VertexData {
     vec3 v_vertexPosition;
@@ -17,8 +45,19 @@ void main()
     // Refractive index of water
     float ratio = 1.00 / 1.33;
     vec3 I = normalize(fs_in.v_vertexPosition - cameraPos);
-    //vec3 R = reflect(I, normalize(fs_in.v_vertexNormals));
-    vec3 R = refract(I, normalize(fs_in.v_vertexNormals), ratio);
+    vec3 normal = fs_in.v_vertexNormals;
+#ifdef DETAIL_MAP
+    vec2 uv = fs_in.v_vertexPosition.xz / u_DetailTileSize;
+    vec3 detail = texture(u_DetailNormals, uv).xyz;
+    vec3 turned = texture(u_DetailNormals, DETAIL_ROTATION * uv * DETAIL_STRETCH).xyz;
+    // Turn the slopes of the second lookup back into world space
+    turned.xz = turned.xz * DETAIL_ROTATION;
+    // Two unrelated lookups, scaled so the summed slopes keep their strength
+    normal += 0.70710678 * (detail + turned);
+#endif
+    normal = normalize(normal);
+    //vec3 R = reflect(I, normal);
+    vec3 R = refract(I, normal, ratio);
     //vec3 diffuseColor =  0.5 * texture(tex, fs_in.v_texCoords).rgb;
     // if (R.y <= 0.0f) {
     //     R.y = -R.y;
@@ -7,6 +7,23 @@
 
 layout(vertices = 4) out;
 
+const float PI = 3.14159265;
+
+uniform float u_TessLevel;
+// Per frame data, one std140 block written by the CPU into a UniformRing slot.
+// Every shader that reads it declares it identically
+layout(std140) uniform FrameUniforms {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection; // We'll use a perspective projection
+    mat4 u_SkyboxView; // u_ViewMatrix without the translation
+    vec3 cameraPos;
+    // World size of one pixel per unit of distance from the camera
+    float u_PixelAngle;
+    // Shorter waves are drawn by the detail normal map in frag.glsl instead
+    float u_DetailWaveNumber;
+};
+
 in VertexData {
     vec3 v_vertexPosition;
     vec3 v_vertexNormals;
@@ -17,12 +34,28 @@ out VertexData {
     vec3 v_vertexNormals;
 } tc_out[];
 
+// Largest wave number that is at least two pixels long anywhere on this patch
+// and not left to the detail normal map
+patch out float tc_max_wave_number;
+
 void main() {
     // Just forward the vertex attributes through the GL pipeline.
     tc_out[gl_InvocationID].v_vertexPosition = tc_in[gl_InvocationID].v_vertexPosition;
     tc_out[gl_InvocationID].v_vertexNormals = tc_in[gl_InvocationID].v_vertexNormals;
 
-    float tess_level = 100.0;
+    float tess_level = u_TessLevel;
+
+    // The point of the patch closest to the camera has the smallest pixels,
+    // waves too short to show up there cannot show up anywhere on the patch
+    if (gl_InvocationID == 0) {
+        vec2 patch_min = min(min(tc_in[0].v_vertexPosition.xz, tc_in[1].v_vertexPosition.xz),
+                             min(tc_in[2].v_vertexPosition.xz, tc_in[3].v_vertexPosition.xz));
+        vec2 patch_max = max(max(tc_in[0].v_vertexPosition.xz, tc_in[1].v_vertexPosition.xz),
+                             max(tc_in[2].v_vertexPosition.xz, tc_in[3].v_vertexPosition.xz));
+        vec2 closest = clamp(cameraPos.xz, patch_min, patch_max);
+        float pixel_size = max(distance(vec3(closest.x, 0.0, closest.y), cameraPos), 1.0) * u_PixelAngle;
+        tc_max_wave_number = min(PI / pixel_size, u_DetailWaveNumber);
+    }
 
     // Define inner and outer tessellation levels
     // For quads it has 2 inner levels and 4 outer levels
@@ -9,9 +9,21 @@
 // We use quads with a fractional even spacing tessellation to smoothen the edges
 layout(quads, fractional_even_spacing) in;
 
-uniform mat4 u_ViewMatrix;
-uniform mat4 u_Projection; // We'll use a perspective projection
-uniform mat4 u_ModelMatrix;
+// Per frame data, one std140 block written by the CPU into a UniformRing slot.
+// Every shader that reads it declares it identically
+layout(std140) uniform FrameUniforms {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection; // We'll use a perspective projection
+    mat4 u_SkyboxView; // u_ViewMatrix without the translation
+    vec3 cameraPos;
+    // World size of one pixel per unit of distance from the camera
+    float u_PixelAngle;
+    // Shorter waves are drawn by the detail normal map in frag.glsl instead
+    float u_DetailWaveNumber;
+};
+
+const float PI = 3.14159265;
 
 in VertexData {
     vec3 v_vertexPosition;
@@ -23,63 +35,62 @@ out VertexData {
     vec3 v_vertexNormals;
 } te_out;
 
-uniform uint num_of_waves = 0;
-uniform float time;
-uniform struct GerstnerWave {
-    vec2 direction;
-    float amplitude;
-    float steepness;
-    float frequency;
-    float speed;
-} gerstner_waves[5];
-
-vec3 gerstner_wave_normal(vec3 position, float time) {
-    vec3 wave_normal = vec3(0.0, 1.0, 0.0);
-
-    for (uint i = 0; i < num_of_waves; ++i) {
-        float psi = dot(position.xz, gerstner_waves[i].direction) * gerstner_waves[i].frequency +
-                    time * gerstner_waves[i].speed,
-              alpha = gerstner_waves[i].amplitude * gerstner_waves[i].frequency * sin(psi);
-
-        wave_normal.y -= gerstner_waves[i].steepness * alpha;
-
-        float x = gerstner_waves[i].direction.x,
-              y = gerstner_waves[i].direction.y,
-              omega = gerstner_waves[i].amplitude * gerstner_waves[i].frequency * cos(psi);
-
-        wave_normal.x -= x * omega;
-        wave_normal.z -= y * omega;
-    } 
-    
-    return wave_normal;
-}
+// Waves above this wave number are under two pixels long on the whole patch,
+// or drawn by the detail normal map
+patch in float tc_max_wave_number;
 
-vec3 gerstner_wave_position(vec2 position, float time) {
+uniform uint num_of_waves = 0;
+// Per wave constants, premultiplied on the CPU by WaveSet::WriteTexels so the
+// loops below do not redo the same products for every vertex. A texture
+// buffer instead of a uniform array, so a sampled spectrum of hundreds of
+// waves fits. Three texels per wave:
+//   0: direction (d), wave_vector (d * frequency)
+//   1: amplitude (A), width (steepness * A, horizontal displacement),
+//      slope (A * frequency, normal x/z), steep_slope (steepness * A * frequency, normal y)
+//   2: phase (speed * time + phase, wrapped to [0, 2pi) in double on the CPU),
+//      wave_number (length(wave_vector))
+uniform samplerBuffer gerstner_waves;
+
+// Displaces 'position' by the sum of gerstner waves and writes the normal at
+// the displaced position, where the separate normal loop always took it.
+// Each loop reads the premultiplied constants and takes one sin/cos per wave.
+// Waves shorter than four pixels fade out and are gone at two, 'pixel_size'
+// is the world size of one pixel at this vertex.
+vec3 gerstner_wave(vec2 position, float pixel_size, out vec3 normal) {
     vec3 wave_position = vec3(position.x, 0, position.y);
 
-    for (uint i = 0; i < num_of_waves; ++i) {
-        float theta = dot(position, gerstner_waves[i].direction) * gerstner_waves[i].frequency
-                      + time * gerstner_waves[i].speed,
-              height = gerstner_waves[i].amplitude * sin(theta);
-
-        wave_position.y += height;
-
-        float maximum_width = gerstner_waves[i].steepness *
-                              gerstner_waves[i].amplitude,
-              width = maximum_width * cos(theta),
-              x = gerstner_waves[i].direction.x,
-              y = gerstner_waves[i].direction.y;
-
-        wave_position.x += x * width;
-        wave_position.z += y * width;
-    } 
-    
-    return wave_position;
-}
+    for (int i = 0; i < int(num_of_waves); ++i) {
+        vec4 phase_and_number = texelFetch(gerstner_waves, 3 * i + 2);
+        // Same for the whole patch, distant patches only pay for the long swells
+        if (phase_and_number.y > tc_max_wave_number) {
+            continue;
+        }
+        vec4 vectors = texelFetch(gerstner_waves, 3 * i);
+        vec4 shape = texelFetch(gerstner_waves, 3 * i + 1);
+
+        float fade = 1.0 - smoothstep(0.5, 1.0, phase_and_number.y * pixel_size / PI),
+              theta = dot(position, vectors.zw) + phase_and_number.x;
+
+        wave_position.y += shape.x * fade * sin(theta);
+        wave_position.xz += vectors.xy * (shape.y * fade * cos(theta));
+    }
+
+    normal = vec3(0.0, 1.0, 0.0);
+    for (int i = 0; i < int(num_of_waves); ++i) {
+        vec4 phase_and_number = texelFetch(gerstner_waves, 3 * i + 2);
+        if (phase_and_number.y > tc_max_wave_number) {
+            continue;
+        }
+        vec4 vectors = texelFetch(gerstner_waves, 3 * i);
+        vec4 shape = texelFetch(gerstner_waves, 3 * i + 1);
+
+        float fade = 1.0 - smoothstep(0.5, 1.0, phase_and_number.y * pixel_size / PI),
+              theta = dot(wave_position.xz, vectors.zw) + phase_and_number.x;
+
+        normal.y -= shape.w * fade * sin(theta);
+        normal.xz -= vectors.xy * (shape.z * fade * cos(theta));
+    }
 
-vec3 gerstner_wave(vec2 position, float time, inout vec3 normal) {
-    vec3 wave_position = gerstner_wave_position(position, time);
-    normal = gerstner_wave_normal(wave_position, time);
     return wave_position;
 }
 
@@ -95,7 +106,9 @@ void main() {
 
     // Displace the tessellated geometry in the direction of the normal by us-
     // ing a sum of Gerstner waves.
-    te_out.v_vertexPosition = gerstner_wave(te_out.v_vertexPosition.xz, time,  te_out.v_vertexNormals);
+    // Per vertex so neighbouring patches agree along their shared edge
+    float pixel_size = max(distance(te_out.v_vertexPosition, cameraPos), 1.0) * u_PixelAngle;
+    te_out.v_vertexPosition = gerstner_wave(te_out.v_vertexPosition.xz, pixel_size, te_out.v_vertexNormals);
     vec4 world_position = vec4(te_out.v_vertexPosition, 1);
 
     gl_Position = u_Projection * u_ViewMatrix * world_position;
@@ -0,0 +1,57 @@
+#version 410
+
+// Tessellation evaluation shader for the baked wave loop
+// Same patch interpolation as gerstner_tese.glsl, but the gerstner sum has been
+// evaluated ahead of time for one tile and one loop period. Displacement and
+// normals live in 3D textures with time along r, so every vertex costs one
+// filtered fetch from each no matter how many waves were baked.
+
+layout(quads, fractional_even_spacing) in;
+
+// Per frame data, one std140 block written by the CPU into a UniformRing slot.
+// Every shader that reads it declares it identically
+layout(std140) uniform FrameUniforms {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection; // We'll use a perspective projection
+    mat4 u_SkyboxView; // u_ViewMatrix without the translation
+    vec3 cameraPos;
+    // World size of one pixel per unit of distance from the camera
+    float u_PixelAngle;
+    // Shorter waves are drawn by the detail normal map in frag.glsl instead
+    float u_DetailWaveNumber;
+};
+
+// xyz = (x displacement, height, z displacement)
+uniform sampler3D u_LoopDisplacement;
+uniform sampler3D u_LoopNormals;
+// World size of the baked tile
+uniform float u_LoopTileSize;
+// Position in the loop, 0 at the start and 1 at the end
+uniform float u_LoopPhase;
+
+in VertexData {
+    vec3 v_vertexPosition;
+    vec3 v_vertexNormals;
+} te_in[];
+
+out VertexData {
+    vec3 v_vertexPosition;
+    vec3 v_vertexNormals;
+} te_out;
+
+void main() {
+    // Interpolate positions, normals using gl_TessCoord as the weights
+    vec3 x_up_position_mix = mix(te_in[0].v_vertexPosition, te_in[3].v_vertexPosition, gl_TessCoord.x);
+    vec3 x_down_position_mix = mix(te_in[1].v_vertexPosition, te_in[2].v_vertexPosition, gl_TessCoord.x);
+    vec3 position = mix(x_down_position_mix, x_up_position_mix, gl_TessCoord.y);
+
+    // Both textures repeat in all three directions, so the tile wraps in
+    // space and the last frame blends back into the first one
+    vec3 loop_coord = vec3(position.xz / u_LoopTileSize, u_LoopPhase);
+    te_out.v_vertexPosition = position + texture(u_LoopDisplacement, loop_coord).xyz;
+    te_out.v_vertexNormals = texture(u_LoopNormals, loop_coord).xyz;
+    vec4 world_position = vec4(te_out.v_vertexPosition, 1);
+
+    gl_Position = u_Projection * u_ViewMatrix * world_position;
+}
@@ -0,0 +1,26 @@
+#version 410
+out vec4 FragColor;
+
+in vec2 v_TexCoord;
+
+// Ocean and skybox rendered at the dynamic resolution scale
+uniform sampler2D u_Scene;
+// 0 is a plain bilinear upscale, 1 the strongest sharpening
+uniform float u_Sharpness;
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(u_Scene, 0));
+    vec3 center = texture(u_Scene, v_TexCoord).rgb;
+    vec3 north = texture(u_Scene, v_TexCoord + vec2(0.0, texel.y)).rgb;
+    vec3 south = texture(u_Scene, v_TexCoord - vec2(0.0, texel.y)).rgb;
+    vec3 east = texture(u_Scene, v_TexCoord + vec2(texel.x, 0.0)).rgb;
+    vec3 west = texture(u_Scene, v_TexCoord - vec2(texel.x, 0.0)).rgb;
+
+    // Unsharp mask: push the pixel away from the average of its neighbours,
+    // then clamp to their range so edges do not ring
+    vec3 sharpened = center + u_Sharpness * (center - 0.25 * (north + south + east + west));
+    vec3 lowest = min(center, min(min(north, south), min(east, west)));
+    vec3 highest = max(center, max(max(north, south), max(east, west)));
+    FragColor = vec4(clamp(sharpened, lowest, highest), 1.0);
+}
@@ -0,0 +1,12 @@
+#version 410
+
+out vec2 v_TexCoord;
+
+void main()
+{
+    // One triangle that covers the screen, corners (0,0), (2,0) and (0,2)
+    // in texture space, so no vertex buffer is needed
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    v_TexCoord = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
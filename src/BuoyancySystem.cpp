@@ -0,0 +1,225 @@
+#include "BuoyancySystem.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include "glm/gtc/quaternion.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace{
+// Hull points in units of the half extents: the centres of the eight octants
+const glm::vec3 kHullCentres[BuoyancySystem::kHullPoints] = {
+    glm::vec3(-0.5f, -0.5f, -0.5f),
+    glm::vec3( 0.5f, -0.5f, -0.5f),
+    glm::vec3( 0.5f, -0.5f,  0.5f),
+    glm::vec3(-0.5f, -0.5f,  0.5f),
+    glm::vec3(-0.5f,  0.5f, -0.5f),
+    glm::vec3( 0.5f,  0.5f, -0.5f),
+    glm::vec3( 0.5f,  0.5f,  0.5f),
+    glm::vec3(-0.5f,  0.5f,  0.5f)
+};
+
+// Settings of the per thread surface queries
+SurfaceQuerySettings QuerySettings(const BuoyancySettings& settings){
+    SurfaceQuerySettings query;
+    query.maxIterations = settings.queryIterations;
+    query.tolerance = settings.queryTolerance;
+    query.threadCount = 1;
+    query.chunkSize = settings.batchSize * BuoyancySystem::kHullPoints;
+    query.warmStart = true;
+    return query;
+}
+}
+
+// Constructor, the bodies float on the first 'activeWaves' waves of 'waves'
+BuoyancySystem::BuoyancySystem(const WaveSet& waves, int activeWaves, const BuoyancySettings& settings)
+    : m_settings(settings){
+    m_settings.batchSize = std::max(1, m_settings.batchSize);
+    m_settings.maxSteps = std::max(1, m_settings.maxSteps);
+    m_threadCount = m_settings.threadCount;
+    if(m_threadCount <= 0){
+        m_threadCount = JobSystem::getConcurrency();
+    }
+    m_samples.resize(m_threadCount);
+    SetWaves(waves, activeWaves);
+}
+
+// Switches to other waves, the bodies keep their state
+void BuoyancySystem::SetWaves(const WaveSet& waves, int activeWaves){
+    m_queries.clear();
+    for(int t = 0; t < m_threadCount; ++t){
+        m_queries.emplace_back(waves, activeWaves, QuerySettings(m_settings));
+    }
+}
+
+// Adds a box at rest
+void BuoyancySystem::AddBody(const glm::vec3& position, const glm::vec3& halfExtents, float density, float yaw){
+    glm::quat orientation = glm::angleAxis(yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+    float mass = density * 8.0f * halfExtents.x * halfExtents.y * halfExtents.z;
+    glm::vec3 squared = halfExtents * halfExtents;
+
+    m_bodies.positionX.push_back(position.x);
+    m_bodies.positionY.push_back(position.y);
+    m_bodies.positionZ.push_back(position.z);
+    m_bodies.velocityX.push_back(0.0f);
+    m_bodies.velocityY.push_back(0.0f);
+    m_bodies.velocityZ.push_back(0.0f);
+    m_bodies.orientationW.push_back(orientation.w);
+    m_bodies.orientationX.push_back(orientation.x);
+    m_bodies.orientationY.push_back(orientation.y);
+    m_bodies.orientationZ.push_back(orientation.z);
+    m_bodies.spinX.push_back(0.0f);
+    m_bodies.spinY.push_back(0.0f);
+    m_bodies.spinZ.push_back(0.0f);
+    m_bodies.halfX.push_back(halfExtents.x);
+    m_bodies.halfY.push_back(halfExtents.y);
+    m_bodies.halfZ.push_back(halfExtents.z);
+    m_bodies.mass.push_back(mass);
+    // Solid box: I = m / 3 * (sum of the other two half extents squared)
+    m_bodies.inverseInertiaX.push_back(3.0f / (mass * (squared.y + squared.z)));
+    m_bodies.inverseInertiaY.push_back(3.0f / (mass * (squared.x + squared.z)));
+    m_bodies.inverseInertiaZ.push_back(3.0f / (mass * (squared.x + squared.y)));
+    m_bodies.submerged.push_back(0.0f);
+    // Below each hull point is as good a first guess as any
+    for(int k = 0; k < kHullPoints; ++k){
+        glm::vec3 point = position + orientation * (kHullCentres[k] * halfExtents);
+        m_bodies.hullSourceX.push_back(point.x);
+        m_bodies.hullSourceZ.push_back(point.z);
+    }
+}
+
+// Runs the physics steps that fit up to wave time 'time'
+void BuoyancySystem::Update(double time, float dt){
+    m_accumulator += std::max(0.0f, dt);
+    m_lastSteps = 0;
+    while(m_accumulator >= m_settings.step && m_lastSteps < m_settings.maxSteps){
+        m_accumulator -= m_settings.step;
+        Step(time - m_accumulator);
+        ++m_lastSteps;
+    }
+    // A long hitch would otherwise be caught up over the next frames
+    m_accumulator = std::min(m_accumulator, m_settings.step);
+}
+
+// Runs one physics step, ending at wave time 'time'
+void BuoyancySystem::Step(double time){
+    PROFILE_ZONE("BuoyancySystem::Step");
+    auto start = std::chrono::steady_clock::now();
+    for(SurfaceQuery& query : m_queries){
+        query.SetTime(time);
+    }
+
+    const size_t batchSize = static_cast<size_t>(m_settings.batchSize);
+    const size_t batches = (size() + batchSize - 1) / batchSize;
+    std::atomic<size_t> nextBatch{0};
+    auto work = [&](size_t thread){
+        PROFILE_ZONE("BuoyancySystem::Work");
+        for(size_t batch = nextBatch.fetch_add(1); batch < batches; batch = nextBatch.fetch_add(1)){
+            size_t first = batch * batchSize;
+            StepBatch(first, std::min(first + batchSize, size()), m_queries[thread], m_samples[thread]);
+        }
+    };
+
+    // One job per thread, each with its own query and samples
+    JobSystem::ParallelFor(std::min<size_t>(m_threadCount, batches), 1, [&](size_t first, size_t last){
+        for(size_t thread = first; thread < last; ++thread){
+            work(thread);
+        }
+    });
+    m_stepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Updates the bodies [begin, end)
+void BuoyancySystem::StepBatch(size_t begin, size_t end, SurfaceQuery& query, SurfaceQueryBatch& samples){
+    BodyArrays& b = m_bodies;
+    const float dt = m_settings.step;
+    const size_t count = end - begin;
+
+    // Hull points of the whole batch first, so the surface is queried in one go
+    samples.Resize(count * kHullPoints);
+    for(size_t i = 0; i < count; ++i){
+        size_t body = begin + i;
+        glm::quat orientation(b.orientationW[body], b.orientationX[body], b.orientationY[body], b.orientationZ[body]);
+        glm::vec3 position(b.positionX[body], b.positionY[body], b.positionZ[body]);
+        glm::vec3 half(b.halfX[body], b.halfY[body], b.halfZ[body]);
+        for(int k = 0; k < kHullPoints; ++k){
+            glm::vec3 point = position + orientation * (kHullCentres[k] * half);
+            samples.x[i * kHullPoints + k] = point.x;
+            samples.z[i * kHullPoints + k] = point.z;
+        }
+    }
+    // Each point starts from its last source, so it stays on the same fold
+    std::copy(b.hullSourceX.begin() + begin * kHullPoints, b.hullSourceX.begin() + end * kHullPoints, samples.sourceX.begin());
+    std::copy(b.hullSourceZ.begin() + begin * kHullPoints, b.hullSourceZ.begin() + end * kHullPoints, samples.sourceZ.begin());
+    query.Solve(samples);
+    std::copy(samples.sourceX.begin(), samples.sourceX.end(), b.hullSourceX.begin() + begin * kHullPoints);
+    std::copy(samples.sourceZ.begin(), samples.sourceZ.end(), b.hullSourceZ.begin() + begin * kHullPoints);
+
+    for(size_t i = 0; i < count; ++i){
+        size_t body = begin + i;
+        glm::quat orientation(b.orientationW[body], b.orientationX[body], b.orientationY[body], b.orientationZ[body]);
+        glm::vec3 position(b.positionX[body], b.positionY[body], b.positionZ[body]);
+        glm::vec3 half(b.halfX[body], b.halfY[body], b.halfZ[body]);
+        glm::vec3 velocity(b.velocityX[body], b.velocityY[body], b.velocityZ[body]);
+        glm::vec3 spin(b.spinX[body], b.spinY[body], b.spinZ[body]);
+        float mass = b.mass[body];
+
+        // Each octant is taken to be submerged by how far the surface reaches
+        // up its vertical extent, which is the same in every orientation
+        glm::mat3 rotation = glm::mat3_cast(orientation);
+        float octantVolume = half.x * half.y * half.z;
+        float octantHeight = std::abs(rotation[0].y) * half.x + std::abs(rotation[1].y) * half.y +
+                             std::abs(rotation[2].y) * half.z;
+        glm::vec3 force(0.0f, -mass * m_settings.gravity, 0.0f);
+        glm::vec3 torque(0.0f);
+        float submerged = 0.0f;
+        for(int k = 0; k < kHullPoints; ++k){
+            glm::vec3 arm = rotation * (kHullCentres[k] * half);
+            float depth = samples.height[i * kHullPoints + k] - (position.y + arm.y);
+            float fraction = glm::clamp(depth / octantHeight + 0.5f, 0.0f, 1.0f);
+            glm::vec3 lift(0.0f, m_settings.gravity * octantVolume * fraction, 0.0f);
+            force += lift;
+            torque += glm::cross(arm, lift);
+            submerged += fraction / kHullPoints;
+        }
+
+        // Semi-implicit Euler, the inertia is turned into world space
+        glm::vec3 inverseInertia(b.inverseInertiaX[body], b.inverseInertiaY[body], b.inverseInertiaZ[body]);
+        glm::vec3 angularAcceleration = rotation * (inverseInertia * (glm::transpose(rotation) * torque));
+        velocity += force / mass * dt;
+        spin += angularAcceleration * dt;
+        velocity *= std::max(0.0f, 1.0f - m_settings.linearDrag * submerged * dt);
+        spin *= std::max(0.0f, 1.0f - m_settings.angularDrag * submerged * dt);
+
+        position += velocity * dt;
+        orientation = glm::normalize(orientation + glm::quat(0.0f, spin * (0.5f * dt)) * orientation);
+
+        b.positionX[body] = position.x;
+        b.positionY[body] = position.y;
+        b.positionZ[body] = position.z;
+        b.velocityX[body] = velocity.x;
+        b.velocityY[body] = velocity.y;
+        b.velocityZ[body] = velocity.z;
+        b.orientationW[body] = orientation.w;
+        b.orientationX[body] = orientation.x;
+        b.orientationY[body] = orientation.y;
+        b.orientationZ[body] = orientation.z;
+        b.spinX[body] = spin.x;
+        b.spinY[body] = spin.y;
+        b.spinZ[body] = spin.z;
+        b.submerged[body] = submerged;
+    }
+}
+
+// Writes three vec4 per body: position, orientation (x, y, z, w) and half extents
+void BuoyancySystem::WriteInstances(std::vector<glm::vec4>& instances) const{
+    const BodyArrays& b = m_bodies;
+    instances.resize(size() * 3);
+    for(size_t body = 0; body < size(); ++body){
+        instances[body * 3 + 0] = glm::vec4(b.positionX[body], b.positionY[body], b.positionZ[body], 1.0f);
+        instances[body * 3 + 1] = glm::vec4(b.orientationX[body], b.orientationY[body], b.orientationZ[body], b.orientationW[body]);
+        instances[body * 3 + 2] = glm::vec4(b.halfX[body], b.halfY[body], b.halfZ[body], 0.0f);
+    }
+}
@@ -0,0 +1,74 @@
+#include "DetailNormalMap.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Constructor keeps a copy of 'waves' that tiles every settings.tileSize
+DetailNormalMap::DetailNormalMap(const WaveSet& waves, const DetailNormalSettings& settings)
+    : m_settings(settings),
+      m_periodic(waves.MakeTileable(settings.tileSize)){
+    for(const GerstnerWaveConstants& constants : waves.constants()){
+        m_waveNumbers.push_back(constants.waveNumber);
+    }
+    m_normals.resize(static_cast<size_t>(m_settings.resolution) * m_settings.resolution * 3);
+}
+
+// Sums the selected waves into the map at 'time' seconds
+void DetailNormalMap::Update(double time, int activeWaves, float minWaveNumber){
+    const int resolution = m_settings.resolution;
+    const float texelSize = m_settings.tileSize / resolution;
+
+    // sin/cos of the x and z parts of the phase, theta = kx * x + (kz * z + phase)
+    // splits into one table per axis and the texels only need the angle sum.
+    // One table per wave up front, so the rows below can be split over threads
+    m_selected.clear();
+    int count = std::min(activeWaves, m_periodic.size());
+    for(int i = 0; i < count; ++i){
+        if(m_waveNumbers[i] >= minWaveNumber){
+            m_selected.push_back(i);
+        }
+    }
+    m_waveCount = static_cast<int>(m_selected.size());
+    m_tables.resize(m_selected.size() * resolution * 4);
+    for(size_t w = 0; w < m_selected.size(); ++w){
+        const GerstnerWaveConstants& wave = m_periodic.constants()[m_selected[w]];
+        float phase = m_periodic.Phase(m_selected[w], time);
+        float* sinX = &m_tables[w * resolution * 4];
+        float* cosX = sinX + resolution;
+        float* sinZ = cosX + resolution;
+        float* cosZ = sinZ + resolution;
+        for(int j = 0; j < resolution; ++j){
+            float position = (j + 0.5f) * texelSize;
+            sinX[j] = std::sin(wave.waveVector.x * position);
+            cosX[j] = std::cos(wave.waveVector.x * position);
+            sinZ[j] = std::sin(wave.waveVector.y * position + phase);
+            cosZ[j] = std::cos(wave.waveVector.y * position + phase);
+        }
+    }
+
+    JobSystem::ParallelFor(resolution, 0, [&](size_t first, size_t last){
+        PROFILE_ZONE("DetailNormalMap::Rows");
+        for(size_t z = first; z < last; ++z){
+            float* row = &m_normals[z * resolution * 3];
+            std::fill(row, row + resolution * 3, 0.0f);
+            for(size_t w = 0; w < m_selected.size(); ++w){
+                const GerstnerWaveConstants& wave = m_periodic.constants()[m_selected[w]];
+                const float* sinX = &m_tables[w * resolution * 4];
+                const float* cosX = sinX + resolution;
+                float sinZ = cosX[resolution + z];
+                float cosZ = cosX[2 * resolution + z];
+                for(int x = 0; x < resolution; ++x){
+                    float s = sinX[x] * cosZ + cosX[x] * sinZ;
+                    float c = cosX[x] * cosZ - sinX[x] * sinZ;
+
+                    // Same terms as the normal in gerstner_wave()
+                    row[x * 3 + 0] -= wave.direction.x * (wave.slope * c);
+                    row[x * 3 + 1] -= wave.steepSlope * s;
+                    row[x * 3 + 2] -= wave.direction.y * (wave.slope * c);
+                }
+            }
+        }
+    });
+}
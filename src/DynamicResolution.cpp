@@ -0,0 +1,35 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Constructor, starts at the maximum scale
+DynamicResolution::DynamicResolution(const DynamicResolutionSettings& settings)
+    : m_settings(settings), m_scale(settings.maxScale){
+}
+
+// Takes the rolling GPU time of a frame, returns true when the scale changed
+bool DynamicResolution::Update(double gpuMs){
+    if(++m_framesSinceChange < m_settings.settleFrames || gpuMs <= 0.0){
+        return false;
+    }
+    bool overBudget = gpuMs > m_settings.targetMs;
+    bool underBudget = gpuMs < m_settings.headroom * m_settings.targetMs;
+    if(!overBudget && !underBudget){
+        return false;
+    }
+
+    // Cost follows the pixel count, so the scale follows its square root.
+    // Rounding down lands just under the target instead of just over it
+    float ideal = m_scale * static_cast<float>(std::sqrt(m_settings.targetMs / gpuMs));
+    float scale = std::floor(ideal / m_settings.step) * m_settings.step;
+    scale = std::min(std::max(scale, m_settings.minScale), m_settings.maxScale);
+    // Going up never lowers the scale and going down never raises it
+    scale = overBudget ? std::min(scale, m_scale) : std::max(scale, m_scale);
+    if(std::abs(scale - m_scale) < 0.5f * m_settings.step){
+        return false;
+    }
+    m_scale = scale;
+    m_framesSinceChange = 0;
+    return true;
+}
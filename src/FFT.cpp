@@ -0,0 +1,193 @@
+#include "FFT.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define FFT_USE_SSE
+#endif
+
+namespace{
+
+// vvvvvvvvvvvvvvvvvvvvvvvvvv 4-wide float helpers vvvvvvvvvvvvvvvvvvvvvvvvvv
+// One lane per row (or column) being transformed.
+#ifdef FFT_USE_SSE
+typedef __m128 f4;
+inline f4 Load(const float* p){ return _mm_loadu_ps(p); }
+inline void Store(float* p, f4 v){ _mm_storeu_ps(p, v); }
+inline f4 Splat(float x){ return _mm_set1_ps(x); }
+inline f4 Add(f4 a, f4 b){ return _mm_add_ps(a, b); }
+inline f4 Sub(f4 a, f4 b){ return _mm_sub_ps(a, b); }
+inline f4 Mul(f4 a, f4 b){ return _mm_mul_ps(a, b); }
+inline void Transpose(f4& a, f4& b, f4& c, f4& d){ _MM_TRANSPOSE4_PS(a, b, c, d); }
+#else
+struct f4{ float v[4]; };
+inline f4 Load(const float* p){ return f4{{p[0], p[1], p[2], p[3]}}; }
+inline void Store(float* p, f4 v){ for(int i = 0; i < 4; ++i){ p[i] = v.v[i]; } }
+inline f4 Splat(float x){ return f4{{x, x, x, x}}; }
+inline f4 Add(f4 a, f4 b){ for(int i = 0; i < 4; ++i){ a.v[i] += b.v[i]; } return a; }
+inline f4 Sub(f4 a, f4 b){ for(int i = 0; i < 4; ++i){ a.v[i] -= b.v[i]; } return a; }
+inline f4 Mul(f4 a, f4 b){ for(int i = 0; i < 4; ++i){ a.v[i] *= b.v[i]; } return a; }
+inline void Transpose(f4& a, f4& b, f4& c, f4& d){
+    f4 m[4] = {a, b, c, d};
+    for(int i = 0; i < 4; ++i){
+        a.v[i] = m[i].v[0];
+        b.v[i] = m[i].v[1];
+        c.v[i] = m[i].v[2];
+        d.v[i] = m[i].v[3];
+    }
+}
+#endif
+// ^^^^^^^^^^^^^^^^^^^^^^^^^^ 4-wide float helpers ^^^^^^^^^^^^^^^^^^^^^^^^^^
+
+// (ar + i ai) * (br + i bi) with a scalar twiddle b
+inline void ComplexMul(f4 ar, f4 ai, float br, float bi, f4& outRe, f4& outIm){
+    f4 r = Splat(br), i = Splat(bi);
+    outRe = Sub(Mul(ar, r), Mul(ai, i));
+    outIm = Add(Mul(ar, i), Mul(ai, r));
+}
+
+// In-place DIT butterflies on bit-reversed input. A single radix-2 stage runs
+// first when log2(n) is odd, every following stage is radix-4.
+void Butterflies(int n, const float* twiddleRe, const float* twiddleIm, f4* re, f4* im){
+    int log2n = 0;
+    while((1 << log2n) < n){
+        ++log2n;
+    }
+
+    int h = 1;
+    if(log2n % 2 == 1){
+        for(int i = 0; i < n; i += 2){
+            f4 ar = re[i], ai = im[i];
+            f4 br = re[i + 1], bi = im[i + 1];
+            re[i] = Add(ar, br);      im[i] = Add(ai, bi);
+            re[i + 1] = Sub(ar, br);  im[i + 1] = Sub(ai, bi);
+        }
+        h = 2;
+    }
+
+    for(; h < n; h *= 4){
+        for(int j = 0; j < h; ++j){
+            // w, w^2 and w^3 for this butterfly column
+            const float* wr = twiddleRe + 3 * j;
+            const float* wi = twiddleIm + 3 * j;
+            for(int block = 0; block < n; block += 4 * h){
+                int a = block + j, b = a + h, c = b + h, d = c + h;
+                f4 Br, Bi, Cr, Ci, Dr, Di;
+                ComplexMul(re[b], im[b], wr[1], wi[1], Br, Bi);
+                ComplexMul(re[c], im[c], wr[0], wi[0], Cr, Ci);
+                ComplexMul(re[d], im[d], wr[2], wi[2], Dr, Di);
+
+                f4 sumABr = Add(re[a], Br), sumABi = Add(im[a], Bi);
+                f4 difABr = Sub(re[a], Br), difABi = Sub(im[a], Bi);
+                f4 sumCDr = Add(Cr, Dr),    sumCDi = Add(Ci, Di);
+                f4 difCDr = Sub(Cr, Dr),    difCDi = Sub(Ci, Di);
+
+                re[a] = Add(sumABr, sumCDr);  im[a] = Add(sumABi, sumCDi);
+                re[c] = Sub(sumABr, sumCDr);  im[c] = Sub(sumABi, sumCDi);
+                // Multiplying (C - D) by +i for the inverse transform
+                re[b] = Sub(difABr, difCDi);  im[b] = Add(difABi, difCDr);
+                re[d] = Add(difABr, difCDi);  im[d] = Sub(difABi, difCDr);
+            }
+        }
+        twiddleRe += 3 * h;
+        twiddleIm += 3 * h;
+    }
+}
+
+}
+
+// Creates a transform for an n x n grid, with scratch for 'jobs' passes
+// running at once. n must be a power of two >= 4.
+FFT2D::FFT2D(int n, int jobs) : m_size(n){
+    int log2n = 0;
+    while((1 << log2n) < n){
+        ++log2n;
+    }
+
+    m_bitReverse.resize(n);
+    for(int i = 0; i < n; ++i){
+        int reversed = 0;
+        for(int bit = 0; bit < log2n; ++bit){
+            reversed |= ((i >> bit) & 1) << (log2n - 1 - bit);
+        }
+        m_bitReverse[i] = reversed;
+    }
+
+    // Same stage order as Butterflies()
+    const double twoPi = 6.283185307179586;
+    for(int h = (log2n % 2 == 1) ? 2 : 1; h < n; h *= 4){
+        for(int j = 0; j < h; ++j){
+            for(int power = 1; power <= 3; ++power){
+                double angle = twoPi * power * j / (4.0 * h);
+                m_twiddleRe.push_back(static_cast<float>(std::cos(angle)));
+                m_twiddleIm.push_back(static_cast<float>(std::sin(angle)));
+            }
+        }
+    }
+
+    // The default allocator aligns to 16 bytes, enough to view them as f4
+    jobs = std::max(jobs, 1);
+    m_scratchRe.assign(jobs, std::vector<float>(static_cast<size_t>(n) * 4));
+    m_scratchIm.assign(jobs, std::vector<float>(static_cast<size_t>(n) * 4));
+}
+
+// Inverse transform of 4 rows at a time. Rows are gathered into lanes with a
+// 4x4 transpose so the butterflies never touch strided memory.
+void FFT2D::InverseRows(float* re, float* im, int firstRow, int rowCount, int job){
+    const int n = m_size;
+    f4* scratchRe = reinterpret_cast<f4*>(m_scratchRe[job].data());
+    f4* scratchIm = reinterpret_cast<f4*>(m_scratchIm[job].data());
+
+    for(int row = firstRow; row < firstRow + rowCount; row += 4){
+        float* rowRe = re + static_cast<size_t>(row) * n;
+        float* rowIm = im + static_cast<size_t>(row) * n;
+
+        for(int k = 0; k < n; k += 4){
+            f4 r0 = Load(rowRe + k), r1 = Load(rowRe + n + k), r2 = Load(rowRe + 2 * n + k), r3 = Load(rowRe + 3 * n + k);
+            f4 i0 = Load(rowIm + k), i1 = Load(rowIm + n + k), i2 = Load(rowIm + 2 * n + k), i3 = Load(rowIm + 3 * n + k);
+            Transpose(r0, r1, r2, r3);
+            Transpose(i0, i1, i2, i3);
+            scratchRe[m_bitReverse[k]] = r0;      scratchIm[m_bitReverse[k]] = i0;
+            scratchRe[m_bitReverse[k + 1]] = r1;  scratchIm[m_bitReverse[k + 1]] = i1;
+            scratchRe[m_bitReverse[k + 2]] = r2;  scratchIm[m_bitReverse[k + 2]] = i2;
+            scratchRe[m_bitReverse[k + 3]] = r3;  scratchIm[m_bitReverse[k + 3]] = i3;
+        }
+
+        Butterflies(n, m_twiddleRe.data(), m_twiddleIm.data(), scratchRe, scratchIm);
+
+        for(int k = 0; k < n; k += 4){
+            f4 r0 = scratchRe[k], r1 = scratchRe[k + 1], r2 = scratchRe[k + 2], r3 = scratchRe[k + 3];
+            f4 i0 = scratchIm[k], i1 = scratchIm[k + 1], i2 = scratchIm[k + 2], i3 = scratchIm[k + 3];
+            Transpose(r0, r1, r2, r3);
+            Transpose(i0, i1, i2, i3);
+            Store(rowRe + k, r0);  Store(rowRe + n + k, r1);  Store(rowRe + 2 * n + k, r2);  Store(rowRe + 3 * n + k, r3);
+            Store(rowIm + k, i0);  Store(rowIm + n + k, i1);  Store(rowIm + 2 * n + k, i2);  Store(rowIm + 3 * n + k, i3);
+        }
+    }
+}
+
+// Inverse transform of 4 columns at a time. Four neighbouring columns are
+// already contiguous in a row-major grid, so they load straight into lanes.
+void FFT2D::InverseColumns(float* re, float* im, int firstColumn, int columnCount, int job){
+    const int n = m_size;
+    f4* scratchRe = reinterpret_cast<f4*>(m_scratchRe[job].data());
+    f4* scratchIm = reinterpret_cast<f4*>(m_scratchIm[job].data());
+
+    for(int column = firstColumn; column < firstColumn + columnCount; column += 4){
+        for(int k = 0; k < n; ++k){
+            size_t index = static_cast<size_t>(k) * n + column;
+            scratchRe[m_bitReverse[k]] = Load(re + index);
+            scratchIm[m_bitReverse[k]] = Load(im + index);
+        }
+
+        Butterflies(n, m_twiddleRe.data(), m_twiddleIm.data(), scratchRe, scratchIm);
+
+        for(int k = 0; k < n; ++k){
+            size_t index = static_cast<size_t>(k) * n + column;
+            Store(re + index, scratchRe[k]);
+            Store(im + index, scratchIm[k]);
+        }
+    }
+}
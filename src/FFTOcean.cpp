@@ -0,0 +1,215 @@
+#include "FFTOcean.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace{
+const double kPi = 3.141592653589793;
+const double kTwoPi = 2.0 * kPi;
+const float kGravity = 9.81f;
+
+// Wave number of grid index i, indices above n/2 wrap to negative frequencies
+inline float WaveNumber(int i, int n, float patchSize){
+    int shifted = (i < n / 2) ? i : i - n;
+    return static_cast<float>(kTwoPi) * shifted / patchSize;
+}
+}
+
+// Constructor samples the initial spectrum
+FFTOcean::FFTOcean(const FFTOceanSettings& settings)
+    : m_settings(settings),
+      m_fft(settings.resolution, settings.threadCount > 0 ? settings.threadCount : JobSystem::getConcurrency()){
+    m_threadCount = m_settings.threadCount;
+    if(m_threadCount <= 0){
+        m_threadCount = JobSystem::getConcurrency();
+    }
+
+    const size_t texels = static_cast<size_t>(m_settings.resolution) * m_settings.resolution;
+    for(int i = 0; i < 3; ++i){
+        m_gridRe[i].resize(texels);
+        m_gridIm[i].resize(texels);
+    }
+    m_displacement.resize(texels * 3);
+    m_normals.resize(texels * 3);
+
+    GenerateSpectrum();
+}
+
+// Spectral density (already multiplied by the grid cell area) at wave vector k
+float FFTOcean::SpectrumAt(const glm::vec2& k) const{
+    float kLength = glm::length(k);
+    if(kLength < 1e-6f){
+        return 0.0f;
+    }
+
+    glm::vec2 wind = glm::normalize(m_settings.windDirection);
+    float cosTheta = glm::dot(k / kLength, wind);
+    float U = m_settings.windSpeed;
+    float dk = static_cast<float>(kTwoPi) / m_settings.patchSize;
+
+    if(m_settings.spectrum == OceanSpectrum::Phillips){
+        // P(k) = A exp(-1/(kL)^2) / k^4 |k.w|^2, with a small wave cutoff
+        float L = U * U / kGravity;
+        float smallWave = L / 1000.0f;
+        float kL = kLength * L;
+        float phillips = m_settings.phillipsAmplitude * std::exp(-1.0f / (kL * kL)) / (kLength * kLength * kLength * kLength)
+                         * cosTheta * cosTheta * std::exp(-kLength * kLength * smallWave * smallWave);
+        return 0.5f * phillips * dk * dk;
+    }
+
+    // JONSWAP in omega, converted to a directional wave number spectrum
+    float F = m_settings.fetch;
+    float omega = std::sqrt(kGravity * kLength);
+    float alpha = 0.076f * std::pow(U * U / (F * kGravity), 0.22f);
+    float omegaPeak = 22.0f * std::pow(kGravity * kGravity / (U * F), 1.0f / 3.0f);
+    float sigma = (omega <= omegaPeak) ? 0.07f : 0.09f;
+    float r = std::exp(-(omega - omegaPeak) * (omega - omegaPeak) / (2.0f * sigma * sigma * omegaPeak * omegaPeak));
+    float ratio = omegaPeak / omega;
+    float spectrumOmega = alpha * kGravity * kGravity / std::pow(omega, 5.0f)
+                          * std::exp(-1.25f * ratio * ratio * ratio * ratio) * std::pow(3.3f, r);
+    // S(k) = S(omega) d(omega)/dk, then spread over direction with a cos^2 lobe
+    float spectrumK = spectrumOmega * kGravity / (2.0f * omega);
+    float spreading = (cosTheta > 0.0f) ? (2.0f / static_cast<float>(kPi)) * cosTheta * cosTheta : 0.0f;
+    return 0.5f * spectrumK * spreading / kLength * dk * dk;
+}
+
+// Fills m_h0 and m_omega from the chosen spectrum
+void FFTOcean::GenerateSpectrum(){
+    const int n = m_settings.resolution;
+    const size_t texels = static_cast<size_t>(n) * n;
+    m_h0Re.assign(texels, 0.0f);
+    m_h0Im.assign(texels, 0.0f);
+    m_h0ConjRe.assign(texels, 0.0f);
+    m_h0ConjIm.assign(texels, 0.0f);
+    m_omega.assign(texels, 0.0f);
+
+    std::mt19937 generator(m_settings.seed);
+    std::normal_distribution<float> gaussian(0.0f, 1.0f);
+
+    for(int z = 0; z < n; ++z){
+        for(int x = 0; x < n; ++x){
+            size_t index = static_cast<size_t>(z) * n + x;
+            glm::vec2 k(WaveNumber(x, n, m_settings.patchSize), WaveNumber(z, n, m_settings.patchSize));
+            float amplitude = std::sqrt(SpectrumAt(k) * 0.5f);
+            // The Nyquist row and column are their own mirror image, the odd
+            // derivative terms would not be hermitian there so leave them empty
+            if(x == n / 2 || z == n / 2){
+                amplitude = 0.0f;
+            }
+            m_h0Re[index] = gaussian(generator) * amplitude;
+            m_h0Im[index] = gaussian(generator) * amplitude;
+            m_omega[index] = std::sqrt(kGravity * glm::length(k));
+        }
+    }
+
+    // conj(h0(-k)) keeps the evolved spectrum hermitian so the heights stay real
+    for(int z = 0; z < n; ++z){
+        for(int x = 0; x < n; ++x){
+            size_t index = static_cast<size_t>(z) * n + x;
+            size_t mirrored = static_cast<size_t>((n - z) % n) * n + (n - x) % n;
+            m_h0ConjRe[index] = m_h0Re[mirrored];
+            m_h0ConjIm[index] = -m_h0Im[mirrored];
+        }
+    }
+}
+
+// Splits 'count' items into contiguous ranges of multiples of 4 over threads,
+// work(job, first, count) gets a different job index for each range
+void FFTOcean::ParallelFor(int count, const std::function<void(int, int, int)>& work) const{
+    int groups = count / 4;
+    int threads = std::min(m_threadCount, groups);
+    if(threads <= 1){
+        work(0, 0, count);
+        return;
+    }
+
+    // One JobSystem job per range
+    JobSystem::ParallelFor(threads, 1, [&](size_t begin, size_t end){
+        for(int t = static_cast<int>(begin); t < static_cast<int>(end); ++t){
+            int first = groups / threads * t + std::min(t, groups % threads);
+            int groupCount = groups / threads + (t < groups % threads ? 1 : 0);
+            work(t, first * 4, groupCount * 4);
+        }
+    });
+}
+
+// Evolves rows [first, first + count) of the spectrum and runs the row FFTs
+// with the scratch of 'job'
+void FFTOcean::EvolveRows(int job, int first, int count, double time){
+    PROFILE_ZONE("FFTOcean::EvolveRows");
+    const int n = m_settings.resolution;
+    for(int z = first; z < first + count; ++z){
+        float kz = WaveNumber(z, n, m_settings.patchSize);
+        for(int x = 0; x < n; ++x){
+            size_t index = static_cast<size_t>(z) * n + x;
+            float kx = WaveNumber(x, n, m_settings.patchSize);
+            float kLength = std::sqrt(kx * kx + kz * kz);
+
+            // Wrap the phase in double so long running sessions keep their precision
+            float phase = static_cast<float>(std::fmod(m_omega[index] * time, kTwoPi));
+            float c = std::cos(phase), s = std::sin(phase);
+
+            // h(k, t) = h0(k) e^{i w t} + conj(h0(-k)) e^{-i w t}
+            float hRe = (m_h0Re[index] + m_h0ConjRe[index]) * c - (m_h0Im[index] - m_h0ConjIm[index]) * s;
+            float hIm = (m_h0Im[index] + m_h0ConjIm[index]) * c + (m_h0Re[index] - m_h0ConjRe[index]) * s;
+
+            // Choppy displacement -i k/|k| h and slopes i k h
+            float nx = (kLength > 1e-6f) ? kx / kLength : 0.0f;
+            float nz = (kLength > 1e-6f) ? kz / kLength : 0.0f;
+            float dxRe = hIm * nx, dxIm = -hRe * nx;
+            float dzRe = hIm * nz, dzIm = -hRe * nz;
+            float sxRe = -hIm * kx, sxIm = hRe * kx;
+            float szRe = -hIm * kz, szIm = hRe * kz;
+
+            // Pack two real signals per transform: a + i*b
+            m_gridRe[0][index] = hRe - dxIm;   m_gridIm[0][index] = hIm + dxRe;
+            m_gridRe[1][index] = dzRe - sxIm;  m_gridIm[1][index] = dzIm + sxRe;
+            m_gridRe[2][index] = szRe;         m_gridIm[2][index] = szIm;
+        }
+    }
+
+    for(int i = 0; i < 3; ++i){
+        m_fft.InverseRows(m_gridRe[i].data(), m_gridIm[i].data(), first, count, job);
+    }
+}
+
+// Runs the column FFTs and writes the output maps for the given columns
+void FFTOcean::ResolveColumns(int job, int first, int count){
+    PROFILE_ZONE("FFTOcean::ResolveColumns");
+    const int n = m_settings.resolution;
+    for(int i = 0; i < 3; ++i){
+        m_fft.InverseColumns(m_gridRe[i].data(), m_gridIm[i].data(), first, count, job);
+    }
+
+    const float lambda = m_settings.choppiness;
+    for(int z = 0; z < n; ++z){
+        for(int x = first; x < first + count; ++x){
+            size_t index = static_cast<size_t>(z) * n + x;
+            float height = m_gridRe[0][index];
+            float dx = m_gridIm[0][index];
+            float dz = m_gridRe[1][index];
+            float slopeX = m_gridIm[1][index];
+            float slopeZ = m_gridRe[2][index];
+
+            m_displacement[index * 3 + 0] = lambda * dx;
+            m_displacement[index * 3 + 1] = height;
+            m_displacement[index * 3 + 2] = lambda * dz;
+
+            glm::vec3 normal = glm::normalize(glm::vec3(-slopeX, 1.0f, -slopeZ));
+            m_normals[index * 3 + 0] = normal.x;
+            m_normals[index * 3 + 1] = normal.y;
+            m_normals[index * 3 + 2] = normal.z;
+        }
+    }
+}
+
+// Evolves the spectrum to 'time' seconds and rebuilds both maps
+void FFTOcean::Update(double time){
+    PROFILE_ZONE("FFTOcean::Update");
+    const int n = m_settings.resolution;
+    ParallelFor(n, [this, time](int job, int first, int count){ EvolveRows(job, first, count, time); });
+    ParallelFor(n, [this](int job, int first, int count){ ResolveColumns(job, first, count); });
+}
@@ -0,0 +1,337 @@
+#include "FrameGraph.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace{
+// Transient targets can share a framebuffer when their storage matches
+bool SameStorage(const RenderTargetDesc& a, const RenderTargetDesc& b){
+    return a.width == b.width && a.height == b.height &&
+           a.colorFormat == b.colorFormat && a.depth == b.depth;
+}
+
+bool SameState(const PassState& a, const PassState& b){
+    return a.depthTest == b.depthTest && a.depthFunc == b.depthFunc && a.depthWrite == b.depthWrite;
+}
+}
+
+// Constructor, 'state' is used for every state change the graph makes
+FrameGraph::FrameGraph(GLStateCache& state) : m_state(state){
+}
+
+// Destructor deletes the framebuffers and textures of transient targets
+FrameGraph::~FrameGraph(){
+    ReleaseFramebuffers();
+}
+
+void FrameGraph::SetBackbuffer(const RenderTargetDesc& desc, GLuint framebuffer){
+    m_backbuffer = desc;
+    m_backbufferFramebuffer = framebuffer;
+}
+
+RenderTargetHandle FrameGraph::CreateTarget(const RenderTargetDesc& desc){
+    m_targets.push_back(desc);
+    m_compiled = false;
+    return static_cast<RenderTargetHandle>(m_targets.size()) - 1;
+}
+
+// Changes the size of a transient target, it is reallocated by the next Execute()
+void FrameGraph::ResizeTarget(RenderTargetHandle target, int width, int height){
+    RenderTargetDesc& desc = m_targets[target];
+    if(desc.width != width || desc.height != height){
+        desc.width = width;
+        desc.height = height;
+        m_compiled = false;
+    }
+}
+
+void FrameGraph::AddPass(const RenderPass& pass){
+    m_passes.push_back(pass);
+    m_compiled = false;
+}
+
+const RenderTargetDesc& FrameGraph::GetDesc(RenderTargetHandle target) const{
+    return target == kBackbuffer ? m_backbuffer : m_targets[target];
+}
+
+GLuint FrameGraph::GetTexture(RenderTargetHandle target) const{
+    if(target == kBackbuffer || m_targetFramebuffer[target] < 0){
+        return 0;
+    }
+    return m_framebuffers[m_targetFramebuffer[target]].colorTexture;
+}
+
+GLuint FrameGraph::GetFramebuffer(RenderTargetHandle target) const{
+    if(target == kBackbuffer){
+        return m_backbufferFramebuffer;
+    }
+    if(m_targetFramebuffer[target] < 0){
+        return 0;
+    }
+    return m_framebuffers[m_targetFramebuffer[target]].framebuffer;
+}
+
+// Culls, orders and allocates. Has to be called after the last AddPass
+void FrameGraph::Compile(){
+    const int passCount = static_cast<int>(m_passes.size());
+    const int targetCount = static_cast<int>(m_targets.size());
+    ReleaseFramebuffers();
+
+    // A pass is needed when it draws to the window, has side effects, or
+    // writes a target that a needed pass reads. Walking the passes backwards
+    // until nothing changes also catches chains of transient targets
+    std::vector<bool> live(passCount, false);
+    std::vector<bool> targetRead(targetCount, false);
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(int i = passCount - 1; i >= 0; --i){
+            const RenderPass& pass = m_passes[i];
+            if(live[i]){
+                continue;
+            }
+            if(pass.target == kBackbuffer || pass.sideEffects || targetRead[pass.target]){
+                live[i] = true;
+                changed = true;
+                for(RenderTargetHandle read : pass.reads){
+                    targetRead[read] = true;
+                }
+            }
+        }
+    }
+
+    // Edges: the writers of a target run before its readers, and writers of
+    // the same target keep their declaration order
+    std::vector<std::vector<int>> successors(passCount);
+    std::vector<int> pending(passCount, 0);
+    for(int a = 0; a < passCount; ++a){
+        for(int b = 0; b < passCount; ++b){
+            if(a == b || !live[a] || !live[b]){
+                continue;
+            }
+            bool edge = (m_passes[a].target == m_passes[b].target && a < b);
+            for(RenderTargetHandle read : m_passes[b].reads){
+                if(read == m_passes[a].target && read != m_passes[b].target){
+                    edge = true;
+                }
+            }
+            if(edge){
+                successors[a].push_back(b);
+                ++pending[b];
+            }
+        }
+    }
+
+    // Topological order. Among the passes that are ready, prefer one that
+    // keeps the current target bound, then one that keeps the current state,
+    // then the one declared first
+    m_order.clear();
+    m_culledPasses = 0;
+    std::vector<bool> scheduled(passCount, false);
+    for(int i = 0; i < passCount; ++i){
+        if(!live[i]){
+            scheduled[i] = true;
+            ++m_culledPasses;
+        }
+    }
+    while(static_cast<int>(m_order.size()) + m_culledPasses < passCount){
+        int best = -1;
+        int bestScore = -1;
+        for(int i = 0; i < passCount; ++i){
+            if(scheduled[i] || pending[i] > 0){
+                continue;
+            }
+            int score = 0;
+            if(!m_order.empty()){
+                const RenderPass& previous = m_passes[m_order.back()];
+                score += (previous.target == m_passes[i].target) ? 2 : 0;
+                score += SameState(previous.state, m_passes[i].state) ? 1 : 0;
+            }
+            if(score > bestScore){
+                best = i;
+                bestScore = score;
+            }
+        }
+        if(best < 0){
+            std::cout << "Frame graph has a cycle, check the reads of each pass\n";
+            exit(EXIT_FAILURE);
+        }
+        scheduled[best] = true;
+        m_order.push_back(best);
+        for(int next : successors[best]){
+            --pending[next];
+        }
+    }
+
+    // Lifetime of each transient target as first and last position in m_order
+    std::vector<int> firstUse(targetCount, -1);
+    std::vector<int> lastUse(targetCount, -1);
+    for(int position = 0; position < static_cast<int>(m_order.size()); ++position){
+        const RenderPass& pass = m_passes[m_order[position]];
+        std::vector<RenderTargetHandle> used = pass.reads;
+        used.push_back(pass.target);
+        for(RenderTargetHandle target : used){
+            if(target == kBackbuffer){
+                continue;
+            }
+            if(firstUse[target] < 0){
+                firstUse[target] = position;
+            }
+            lastUse[target] = position;
+        }
+    }
+
+    // Targets in order of first use take the first framebuffer with the
+    // same storage that is free again, otherwise they get a new one
+    m_targetFramebuffer.assign(targetCount, -1);
+    for(int position = 0; position < static_cast<int>(m_order.size()); ++position){
+        for(int target = 0; target < targetCount; ++target){
+            if(firstUse[target] != position){
+                continue;
+            }
+            int chosen = -1;
+            for(int i = 0; i < static_cast<int>(m_framebuffers.size()); ++i){
+                if(m_framebuffers[i].busyUntil < position && SameStorage(m_framebuffers[i].desc, m_targets[target])){
+                    chosen = i;
+                    break;
+                }
+            }
+            if(chosen < 0){
+                Framebuffer framebuffer;
+                framebuffer.desc = m_targets[target];
+                CreateFramebuffer(framebuffer);
+                m_framebuffers.push_back(framebuffer);
+                chosen = static_cast<int>(m_framebuffers.size()) - 1;
+            }
+            m_framebuffers[chosen].busyUntil = lastUse[target];
+            m_targetFramebuffer[target] = chosen;
+        }
+    }
+
+    m_compiled = true;
+}
+
+// Creates the GL objects of 'framebuffer'
+void FrameGraph::CreateFramebuffer(Framebuffer& framebuffer){
+    const RenderTargetDesc& desc = framebuffer.desc;
+    glGenFramebuffers(1, &framebuffer.framebuffer);
+    m_state.BindFramebuffer(framebuffer.framebuffer);
+
+    if(desc.colorFormat != GL_NONE){
+        glGenTextures(1, &framebuffer.colorTexture);
+        m_state.BindTexture(0, GL_TEXTURE_2D, framebuffer.colorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.colorFormat, desc.width, desc.height, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebuffer.colorTexture, 0);
+    }else{
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    if(desc.depth){
+        glGenRenderbuffers(1, &framebuffer.depthRenderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, framebuffer.depthRenderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, desc.width, desc.height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebuffer.depthRenderbuffer);
+    }
+
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+        std::cout << "Frame graph target " << desc.width << "x" << desc.height << " is incomplete\n";
+        exit(EXIT_FAILURE);
+    }
+    m_state.BindFramebuffer(0);
+}
+
+// Deletes every Framebuffer
+void FrameGraph::ReleaseFramebuffers(){
+    for(Framebuffer& framebuffer : m_framebuffers){
+        glDeleteFramebuffers(1, &framebuffer.framebuffer);
+        if(framebuffer.colorTexture != 0){
+            glDeleteTextures(1, &framebuffer.colorTexture);
+        }
+        if(framebuffer.depthRenderbuffer != 0){
+            glDeleteRenderbuffers(1, &framebuffer.depthRenderbuffer);
+        }
+    }
+    m_framebuffers.clear();
+    m_compiled = false;
+}
+
+// Forgets all passes and targets, e.g. to rebuild for a new resolution
+void FrameGraph::Reset(){
+    ReleaseFramebuffers();
+    m_targets.clear();
+    m_passes.clear();
+    m_order.clear();
+    m_targetFramebuffer.clear();
+    m_culledPasses = 0;
+}
+
+// Binds 'target' and sets its viewport, clears it if this is its first write of the frame
+void FrameGraph::BeginTarget(RenderTargetHandle target, std::vector<bool>& written){
+    const RenderTargetDesc& desc = GetDesc(target);
+    m_state.BindFramebuffer(GetFramebuffer(target));
+    m_state.Viewport(0, 0, desc.width, desc.height);
+
+    // Index 0 is the backbuffer
+    if(written[target + 1]){
+        ++m_clearsSkipped;
+        return;
+    }
+    written[target + 1] = true;
+
+    GLbitfield mask = 0;
+    if(desc.clearColor && desc.colorFormat != GL_NONE){
+        glClearColor(desc.clearColorValue.r, desc.clearColorValue.g, desc.clearColorValue.b, desc.clearColorValue.a);
+        mask |= GL_COLOR_BUFFER_BIT;
+    }
+    if(desc.clearDepth && desc.depth){
+        // glClear respects the depth mask
+        m_state.DepthMask(true);
+        mask |= GL_DEPTH_BUFFER_BIT;
+    }
+    if(mask != 0){
+        glClear(mask);
+    }
+}
+
+// Runs the compiled passes
+void FrameGraph::Execute(){
+    if(!m_compiled){
+        Compile();
+    }
+
+    std::vector<bool> written(m_targets.size() + 1, false);
+    for(int index : m_order){
+        const RenderPass& pass = m_passes[index];
+        if(m_profiler != nullptr){
+            m_profiler->Begin(pass.name);
+        }
+        BeginTarget(pass.target, written);
+
+        m_state.SetCapability(GL_DEPTH_TEST, pass.state.depthTest);
+        m_state.DepthFunc(pass.state.depthFunc);
+        m_state.DepthMask(pass.state.depthWrite);
+        pass.execute();
+        if(m_profiler != nullptr){
+            m_profiler->End();
+        }
+    }
+}
+
+// Prints the compiled pass order and target allocation
+void FrameGraph::PrintSchedule() const{
+    std::cout << "Frame graph: " << m_order.size() << " passes, " << m_culledPasses << " culled, "
+              << m_targets.size() << " transient targets in " << m_framebuffers.size() << " framebuffers\n";
+    for(int index : m_order){
+        const RenderPass& pass = m_passes[index];
+        std::cout << "  " << pass.name << " -> ";
+        if(pass.target == kBackbuffer){
+            std::cout << "backbuffer\n";
+        }else{
+            std::cout << "target " << pass.target << " (framebuffer " << m_targetFramebuffer[pass.target] << ")\n";
+        }
+    }
+}
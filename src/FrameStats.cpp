@@ -0,0 +1,85 @@
+#include "FrameStats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace{
+// Frames averaged before hitches are counted
+const unsigned long long kWarmupFrames = 10;
+// Weight of the newest frame in the running average
+const double kAverageWeight = 0.05;
+// Hitches in a row after which they are the new normal frame time
+const unsigned long long kHitchStreak = 5;
+}
+
+// Constructor, 'binMs' wide bins up to 'maxMs'
+FrameStats::FrameStats(double binMs, double maxMs, double hitchFactor)
+    : m_binMs(binMs), m_hitchFactor(hitchFactor),
+      m_bins(static_cast<size_t>(std::ceil(maxMs / binMs)) + 1, 0){
+}
+
+// Records one frame that took 'ms' milliseconds
+void FrameStats::Record(double ms){
+    size_t bin = std::min(static_cast<size_t>(std::max(ms, 0.0) / m_binMs), m_bins.size() - 1);
+    ++m_bins[bin];
+    ++m_frames;
+    m_total += ms;
+    if(ms > m_max){
+        m_max = ms;
+        m_maxFrame = m_frames;
+    }
+
+    if(m_frames <= kWarmupFrames){
+        m_average += (ms - m_average) / m_frames;
+        return;
+    }
+    if(ms > m_hitchFactor * m_average){
+        ++m_hitches;
+        // An isolated hitch would drag the average up and hide the next one,
+        // but a run of them is a slowdown that lasts, like losing vsync or a
+        // heavier ocean mode: the average starts over from the run
+        ++m_hitchStreak;
+        m_streakTotal += ms;
+        if(m_hitchStreak >= kHitchStreak){
+            m_average = m_streakTotal / m_hitchStreak;
+            m_hitchStreak = 0;
+            m_streakTotal = 0.0;
+        }
+        return;
+    }
+    m_hitchStreak = 0;
+    m_streakTotal = 0.0;
+    m_average += kAverageWeight * (ms - m_average);
+}
+
+// Frame time below which 'percent' of the frames fall, in milliseconds
+double FrameStats::Percentile(double percent) const{
+    if(m_frames == 0){
+        return 0.0;
+    }
+    unsigned long long rank = static_cast<unsigned long long>(std::ceil(percent / 100.0 * m_frames));
+    rank = std::max<unsigned long long>(rank, 1);
+    unsigned long long seen = 0;
+    for(size_t bin = 0; bin + 1 < m_bins.size(); ++bin){
+        seen += m_bins[bin];
+        if(seen >= rank){
+            // Upper edge of the bin, never more than the longest frame
+            return std::min((bin + 1) * m_binMs, m_max);
+        }
+    }
+    return m_max;
+}
+
+// One line with the frame count, average, p50/p95/p99, longest frame and hitches
+std::string FrameStats::Summary() const{
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2)
+         << "Frames " << m_frames
+         << " | avg " << (m_frames > 0 ? m_total / m_frames : 0.0) << " ms"
+         << " | p50 " << Percentile(50.0) << " p95 " << Percentile(95.0) << " p99 " << Percentile(99.0) << " ms"
+         << " | max " << m_max << " ms (frame " << m_maxFrame << ")"
+         << " | " << m_hitches << " hitches over " << std::setprecision(1) << m_hitchFactor << "x the average";
+    return line.str();
+}
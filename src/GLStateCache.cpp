@@ -0,0 +1,168 @@
+#include "GLStateCache.hpp"
+
+#include <iostream>
+
+namespace{
+const GLuint kUnknown = 0xFFFFFFFF;
+
+const char* kStateNames[] = {
+    "program", "vertex array", "framebuffer", "active texture", "texture",
+    "enable/disable", "depth func", "depth mask", "polygon mode", "viewport", "patch vertices"
+};
+}
+
+// Constructor starts with every state unknown
+GLStateCache::GLStateCache(){
+    for(int kind = 0; kind < kStateKinds; ++kind){
+        m_issued[kind] = 0;
+        m_dropped[kind] = 0;
+    }
+    Invalidate();
+}
+
+// Forgets everything, the next call of each kind is always issued
+void GLStateCache::Invalidate(){
+    m_program = kUnknown;
+    m_vertexArray = kUnknown;
+    m_framebuffer = kUnknown;
+    m_activeTexture = kUnknown;
+    for(int unit = 0; unit < kMaxTextureUnits; ++unit){
+        for(int target = 0; target < 4; ++target){
+            m_textures[unit][target] = kUnknown;
+        }
+    }
+    m_capabilities.clear();
+    m_depthFunc = GL_NONE;
+    m_polygonMode = GL_NONE;
+    m_depthMask = -1;
+    m_viewportKnown = false;
+    m_patchVertices = 0;
+}
+
+// Counts one call of 'kind', returns 'changed'
+bool GLStateCache::Count(StateKind kind, bool changed){
+    if(changed){
+        ++m_issued[kind];
+        ++m_issuedTotal;
+    }else{
+        ++m_dropped[kind];
+        ++m_droppedTotal;
+    }
+    return changed;
+}
+
+// Index of a texture target in m_textures, -1 if it is not tracked
+int GLStateCache::TargetIndex(GLenum target){
+    switch(target){
+        case GL_TEXTURE_2D:         return 0;
+        case GL_TEXTURE_3D:         return 1;
+        case GL_TEXTURE_CUBE_MAP:   return 2;
+        case GL_TEXTURE_BUFFER:     return 3;
+        default:                    return -1;
+    }
+}
+
+void GLStateCache::UseProgram(GLuint program){
+    if(Count(kProgram, program != m_program)){
+        glUseProgram(program);
+        m_program = program;
+    }
+}
+
+void GLStateCache::BindVertexArray(GLuint vertexArray){
+    if(Count(kVertexArray, vertexArray != m_vertexArray)){
+        glBindVertexArray(vertexArray);
+        m_vertexArray = vertexArray;
+    }
+}
+
+void GLStateCache::BindFramebuffer(GLuint framebuffer){
+    if(Count(kFramebuffer, framebuffer != m_framebuffer)){
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        m_framebuffer = framebuffer;
+    }
+}
+
+void GLStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture){
+    // The unit is made active even when the texture is already bound there,
+    // callers upload with glTexSubImage2D right after binding
+    if(Count(kActiveTexture, unit != m_activeTexture)){
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_activeTexture = unit;
+    }
+
+    int targetIndex = TargetIndex(target);
+    bool tracked = unit < kMaxTextureUnits && targetIndex >= 0;
+    if(!Count(kTexture, !tracked || m_textures[unit][targetIndex] != texture)){
+        return;
+    }
+    glBindTexture(target, texture);
+    if(tracked){
+        m_textures[unit][targetIndex] = texture;
+    }
+}
+
+void GLStateCache::SetCapability(GLenum capability, bool enabled){
+    auto known = m_capabilities.find(capability);
+    if(Count(kCapability, known == m_capabilities.end() || known->second != enabled)){
+        if(enabled){
+            glEnable(capability);
+        }else{
+            glDisable(capability);
+        }
+        m_capabilities[capability] = enabled;
+    }
+}
+
+void GLStateCache::DepthFunc(GLenum function){
+    if(Count(kDepthFunc, function != m_depthFunc)){
+        glDepthFunc(function);
+        m_depthFunc = function;
+    }
+}
+
+void GLStateCache::DepthMask(bool enabled){
+    if(Count(kDepthMask, m_depthMask != static_cast<int>(enabled))){
+        glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+        m_depthMask = enabled;
+    }
+}
+
+void GLStateCache::PolygonMode(GLenum mode){
+    if(Count(kPolygonMode, mode != m_polygonMode)){
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+        m_polygonMode = mode;
+    }
+}
+
+void GLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height){
+    bool changed = !m_viewportKnown || m_viewport[0] != x || m_viewport[1] != y ||
+                   m_viewport[2] != width || m_viewport[3] != height;
+    if(Count(kViewport, changed)){
+        glViewport(x, y, width, height);
+        m_viewport[0] = x;
+        m_viewport[1] = y;
+        m_viewport[2] = width;
+        m_viewport[3] = height;
+        m_viewportKnown = true;
+    }
+}
+
+void GLStateCache::PatchVertices(GLint count){
+    if(Count(kPatchVertices, count != m_patchVertices)){
+        glPatchParameteri(GL_PATCH_VERTICES, count);
+        m_patchVertices = count;
+    }
+}
+
+// Prints the issued and dropped counts for each kind of call
+void GLStateCache::PrintStats() const{
+    std::cout << "GL state cache: " << m_droppedTotal << " of " << (m_issuedTotal + m_droppedTotal)
+              << " calls dropped\n";
+    for(int kind = 0; kind < kStateKinds; ++kind){
+        if(m_issued[kind] + m_dropped[kind] > 0){
+            std::cout << "  " << kStateNames[kind] << ": " << m_issued[kind] << " issued, "
+                      << m_dropped[kind] << " dropped\n";
+        }
+    }
+}
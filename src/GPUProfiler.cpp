@@ -0,0 +1,178 @@
+#include "GPUProfiler.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+namespace{
+// Query target of each GPUProfiler::Counter
+const GLenum kQueryTargets[] = {
+    GL_TIME_ELAPSED,
+    GL_PRIMITIVES_GENERATED,
+    GL_TESS_EVALUATION_SHADER_INVOCATIONS_ARB,
+    GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+};
+
+const char* kCsvColumns[] = {"gpu_ms", "primitives", "tes_invocations", "fragment_invocations"};
+
+// Results of the first frames are dropped, they include the driver's lazy
+// shader compilation (and on llvmpipe a first timer value that is garbage)
+const unsigned long long kWarmupFrames = 1;
+}
+
+// Constructor, results are read 'latency' frames after they were issued
+GPUProfiler::GPUProfiler(int latency, int window)
+    : m_latency(latency), m_window(window),
+      m_counters(GLAD_GL_ARB_pipeline_statistics_query ? kCounters : kTessEvaluations),
+      m_slotFrame(latency, 0){
+}
+
+// Destructor deletes the queries and closes the CSV file
+GPUProfiler::~GPUProfiler(){
+    for(Zone& zone : m_zones){
+        glDeleteQueries(static_cast<GLsizei>(zone.queries.size()), zone.queries.data());
+    }
+}
+
+// Writes every result as a 'frame,pass,gpu_ms,primitives,...' row to 'path'
+bool GPUProfiler::OpenCsv(const std::string& path){
+    m_csv.open(path);
+    if(!m_csv.is_open()){
+        return false;
+    }
+    m_csv << "frame,pass";
+    for(int counter = 0; counter < m_counters; ++counter){
+        m_csv << "," << kCsvColumns[counter];
+    }
+    m_csv << "\n";
+    return true;
+}
+
+// Index of 'name' in m_zones, adding it if needed
+int GPUProfiler::FindZone(const std::string& name){
+    for(int i = 0; i < static_cast<int>(m_zones.size()); ++i){
+        if(m_zones[i].name == name){
+            return i;
+        }
+    }
+    Zone zone;
+    zone.name = name;
+    zone.queries.resize(m_counters * m_latency);
+    glGenQueries(static_cast<GLsizei>(zone.queries.size()), zone.queries.data());
+    zone.issued.assign(m_latency, false);
+    m_zones.push_back(zone);
+    return static_cast<int>(m_zones.size()) - 1;
+}
+
+// Reads back the queries of 'slot' before it is reused
+void GPUProfiler::Collect(int slot){
+    for(Zone& zone : m_zones){
+        if(!zone.issued[slot]){
+            continue;
+        }
+        zone.issued[slot] = false;
+
+        // The counters of a zone end together, but may still finish apart
+        bool available = true;
+        for(int counter = 0; counter < m_counters; ++counter){
+            GLuint ready = GL_FALSE;
+            glGetQueryObjectuiv(zone.queries[counter * m_latency + slot], GL_QUERY_RESULT_AVAILABLE, &ready);
+            available = available && ready == GL_TRUE;
+        }
+        if(!available){
+            ++m_dropped;
+            continue;
+        }
+        if(m_slotFrame[slot] <= kWarmupFrames){
+            continue;
+        }
+
+        Sample sample{};
+        for(int counter = 0; counter < m_counters; ++counter){
+            GLuint64 value = 0;
+            glGetQueryObjectui64v(zone.queries[counter * m_latency + slot], GL_QUERY_RESULT, &value);
+            sample.values[counter] = static_cast<double>(value);
+        }
+        // Nanoseconds to milliseconds
+        sample.values[kTime] *= 1e-6;
+
+        zone.history.push_back(sample);
+        for(int counter = 0; counter < m_counters; ++counter){
+            zone.sum.values[counter] += sample.values[counter];
+        }
+        if(static_cast<int>(zone.history.size()) > m_window){
+            for(int counter = 0; counter < m_counters; ++counter){
+                zone.sum.values[counter] -= zone.history.front().values[counter];
+            }
+            zone.history.pop_front();
+        }
+        if(m_csv.is_open()){
+            m_csv << m_slotFrame[slot] << "," << zone.name;
+            for(int counter = 0; counter < m_counters; ++counter){
+                m_csv << "," << sample.values[counter];
+            }
+            m_csv << "\n";
+        }
+    }
+}
+
+// Starts a frame, collects the results of the oldest one that are ready
+void GPUProfiler::BeginFrame(){
+    ++m_frame;
+    m_slot = static_cast<int>(m_frame % m_latency);
+    // This slot was issued 'latency' frames ago
+    Collect(m_slot);
+    m_slotFrame[m_slot] = m_frame;
+}
+
+// Starts measuring 'name' on the GPU
+void GPUProfiler::Begin(const std::string& name){
+    m_openZone = FindZone(name);
+    for(int counter = 0; counter < m_counters; ++counter){
+        glBeginQuery(kQueryTargets[counter], m_zones[m_openZone].queries[counter * m_latency + m_slot]);
+    }
+}
+
+// Stops measuring the zone started last
+void GPUProfiler::End(){
+    for(int counter = 0; counter < m_counters; ++counter){
+        glEndQuery(kQueryTargets[counter]);
+    }
+    m_zones[m_openZone].issued[m_slot] = true;
+    m_openZone = -1;
+}
+
+// Rolling average of 'counter' for 'name', 0 before the first result
+double GPUProfiler::Average(const std::string& name, Counter counter) const{
+    for(const Zone& zone : m_zones){
+        if(zone.name == name && !zone.history.empty() && counter < m_counters){
+            return zone.sum.values[counter] / zone.history.size();
+        }
+    }
+    return 0.0;
+}
+
+// Sum of the rolling averages of 'counter' over every zone
+double GPUProfiler::TotalAverage(Counter counter) const{
+    double total = 0.0;
+    for(const Zone& zone : m_zones){
+        total += Average(zone.name, counter);
+    }
+    return total;
+}
+
+// One line with the averages of every zone and their total time
+std::string GPUProfiler::Summary() const{
+    std::ostringstream line;
+    line << std::fixed << "GPU";
+    for(const Zone& zone : m_zones){
+        double time = Average(zone.name, kTime);
+        line << " | " << zone.name << " " << std::setprecision(2) << time << " ms "
+             << std::setprecision(0) << Average(zone.name, kPrimitives) << " prims";
+        if(hasPipelineStatistics()){
+            line << " " << Average(zone.name, kTessEvaluations) << " tes "
+                 << Average(zone.name, kFragments) << " frags";
+        }
+    }
+    line << " | total " << std::setprecision(2) << TotalAverage(kTime) << " ms";
+    return line.str();
+}
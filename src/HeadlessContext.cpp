@@ -0,0 +1,195 @@
+#include "HeadlessContext.hpp"
+
+#if defined(LINUX)
+#include <dlfcn.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace{
+// The few EGL types and tokens used here, so that no EGL headers are needed
+typedef void* EGLDisplay;
+typedef void* EGLConfig;
+typedef void* EGLContext;
+typedef void* EGLSurface;
+typedef int32_t EGLint;
+typedef unsigned int EGLBoolean;
+typedef unsigned int EGLenum;
+
+const EGLint kEglNone = 0x3038;
+const EGLint kEglRenderableType = 0x3040;
+const EGLint kEglOpenGLBit = 0x0008;
+const EGLint kEglSurfaceType = 0x3033;
+const EGLint kEglContextMajorVersion = 0x3098;
+const EGLint kEglContextMinorVersion = 0x30FB;
+const EGLint kEglContextOpenGLProfileMask = 0x30FD;
+const EGLint kEglContextOpenGLCoreProfileBit = 0x0001;
+const EGLenum kEglOpenGLApi = 0x30A2;
+const EGLenum kEglPlatformSurfacelessMesa = 0x31DD;
+
+typedef void* (*EglGetProcAddress)(const char*);
+typedef EGLDisplay (*EglGetPlatformDisplay)(EGLenum, void*, const EGLint*);
+typedef EGLDisplay (*EglGetDisplay)(void*);
+typedef EGLBoolean (*EglInitialize)(EGLDisplay, EGLint*, EGLint*);
+typedef EGLBoolean (*EglChooseConfig)(EGLDisplay, const EGLint*, EGLConfig*, EGLint, EGLint*);
+typedef EGLBoolean (*EglBindAPI)(EGLenum);
+typedef EGLContext (*EglCreateContext)(EGLDisplay, EGLConfig, EGLContext, const EGLint*);
+typedef EGLBoolean (*EglMakeCurrent)(EGLDisplay, EGLSurface, EGLSurface, EGLContext);
+typedef EGLBoolean (*EglDestroyContext)(EGLDisplay, EGLContext);
+typedef EGLBoolean (*EglTerminate)(EGLDisplay);
+
+// Resolved from libEGL by CreateContext
+EglGetProcAddress eglGetProcAddress = nullptr;
+EglMakeCurrent eglMakeCurrent = nullptr;
+EglDestroyContext eglDestroyContext = nullptr;
+EglTerminate eglTerminate = nullptr;
+}
+
+// Constructor does not touch EGL yet
+HeadlessContext::HeadlessContext(){
+}
+
+// Destructor deletes the framebuffer and the context
+HeadlessContext::~HeadlessContext(){
+    if(m_framebuffer != 0){
+        glDeleteFramebuffers(1, &m_framebuffer);
+        glDeleteRenderbuffers(1, &m_colorRenderbuffer);
+        glDeleteRenderbuffers(1, &m_depthRenderbuffer);
+    }
+#if defined(LINUX)
+    if(m_context != nullptr){
+        eglMakeCurrent(m_display, nullptr, nullptr, nullptr);
+        eglDestroyContext(m_display, m_context);
+    }
+    if(m_display != nullptr){
+        eglTerminate(m_display);
+    }
+    if(m_library != nullptr){
+        dlclose(m_library);
+    }
+#endif
+}
+
+// Creates the context and makes it current
+bool HeadlessContext::CreateContext(){
+#if defined(LINUX)
+    m_library = dlopen("libEGL.so.1", RTLD_NOW | RTLD_LOCAL);
+    if(m_library == nullptr){
+        m_error = "libEGL.so.1 could not be loaded";
+        return false;
+    }
+    eglGetProcAddress = reinterpret_cast<EglGetProcAddress>(dlsym(m_library, "eglGetProcAddress"));
+    auto eglGetDisplay = reinterpret_cast<EglGetDisplay>(dlsym(m_library, "eglGetDisplay"));
+    auto eglInitialize = reinterpret_cast<EglInitialize>(dlsym(m_library, "eglInitialize"));
+    auto eglChooseConfig = reinterpret_cast<EglChooseConfig>(dlsym(m_library, "eglChooseConfig"));
+    auto eglBindAPI = reinterpret_cast<EglBindAPI>(dlsym(m_library, "eglBindAPI"));
+    auto eglCreateContext = reinterpret_cast<EglCreateContext>(dlsym(m_library, "eglCreateContext"));
+    eglMakeCurrent = reinterpret_cast<EglMakeCurrent>(dlsym(m_library, "eglMakeCurrent"));
+    eglDestroyContext = reinterpret_cast<EglDestroyContext>(dlsym(m_library, "eglDestroyContext"));
+    eglTerminate = reinterpret_cast<EglTerminate>(dlsym(m_library, "eglTerminate"));
+    if(!eglGetProcAddress || !eglGetDisplay || !eglInitialize || !eglChooseConfig || !eglBindAPI ||
+       !eglCreateContext || !eglMakeCurrent || !eglDestroyContext || !eglTerminate){
+        m_error = "libEGL.so.1 is missing EGL 1.4 functions";
+        return false;
+    }
+
+    // The surfaceless platform needs neither a GPU nor a display server,
+    // the default display is the fallback for EGL without it
+    auto eglGetPlatformDisplay = reinterpret_cast<EglGetPlatformDisplay>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if(eglGetPlatformDisplay != nullptr){
+        m_display = eglGetPlatformDisplay(kEglPlatformSurfacelessMesa, nullptr, nullptr);
+    }
+    if(m_display == nullptr){
+        m_display = eglGetDisplay(nullptr);
+    }
+    EGLint major = 0, minor = 0;
+    if(m_display == nullptr || !eglInitialize(m_display, &major, &minor)){
+        m_error = "no EGL display could be initialized";
+        m_display = nullptr;
+        return false;
+    }
+
+    // Nothing is ever drawn to an EGL surface, any surface type will do
+    const EGLint configAttributes[] = {
+        kEglSurfaceType, 0,
+        kEglRenderableType, kEglOpenGLBit,
+        kEglNone
+    };
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    if(!eglChooseConfig(m_display, configAttributes, &config, 1, &configCount) || configCount == 0){
+        m_error = "no EGL config supports desktop OpenGL";
+        return false;
+    }
+
+    // Same context as the windowed mode: OpenGL 4.1 core
+    const EGLint contextAttributes[] = {
+        kEglContextMajorVersion, 4,
+        kEglContextMinorVersion, 1,
+        kEglContextOpenGLProfileMask, kEglContextOpenGLCoreProfileBit,
+        kEglNone
+    };
+    eglBindAPI(kEglOpenGLApi);
+    m_context = eglCreateContext(m_display, config, nullptr, contextAttributes);
+    if(m_context == nullptr){
+        m_error = "no OpenGL 4.1 core context could be created";
+        return false;
+    }
+    // Current without a surface (EGL_KHR_surfaceless_context)
+    if(!eglMakeCurrent(m_display, nullptr, nullptr, m_context)){
+        m_error = "the context could not be made current without a surface";
+        return false;
+    }
+    return true;
+#else
+    m_error = "headless rendering is only supported on Linux";
+    return false;
+#endif
+}
+
+// Looks up an OpenGL function, to be passed to gladLoadGLLoader
+void* HeadlessContext::GetProcAddress(const char* name){
+    return eglGetProcAddress != nullptr ? eglGetProcAddress(name) : nullptr;
+}
+
+// Creates the 'width' x 'height' framebuffer, needs glad to be loaded
+bool HeadlessContext::CreateFramebuffer(int width, int height){
+    m_width = width;
+    m_height = height;
+
+    glGenRenderbuffers(1, &m_colorRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &m_depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorRenderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+        m_error = "the offscreen framebuffer is incomplete";
+        return false;
+    }
+    return true;
+}
+
+// Reads the framebuffer back into a top to bottom RGB image
+PPM HeadlessContext::Capture() const{
+    std::vector<uint8_t> rows(static_cast<size_t>(m_width) * m_height * 3);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, rows.data());
+
+    // OpenGL rows start at the bottom, PPM rows at the top
+    std::vector<uint8_t> pixels(rows.size());
+    size_t rowSize = static_cast<size_t>(m_width) * 3;
+    for(int y = 0; y < m_height; ++y){
+        std::copy(rows.begin() + y * rowSize, rows.begin() + (y + 1) * rowSize,
+                  pixels.begin() + (m_height - 1 - y) * rowSize);
+    }
+    return PPM(m_width, m_height, pixels);
+}
@@ -0,0 +1,56 @@
+#include "InputTimeline.hpp"
+
+#include <algorithm>
+
+// Constructor tracks keys 0 to 'keyCount' - 1, all up
+InputTimeline::InputTimeline(int keyCount)
+    : m_keys(std::max(0, keyCount)){
+}
+
+// Records that 'key' went down at 'time' seconds
+void InputTimeline::Press(int key, double time){
+    if(key < 0 || key >= static_cast<int>(m_keys.size()) || m_keys[key].down){
+        return;
+    }
+    m_keys[key].down = true;
+    m_keys[key].downTime = std::max(time, m_windowStart);
+}
+
+// Records that 'key' went up at 'time' seconds
+void InputTimeline::Release(int key, double time){
+    if(key < 0 || key >= static_cast<int>(m_keys.size()) || !m_keys[key].down){
+        return;
+    }
+    KeyState& state = m_keys[key];
+    state.heldTime += std::max(0.0, time - state.downTime);
+    state.down = false;
+}
+
+// Seconds 'key' was down from the start of the window to 'now'
+double InputTimeline::HeldTime(int key, double now) const{
+    if(key < 0 || key >= static_cast<int>(m_keys.size())){
+        return 0.0;
+    }
+    const KeyState& state = m_keys[key];
+    double held = state.heldTime;
+    if(state.down){
+        held += std::max(0.0, now - state.downTime);
+    }
+    return held;
+}
+
+// Ends the window at 'now', keys still down carry on from there
+void InputTimeline::EndWindow(double now){
+    for(KeyState& state : m_keys){
+        state.heldTime = 0.0;
+        if(state.down){
+            state.downTime = std::max(state.downTime, now);
+        }
+    }
+    m_windowStart = now;
+}
+
+// Returns true if 'key' is down
+bool InputTimeline::IsDown(int key) const{
+    return key >= 0 && key < static_cast<int>(m_keys.size()) && m_keys[key].down;
+}
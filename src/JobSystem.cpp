@@ -0,0 +1,329 @@
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace{
+struct Job{
+    std::function<void()> work;
+    JobCounter* counter;
+};
+
+// Jobs a deque or the shared queue holds, a full one runs jobs on the spot
+const int64_t kQueueCapacity = 4096;
+// Empty searches in a row before a worker goes to sleep
+const int kSpinsBeforeSleep = 64;
+// Submitting does not lock, so a wake up can slip past a worker on its way
+// to sleep; it then looks again after this long
+const std::chrono::milliseconds kSleepTimeout(2);
+
+// Chase-Lev deque: the owner pushes and pops at the bottom, thieves take
+// from the top, and only a race for the last job needs a compare exchange
+class WorkStealingDeque{
+public:
+    // Adds a job at the bottom, owner only. Returns false when full.
+    bool Push(Job* job){
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        if(bottom - top >= kQueueCapacity){
+            return false;
+        }
+        m_jobs[bottom & (kQueueCapacity - 1)].store(job, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Takes the newest job, owner only
+    Job* Pop(){
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+        if(top > bottom){
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job* job = m_jobs[bottom & (kQueueCapacity - 1)].load(std::memory_order_relaxed);
+        if(top == bottom){
+            // Last job, a thief may be taking it at the same time
+            if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)){
+                job = nullptr;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // Takes the oldest job, any thread
+    Job* Steal(){
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if(top >= bottom){
+            return nullptr;
+        }
+        Job* job = m_jobs[top & (kQueueCapacity - 1)].load(std::memory_order_relaxed);
+        if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)){
+            return nullptr;
+        }
+        return job;
+    }
+private:
+    // Apart, so thieves and the owner do not share a cache line
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    std::atomic<Job*> m_jobs[kQueueCapacity] = {};
+};
+
+// Bounded queue any number of threads push to and pop from without locks,
+// every slot has a sequence number that says whose turn it is
+class SharedQueue{
+public:
+    SharedQueue(){
+        for(int64_t i = 0; i < kQueueCapacity; ++i){
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Adds a job, returns false when full
+    bool Push(Job* job){
+        int64_t position = m_tail.load(std::memory_order_relaxed);
+        for(;;){
+            Slot& slot = m_slots[position & (kQueueCapacity - 1)];
+            int64_t difference = slot.sequence.load(std::memory_order_acquire) - position;
+            if(difference == 0){
+                if(m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)){
+                    slot.job = job;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }else if(difference < 0){
+                return false;
+            }else{
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Takes the oldest job, nullptr when empty
+    Job* Pop(){
+        int64_t position = m_head.load(std::memory_order_relaxed);
+        for(;;){
+            Slot& slot = m_slots[position & (kQueueCapacity - 1)];
+            int64_t difference = slot.sequence.load(std::memory_order_acquire) - (position + 1);
+            if(difference == 0){
+                if(m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)){
+                    Job* job = slot.job;
+                    slot.sequence.store(position + kQueueCapacity, std::memory_order_release);
+                    return job;
+                }
+            }else if(difference < 0){
+                return nullptr;
+            }else{
+                position = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+private:
+    struct Slot{
+        std::atomic<int64_t> sequence;
+        Job* job;
+    };
+    Slot m_slots[kQueueCapacity];
+    alignas(64) std::atomic<int64_t> m_head{0};
+    alignas(64) std::atomic<int64_t> m_tail{0};
+};
+
+std::vector<std::thread> workers;
+std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+SharedQueue sharedQueue;
+std::atomic<bool> running{false};
+// Jobs in the deques and the shared queue, sleeping workers wake up for them
+std::atomic<int> queuedJobs{0};
+std::atomic<int> sleepingWorkers{0};
+std::mutex sleepMutex;
+std::condition_variable wakeUp;
+// Index of the calling worker in 'deques', -1 on every other thread
+thread_local int workerIndex = -1;
+
+// Runs a job and counts it as finished
+void Execute(Job* job){
+    job->work();
+    job->counter->Finish();
+    delete job;
+}
+
+// Takes a job from the thread's own deque, the shared queue, or another worker
+Job* FindJob(){
+    Job* job = nullptr;
+    if(workerIndex >= 0){
+        job = deques[workerIndex]->Pop();
+    }
+    if(job == nullptr){
+        job = sharedQueue.Pop();
+    }
+    int count = static_cast<int>(deques.size());
+    for(int i = 1; job == nullptr && i <= count; ++i){
+        int victim = (workerIndex + i) % count;
+        if(victim != workerIndex){
+            job = deques[victim]->Steal();
+        }
+    }
+    if(job != nullptr){
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+// Runs jobs until Shutdown, sleeping while there are none
+void WorkerLoop(int index){
+    workerIndex = index;
+    int spins = 0;
+    for(;;){
+        Job* job = FindJob();
+        if(job != nullptr){
+            Execute(job);
+            spins = 0;
+            continue;
+        }
+        if(!running.load(std::memory_order_acquire)){
+            break;
+        }
+        if(++spins < kSpinsBeforeSleep){
+            std::this_thread::yield();
+            continue;
+        }
+        PROFILE_ZONE("JobSystem::Sleep");
+        sleepingWorkers.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeUp.wait_for(lock, kSleepTimeout, []{
+                return queuedJobs.load() > 0 || !running.load();
+            });
+        }
+        sleepingWorkers.fetch_sub(1);
+        spins = 0;
+    }
+}
+}
+
+// Counts one more job, and this group in the parent when it was done
+void JobCounter::Add(){
+    if(m_pending.fetch_add(1, std::memory_order_acq_rel) == 0 && m_parent != nullptr){
+        m_parent->Add();
+    }
+}
+
+// Counts one job as finished, and this group in the parent when it is done
+void JobCounter::Finish(){
+    // A waiter may destroy the counter as soon as it reaches zero
+    JobCounter* parent = m_parent;
+    if(m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1 && parent != nullptr){
+        parent->Finish();
+    }
+}
+
+// Starts the worker threads
+void JobSystem::Start(int workerCount){
+    if(running.load()){
+        return;
+    }
+    if(workerCount <= 0){
+        workerCount = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+    }
+    workerCount = std::max(0, workerCount);
+    deques.clear();
+    for(int i = 0; i < workerCount; ++i){
+        deques.emplace_back(new WorkStealingDeque());
+    }
+    running.store(true, std::memory_order_release);
+    for(int i = 0; i < workerCount; ++i){
+        workers.emplace_back(WorkerLoop, i);
+    }
+}
+
+// Runs the jobs that are left and joins the workers
+void JobSystem::Shutdown(){
+    if(!running.exchange(false)){
+        return;
+    }
+    wakeUp.notify_all();
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+    workers.clear();
+    // Jobs that other jobs submitted on the way out
+    for(Job* job = FindJob(); job != nullptr; job = FindJob()){
+        Execute(job);
+    }
+    deques.clear();
+}
+
+// Runs 'job' on some thread, counted in 'counter'
+void JobSystem::Run(JobCounter& counter, std::function<void()> job){
+    counter.Add();
+    Job* queued = new Job{std::move(job), &counter};
+    bool pushed = false;
+    if(running.load(std::memory_order_acquire)){
+        queuedJobs.fetch_add(1, std::memory_order_relaxed);
+        pushed = workerIndex >= 0 ? deques[workerIndex]->Push(queued) : sharedQueue.Push(queued);
+        if(!pushed){
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    if(!pushed){
+        // No workers, or the queue is full: do it now
+        Execute(queued);
+        return;
+    }
+    if(sleepingWorkers.load() > 0){
+        wakeUp.notify_one();
+    }
+}
+
+// Runs queued jobs on the calling thread until 'counter' is done
+void JobSystem::Wait(JobCounter& counter){
+    PROFILE_ZONE("JobSystem::Wait");
+    while(!counter.IsDone()){
+        Job* job = FindJob();
+        if(job != nullptr){
+            Execute(job);
+        }else{
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Calls work(begin, end) on ranges of at most 'grain' items that cover [0, count)
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& work){
+    if(grain == 0){
+        grain = std::max<size_t>(1, count / (4 * getConcurrency()));
+    }
+    if(count <= grain || !running.load(std::memory_order_acquire)){
+        if(count > 0){
+            work(0, count);
+        }
+        return;
+    }
+
+    // The calling thread takes the first range itself
+    JobCounter counter;
+    for(size_t begin = grain; begin < count; begin += grain){
+        size_t end = std::min(count, begin + grain);
+        Run(counter, [&work, begin, end]{ work(begin, end); });
+    }
+    work(0, grain);
+    Wait(counter);
+}
+
+// Returns the number of worker threads
+int JobSystem::getWorkerCount(){
+    return static_cast<int>(workers.size());
+}
@@ -0,0 +1,137 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Profiler::s_enabled{false};
+
+namespace{
+struct Event{
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+struct ThreadRing{
+    std::vector<Event> events;
+    // Total events recorded, the ring holds the last events.size() of them
+    uint64_t written{0};
+    // Chrome trace thread id
+    int id{0};
+    bool inUse{false};
+};
+
+// Guards the list of rings and their inUse flags, never the events
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<ThreadRing>> rings;
+int ringCapacity = 1 << 16;
+
+// Gives the ring back when its thread exits
+struct RingHolder{
+    ThreadRing* ring{nullptr};
+    ~RingHolder(){
+        if(ring != nullptr){
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            ring->inUse = false;
+        }
+    }
+};
+thread_local RingHolder threadRing;
+
+// Takes a ring that no running thread owns, or adds one
+ThreadRing* AcquireRing(){
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for(std::unique_ptr<ThreadRing>& ring : rings){
+        if(!ring->inUse){
+            ring->inUse = true;
+            return ring.get();
+        }
+    }
+    std::unique_ptr<ThreadRing> ring(new ThreadRing());
+    ring->events.resize(ringCapacity);
+    ring->id = static_cast<int>(rings.size()) + 1;
+    ring->inUse = true;
+    rings.push_back(std::move(ring));
+    return rings.back().get();
+}
+
+// Zone names are code literals, only quotes and backslashes need escaping
+std::string EscapeJson(const char* text){
+    std::string escaped;
+    for(const char* c = text; *c != '\0'; ++c){
+        if(*c == '"' || *c == '\\'){
+            escaped += '\\';
+        }
+        escaped += *c;
+    }
+    return escaped;
+}
+}
+
+// Starts recording, every thread's ring keeps the last 'eventsPerThread' zones
+void Profiler::Enable(int eventsPerThread){
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        ringCapacity = std::max(1, eventsPerThread);
+    }
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+// Nanoseconds on a steady clock
+uint64_t Profiler::Now(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Adds a finished zone to the calling thread's ring
+void Profiler::Record(const char* name, uint64_t start, uint64_t end){
+    if(threadRing.ring == nullptr){
+        threadRing.ring = AcquireRing();
+    }
+    ThreadRing& ring = *threadRing.ring;
+    ring.events[ring.written % ring.events.size()] = Event{name, start, end};
+    ++ring.written;
+}
+
+// Writes every ring as Chrome trace JSON
+bool Profiler::WriteChromeTrace(const std::string& path){
+    std::ofstream file(path);
+    if(!file.is_open()){
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    // Timestamps start at the earliest zone still in a ring
+    uint64_t origin = UINT64_MAX;
+    for(const std::unique_ptr<ThreadRing>& ring : rings){
+        uint64_t kept = std::min<uint64_t>(ring->written, ring->events.size());
+        for(uint64_t i = ring->written - kept; i < ring->written; ++i){
+            origin = std::min(origin, ring->events[i % ring->events.size()].start);
+        }
+    }
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[\n";
+    bool first = true;
+    for(const std::unique_ptr<ThreadRing>& ring : rings){
+        file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->id
+             << ",\"args\":{\"name\":\"" << (ring->id == 1 ? "main" : "thread " + std::to_string(ring->id)) << "\"}}";
+        first = false;
+
+        uint64_t kept = std::min<uint64_t>(ring->written, ring->events.size());
+        for(uint64_t i = ring->written - kept; i < ring->written; ++i){
+            const Event& event = ring->events[i % ring->events.size()];
+            // Chrome wants microseconds
+            file << ",\n{\"name\":\"" << EscapeJson(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->id
+                 << ",\"ts\":" << (event.start - origin) / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0
+                 << "}";
+        }
+    }
+    file << "\n]}\n";
+    return file.good();
+}
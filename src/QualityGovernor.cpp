@@ -0,0 +1,75 @@
+#include "QualityGovernor.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace{
+// Highest quality first. Render scale goes first since fill rate is the
+// usual limit, tessellation and waves follow once the scale is low
+const QualityLevel kLevels[] = {
+    {1.0f, 4, 1.0f},
+    {1.0f, 4, 0.85f},
+    {0.75f, 4, 0.85f},
+    {0.75f, 3, 0.7f},
+    {0.5f, 3, 0.7f},
+    {0.5f, 2, 0.6f},
+    {0.5f, 1, 0.5f}
+};
+const int kLevelCount = sizeof(kLevels) / sizeof(kLevels[0]);
+}
+
+// Constructor, starts at the highest level
+QualityGovernor::QualityGovernor(const QualityGovernorSettings& settings)
+    : m_settings(settings){
+}
+
+// Settings of the current level
+const QualityLevel& QualityGovernor::getLevel() const{
+    return kLevels[m_level];
+}
+
+// Number of levels, the last one is the cheapest
+int QualityGovernor::getLevelCount(){
+    return kLevelCount;
+}
+
+// Takes the CPU milliseconds of the frame and the rolling GPU milliseconds,
+// returns true when the level changed
+bool QualityGovernor::Update(double cpuMs, double gpuMs){
+    m_cpuTimes.push_back(cpuMs);
+    m_cpuSum += cpuMs;
+    if(static_cast<int>(m_cpuTimes.size()) > m_settings.window){
+        m_cpuSum -= m_cpuTimes.front();
+        m_cpuTimes.pop_front();
+    }
+    if(++m_framesSinceChange < m_settings.cooldown || static_cast<int>(m_cpuTimes.size()) < m_settings.window){
+        return false;
+    }
+
+    double cpuAverage = m_cpuSum / m_cpuTimes.size();
+    double cost = std::max(cpuAverage, gpuMs);
+    int level = m_level;
+    std::ostringstream reason;
+    reason << std::fixed << std::setprecision(1) << "frame cost " << cost << " ms (CPU " << cpuAverage
+           << ", GPU " << gpuMs << ")";
+    if(cost > m_settings.budgetMs && m_level + 1 < kLevelCount){
+        level = m_level + 1;
+        reason << " is over the " << m_settings.budgetMs << " ms budget";
+    }else if(cost < m_settings.headroom * m_settings.budgetMs && m_level > 0){
+        level = m_level - 1;
+        reason << " is under " << m_settings.headroom * m_settings.budgetMs << " ms, "
+               << static_cast<int>(m_settings.headroom * 100.0 + 0.5) << "% of the budget";
+    }
+    if(level == m_level){
+        return false;
+    }
+
+    m_level = level;
+    m_reason = reason.str();
+    // Frames of the old level say nothing about the new one
+    m_cpuTimes.clear();
+    m_cpuSum = 0.0;
+    m_framesSinceChange = 0;
+    return true;
+}
@@ -0,0 +1,29 @@
+#include "SimulationClock.hpp"
+
+// Constructor, starts at 0 seconds in real time mode
+SimulationClock::SimulationClock(){
+}
+
+// Fixed step mode advances by 'step' seconds per tick, real time mode by the wall clock
+void SimulationClock::SetMode(ClockMode mode, double step){
+    m_mode = mode;
+    m_step = step;
+}
+
+// Advances the clock, call once per frame before anything reads it
+void SimulationClock::Tick(){
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    // The first frame is drawn at the start time
+    if(m_frame == 0){
+        m_frameDelta = 0.0;
+    }else if(m_mode == ClockMode::FixedStep){
+        m_frameDelta = m_step;
+    }else{
+        m_frameDelta = std::chrono::duration<double>(now - m_lastTick).count();
+    }
+    m_lastTick = now;
+    ++m_frame;
+
+    m_delta = m_paused ? 0.0 : m_frameDelta * m_scale;
+    m_time += m_delta;
+}
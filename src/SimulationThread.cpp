@@ -0,0 +1,83 @@
+#include "SimulationThread.hpp"
+
+#include "Profiler.hpp"
+
+#include <chrono>
+
+// Constructor starts the thread, or steps on the calling thread when 'threaded' is false
+SimulationThread::SimulationThread(StepFunction step, bool threaded)
+    : m_step(step){
+    if(threaded){
+        m_thread = std::thread(&SimulationThread::Run, this);
+    }
+}
+
+// Destructor finishes the running step and joins the thread
+SimulationThread::~SimulationThread(){
+    if(!m_thread.joinable()){
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+// Starts a step for 'request' unless one is still running
+bool SimulationThread::Request(const SimulationRequest& request){
+    if(!m_thread.joinable()){
+        Step(request);
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_pending || m_busy){
+            return false;
+        }
+        m_request = request;
+        m_pending = true;
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+// Waits until no step is running or requested
+void SimulationThread::WaitIdle(){
+    PROFILE_ZONE("WaitSimulation");
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]{ return !m_pending && !m_busy; });
+}
+
+// Body of the simulation thread
+void SimulationThread::Run(){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true){
+        m_wake.wait(lock, [this]{ return m_pending || m_quit; });
+        if(!m_pending){
+            return;
+        }
+        SimulationRequest request = m_request;
+        m_pending = false;
+        m_busy = true;
+        lock.unlock();
+
+        Step(request);
+
+        lock.lock();
+        m_busy = false;
+        m_idle.notify_all();
+    }
+}
+
+// Runs one step into the back snapshot and publishes it
+void SimulationThread::Step(const SimulationRequest& request){
+    PROFILE_ZONE("SimulationStep");
+    auto start = std::chrono::steady_clock::now();
+    FrameSnapshot& snapshot = m_snapshots.Back();
+    snapshot.request = request;
+    m_step(request, snapshot);
+    snapshot.stepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    m_snapshots.Publish();
+}
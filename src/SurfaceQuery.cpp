@@ -0,0 +1,224 @@
+#include "SurfaceQuery.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace{
+// Below this determinant the jacobian is close to a fold and the Newton step
+// would shoot off, so a damped fixed point step is taken instead
+const float kMinDeterminant = 0.1f;
+const float kFixedPointDamping = 0.5f;
+// Halved steps in a row after which a point is taken to be stuck
+const int kMaxRejections = 3;
+
+// Point in the unit disc that depends only on the point index and the
+// iteration, so results do not depend on the threads or the chunk size
+glm::vec2 RestartOffset(size_t point, int iteration){
+    uint32_t hash = static_cast<uint32_t>(point) * 2654435761u ^ static_cast<uint32_t>(iteration) * 40503u;
+    hash ^= hash >> 13;
+    hash *= 0x5bd1e995u;
+    hash ^= hash >> 15;
+    float angle = (hash & 0xffffu) / 65536.0f * 6.2831853f;
+    float radius = std::sqrt((hash >> 16) / 65536.0f);
+    return glm::vec2(std::cos(angle), std::sin(angle)) * radius;
+}
+}
+
+// Resizes every array to 'count' points
+void SurfaceQueryBatch::Resize(size_t count){
+    std::vector<float>* arrays[] = {&x, &z, &height, &normalX, &normalY, &normalZ, &sourceX, &sourceZ, &error};
+    for(std::vector<float>* array : arrays){
+        array->resize(count);
+    }
+}
+
+// Constructor takes the first 'activeWaves' waves of 'waves' at time 0
+SurfaceQuery::SurfaceQuery(const WaveSet& waves, int activeWaves, const SurfaceQuerySettings& settings)
+    : m_settings(settings), m_evaluator(waves, activeWaves){
+    m_settings.chunkSize = std::max(8, m_settings.chunkSize);
+    m_settings.maxIterations = std::max(0, m_settings.maxIterations);
+    m_threadCount = m_settings.threadCount;
+    if(m_threadCount <= 0){
+        m_threadCount = JobSystem::getConcurrency();
+    }
+    m_scratch.resize(m_threadCount);
+
+    for(int i = 0; i < m_evaluator.getWaveCount(); ++i){
+        m_maxDisplacement += std::abs(waves.constants()[i].width);
+    }
+}
+
+// Moves the waves to 'time' seconds
+void SurfaceQuery::SetTime(double time){
+    m_evaluator.SetTime(time);
+}
+
+// Solves the points [begin, end) with Newton steps on the horizontal displacement
+size_t SurfaceQuery::SolveChunk(SurfaceQueryBatch& batch, size_t begin, size_t end, SolverScratch& scratch) const{
+    const size_t count = end - begin;
+    WaveBatch& waves = scratch.waves;
+    waves.Resize(count, true);
+    scratch.lastX.resize(count);
+    scratch.lastZ.resize(count);
+    scratch.lastResidualX.resize(count);
+    scratch.lastResidualZ.resize(count);
+    scratch.lastErrorSquared.assign(count, std::numeric_limits<float>::infinity());
+    scratch.rejected.assign(count, 0);
+    if(m_settings.warmStart){
+        // The caller's sources, usually the ones solved for last step
+        std::copy(batch.sourceX.begin() + begin, batch.sourceX.begin() + end, waves.x.begin());
+        std::copy(batch.sourceZ.begin() + begin, batch.sourceZ.begin() + end, waves.z.begin());
+    }else{
+        // The point itself is the first guess, exact where the water is flat
+        std::copy(batch.x.begin() + begin, batch.x.begin() + end, waves.x.begin());
+        std::copy(batch.z.begin() + begin, batch.z.begin() + end, waves.z.begin());
+    }
+    const float toleranceSquared = m_settings.tolerance * m_settings.tolerance;
+
+    for(int iteration = 0; ; ++iteration){
+        m_evaluator.Evaluate(waves, 0, count, WaveEvaluator::BestKernel());
+        if(iteration == m_settings.maxIterations){
+            break;
+        }
+
+        bool converged = true;
+        for(size_t i = 0; i < count; ++i){
+            float residualX = batch.x[begin + i] - waves.positionX[i];
+            float residualZ = batch.z[begin + i] - waves.positionZ[i];
+            float errorSquared = residualX * residualX + residualZ * residualZ;
+            if(errorSquared <= toleranceSquared){
+                continue;
+            }
+            converged = false;
+
+            if(errorSquared >= scratch.lastErrorSquared[i]){
+                if(++scratch.rejected[i] < kMaxRejections){
+                    // The step overshot, try half of it
+                    waves.x[i] = scratch.lastX[i] + 0.5f * (waves.x[i] - scratch.lastX[i]);
+                    waves.z[i] = scratch.lastZ[i] + 0.5f * (waves.z[i] - scratch.lastZ[i]);
+                }else{
+                    // Stuck in a dip of the error between folds, start again
+                    // from another point that could be the source
+                    glm::vec2 offset = RestartOffset(begin + i, iteration) * m_maxDisplacement;
+                    waves.x[i] = batch.x[begin + i] + offset.x;
+                    waves.z[i] = batch.z[begin + i] + offset.y;
+                    scratch.lastErrorSquared[i] = std::numeric_limits<float>::infinity();
+                    scratch.rejected[i] = 0;
+                }
+                continue;
+            }
+            scratch.lastX[i] = waves.x[i];
+            scratch.lastZ[i] = waves.z[i];
+            scratch.lastResidualX[i] = residualX;
+            scratch.lastResidualZ[i] = residualZ;
+            scratch.lastErrorSquared[i] = errorSquared;
+            scratch.rejected[i] = 0;
+
+            float xx = waves.jacobianXX[i], xz = waves.jacobianXZ[i], zz = waves.jacobianZZ[i];
+            float determinant = xx * zz - xz * xz;
+            float stepX, stepZ;
+            if(std::abs(determinant) > kMinDeterminant){
+                stepX = (zz * residualX - xz * residualZ) / determinant;
+                stepZ = (xx * residualZ - xz * residualX) / determinant;
+            }else{
+                stepX = residualX * kFixedPointDamping;
+                stepZ = residualZ * kFixedPointDamping;
+            }
+            waves.x[i] += stepX;
+            waves.z[i] += stepZ;
+
+            // No wave moves a point further than the sum of their widths
+            float offsetX = waves.x[i] - batch.x[begin + i];
+            float offsetZ = waves.z[i] - batch.z[begin + i];
+            float offset = std::sqrt(offsetX * offsetX + offsetZ * offsetZ);
+            if(offset > m_maxDisplacement){
+                waves.x[i] = batch.x[begin + i] + offsetX * (m_maxDisplacement / offset);
+                waves.z[i] = batch.z[begin + i] + offsetZ * (m_maxDisplacement / offset);
+            }
+        }
+        if(converged){
+            break;
+        }
+    }
+
+    // Points whose last step made things worse go back to their best guess
+    bool worse = false;
+    for(size_t i = 0; i < count; ++i){
+        float residualX = batch.x[begin + i] - waves.positionX[i];
+        float residualZ = batch.z[begin + i] - waves.positionZ[i];
+        if(residualX * residualX + residualZ * residualZ > scratch.lastErrorSquared[i]){
+            waves.x[i] = scratch.lastX[i];
+            waves.z[i] = scratch.lastZ[i];
+            worse = true;
+        }
+    }
+    if(worse){
+        m_evaluator.Evaluate(waves, 0, count, WaveEvaluator::BestKernel());
+    }
+
+    size_t unconverged = 0;
+    for(size_t i = 0; i < count; ++i){
+        float residualX = batch.x[begin + i] - waves.positionX[i];
+        float residualZ = batch.z[begin + i] - waves.positionZ[i];
+        float error = std::sqrt(residualX * residualX + residualZ * residualZ);
+        float normalLength = std::sqrt(waves.normalX[i] * waves.normalX[i] + waves.normalY[i] * waves.normalY[i] +
+                                       waves.normalZ[i] * waves.normalZ[i]);
+
+        batch.height[begin + i] = waves.positionY[i];
+        batch.normalX[begin + i] = waves.normalX[i] / normalLength;
+        batch.normalY[begin + i] = waves.normalY[i] / normalLength;
+        batch.normalZ[begin + i] = waves.normalZ[i] / normalLength;
+        batch.sourceX[begin + i] = waves.x[i];
+        batch.sourceZ[begin + i] = waves.z[i];
+        batch.error[begin + i] = error;
+        if(error > m_settings.tolerance){
+            ++unconverged;
+        }
+    }
+    return unconverged;
+}
+
+// Solves the points [begin, size) of 'batch' in chunks over the threads
+size_t SurfaceQuery::Solve(SurfaceQueryBatch& batch, size_t begin){
+    PROFILE_ZONE("SurfaceQuery::Solve");
+    auto start = std::chrono::steady_clock::now();
+    const size_t end = batch.size();
+    const size_t chunkSize = static_cast<size_t>(m_settings.chunkSize);
+    const size_t chunks = begin < end ? (end - begin + chunkSize - 1) / chunkSize : 0;
+    const bool budgeted = m_settings.budgetMs > 0.0;
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::milli>(m_settings.budgetMs));
+
+    // Chunks are handed out in order, and every chunk taken is finished, so
+    // the solved points always form one range from 'begin'
+    std::atomic<size_t> nextChunk{0};
+    std::atomic<size_t> unconverged{0};
+    auto work = [&](size_t thread){
+        PROFILE_ZONE("SurfaceQuery::Work");
+        while(!budgeted || std::chrono::steady_clock::now() < deadline){
+            size_t chunk = nextChunk.fetch_add(1);
+            if(chunk >= chunks){
+                break;
+            }
+            size_t first = begin + chunk * chunkSize;
+            unconverged += SolveChunk(batch, first, std::min(first + chunkSize, end), m_scratch[thread]);
+        }
+    };
+
+    // One job per thread, each with its own scratch
+    JobSystem::ParallelFor(std::min<size_t>(m_threadCount, chunks), 1, [&](size_t first, size_t last){
+        for(size_t thread = first; thread < last; ++thread){
+            work(thread);
+        }
+    });
+
+    m_unconverged = unconverged;
+    m_solveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return std::min(end, begin + std::min(nextChunk.load(), chunks) * chunkSize);
+}
@@ -0,0 +1,76 @@
+#include "UniformRing.hpp"
+
+// Constructor, 'blockSize' bytes per slot
+UniformRing::UniformRing(GLsizeiptr blockSize, int slots, bool allowPersistent)
+    : m_blockSize(blockSize), m_stride(blockSize), m_slots(slots){
+    GLint alignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_stride = (blockSize + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    if(allowPersistent && GLAD_GL_ARB_buffer_storage){
+        // Coherent, so writes are visible to the GPU without a flush
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, m_stride * m_slots, nullptr, flags);
+        m_mapped = static_cast<char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, m_stride * m_slots, flags));
+    }
+    if(m_mapped == nullptr){
+        glBufferData(GL_UNIFORM_BUFFER, m_stride * m_slots, nullptr, GL_STREAM_DRAW);
+    }
+    m_fences.assign(m_slots, nullptr);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Destructor unmaps and deletes the buffer and any pending fences
+UniformRing::~UniformRing(){
+    for(GLsync fence : m_fences){
+        if(fence != nullptr){
+            glDeleteSync(fence);
+        }
+    }
+    if(m_mapped != nullptr){
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &m_buffer);
+}
+
+// Returns the memory of the next slot to write
+void* UniformRing::Begin(){
+    GLsync& fence = m_fences[m_slot];
+    if(fence != nullptr){
+        // Only waits when the GPU is a whole ring of frames behind
+        if(glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED){
+            ++m_waits;
+            while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED){
+            }
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if(m_mapped != nullptr){
+        return m_mapped + m_slot * m_stride;
+    }
+
+    // The fence has passed, so the driver need not wait for the other slots
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    return glMapBufferRange(GL_UNIFORM_BUFFER, m_slot * m_stride, m_blockSize, flags);
+}
+
+// Makes the slot written since Begin() visible at 'bindingPoint'
+void UniformRing::End(GLuint bindingPoint){
+    if(m_mapped == nullptr){
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, m_buffer, m_slot * m_stride, m_blockSize);
+}
+
+// Fences the current slot and moves on, call after its last draw
+void UniformRing::Fence(){
+    m_fences[m_slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_slot = (m_slot + 1) % m_slots;
+}
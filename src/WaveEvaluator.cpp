@@ -0,0 +1,475 @@
+#include "WaveEvaluator.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define WAVE_EVALUATOR_X86 1
+#include <immintrin.h>
+// GCC would fuse the phase's multiplies and adds into FMAs, which rounds it
+// differently from the other kernels and the shader math
+#if defined(__clang__)
+#define WAVE_EVALUATOR_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define WAVE_EVALUATOR_AVX2 __attribute__((target("avx2,fma"), optimize("fp-contract=off")))
+#endif
+#endif
+
+// Fully unrolls the wave loop of the kernels specialized for a wave count
+#if defined(__GNUC__) || defined(__clang__)
+#define WAVE_EVALUATOR_UNROLL _Pragma("GCC unroll 4")
+#else
+#define WAVE_EVALUATOR_UNROLL
+#endif
+
+namespace{
+// Wave model policies, what the kernels add up for every wave
+// Trochoidal waves, the water moves sideways as well as up
+struct GerstnerModel{
+    static const bool kHorizontal = true;
+};
+// Sine waves, the water only moves up and down. Gerstner waves without
+// steepness, so the horizontal terms drop out and the jacobian stays the identity.
+struct SineModel{
+    static const bool kHorizontal = false;
+};
+
+// A kernel specialized for one combination, see PickKernel()
+typedef void (*KernelFunction)(const WaveColumns& waves, WaveBatch& batch, size_t begin, size_t end);
+
+// sin and cos are reduced to r in [-pi/4, pi/4] plus the quadrant q,
+// x = r + q * pi/2. pi/2 is split in three so that q * kPiOver2A and
+// q * kPiOver2B are exact for the q the ocean reaches (below 2^13).
+const float kTwoOverPi = 0.636619772367581343f;
+const float kPiOver2A = 1.5703125f;
+const float kPiOver2B = 4.837512969970703125e-4f;
+const float kPiOver2C = 7.54978995489188216e-8f;
+// Minimax polynomials for sin and cos on [-pi/4, pi/4] (Cephes sinf/cosf)
+const float kSin1 = -1.6666654611e-1f;
+const float kSin2 = 8.3321608736e-3f;
+const float kSin3 = -1.9515295891e-4f;
+const float kCos1 = 4.166664568298827e-2f;
+const float kCos2 = -1.388731625493765e-3f;
+const float kCos3 = 2.443315711809948e-5f;
+
+// sin and cos of 'x' with the same reduction and polynomials as the SIMD kernels
+inline void FastSinCos(float x, float& s, float& c){
+    float t = x * kTwoOverPi;
+    int q = static_cast<int>(t + (t >= 0.0f ? 0.5f : -0.5f));
+    float j = static_cast<float>(q);
+    float r = ((x - j * kPiOver2A) - j * kPiOver2B) - j * kPiOver2C;
+    float r2 = r * r;
+    float sinR = r + r * r2 * (kSin1 + r2 * (kSin2 + r2 * kSin3));
+    float cosR = 1.0f - 0.5f * r2 + r2 * r2 * (kCos1 + r2 * (kCos2 + r2 * kCos3));
+
+    // Odd quadrants swap sin and cos, sin is negative in quadrants 2 and 3,
+    // cos in quadrants 1 and 2
+    s = (q & 1) ? cosR : sinR;
+    c = (q & 1) ? sinR : cosR;
+    if(q & 2){
+        s = -s;
+    }
+    if((q + 1) & 2){
+        c = -c;
+    }
+}
+
+// Same as gerstner_wave() in gerstner_tese.glsl, one point at a time.
+// Every kernel is a template over the wave model, the outputs it writes and
+// the number of waves, 0 for any number; the checks on them are compile
+// time constants, so each combination is its own loop without branches.
+template<class Model, bool kNormal, bool kJacobian, int kWaveCount>
+void EvaluateScalar(const WaveColumns& waves, WaveBatch& batch, size_t begin, size_t end){
+    const int count = kWaveCount > 0 ? kWaveCount : static_cast<int>(waves.amplitude.size());
+    for(size_t p = begin; p < end; ++p){
+        float x = batch.x[p], z = batch.z[p];
+        float positionX = x, positionY = 0.0f, positionZ = z;
+        float normalX = 0.0f, normalY = 1.0f, normalZ = 0.0f;
+        float jacobianXX = 1.0f, jacobianXZ = 0.0f, jacobianZZ = 1.0f;
+        WAVE_EVALUATOR_UNROLL
+        for(int i = 0; i < count; ++i){
+            float theta = (x * waves.waveVectorX[i] + z * waves.waveVectorZ[i]) + waves.phase[i];
+            float s, c;
+            FastSinCos(theta, s, c);
+
+            positionY += waves.amplitude[i] * s;
+            if(Model::kHorizontal){
+                positionX += waves.directionX[i] * (waves.width[i] * c);
+                positionZ += waves.directionZ[i] * (waves.width[i] * c);
+            }
+
+            if(kNormal){
+                if(Model::kHorizontal){
+                    normalY -= waves.steepSlope[i] * s;
+                }
+                normalX -= waves.directionX[i] * (waves.slope[i] * c);
+                normalZ -= waves.directionZ[i] * (waves.slope[i] * c);
+            }
+
+            if(kJacobian && Model::kHorizontal){
+                jacobianXX -= waves.displacementXX[i] * s;
+                jacobianXZ -= waves.displacementXZ[i] * s;
+                jacobianZZ -= waves.displacementZZ[i] * s;
+            }
+        }
+        batch.positionX[p] = positionX;
+        batch.positionY[p] = positionY;
+        batch.positionZ[p] = positionZ;
+        if(kNormal){
+            batch.normalX[p] = normalX;
+            batch.normalY[p] = normalY;
+            batch.normalZ[p] = normalZ;
+        }
+        if(kJacobian){
+            batch.jacobianXX[p] = jacobianXX;
+            batch.jacobianXZ[p] = jacobianXZ;
+            batch.jacobianZZ[p] = jacobianZZ;
+        }
+    }
+}
+
+#if defined(WAVE_EVALUATOR_X86)
+// FastSinCos for 4 values, SSE2 is part of x86-64 so this needs no check
+inline void SinCosSSE(__m128 x, __m128& s, __m128& c){
+    __m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(kTwoOverPi)));
+    __m128 j = _mm_cvtepi32_ps(q);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(kPiOver2A)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(kPiOver2B)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(kPiOver2C)));
+    __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 sinR = _mm_add_ps(_mm_set1_ps(kSin2), _mm_mul_ps(r2, _mm_set1_ps(kSin3)));
+    sinR = _mm_add_ps(_mm_set1_ps(kSin1), _mm_mul_ps(r2, sinR));
+    sinR = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sinR));
+    __m128 cosR = _mm_add_ps(_mm_set1_ps(kCos2), _mm_mul_ps(r2, _mm_set1_ps(kCos3)));
+    cosR = _mm_add_ps(_mm_set1_ps(kCos1), _mm_mul_ps(r2, cosR));
+    cosR = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)),
+                      _mm_mul_ps(_mm_mul_ps(r2, r2), cosR));
+
+    // Quadrant bits as masks: bit 0 swaps, bit 1 of q and q + 1 flip the signs
+    const __m128i one = _mm_set1_epi32(1);
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one));
+    __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+    __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, one), _mm_set1_epi32(2)), 30));
+    s = _mm_or_ps(_mm_and_ps(swap, cosR), _mm_andnot_ps(swap, sinR));
+    c = _mm_or_ps(_mm_and_ps(swap, sinR), _mm_andnot_ps(swap, cosR));
+    s = _mm_xor_ps(s, sinSign);
+    c = _mm_xor_ps(c, cosSign);
+}
+
+// Four points at a time, the rest with the scalar kernel
+template<class Model, bool kNormal, bool kJacobian, int kWaveCount>
+void EvaluateSSE(const WaveColumns& waves, WaveBatch& batch, size_t begin, size_t end){
+    const int count = kWaveCount > 0 ? kWaveCount : static_cast<int>(waves.amplitude.size());
+    size_t p = begin;
+    for(; p + 4 <= end; p += 4){
+        __m128 x = _mm_loadu_ps(&batch.x[p]);
+        __m128 z = _mm_loadu_ps(&batch.z[p]);
+        __m128 positionX = x, positionY = _mm_setzero_ps(), positionZ = z;
+        __m128 normalX = _mm_setzero_ps(), normalY = _mm_set1_ps(1.0f), normalZ = _mm_setzero_ps();
+        __m128 jacobianXX = _mm_set1_ps(1.0f), jacobianXZ = _mm_setzero_ps(), jacobianZZ = _mm_set1_ps(1.0f);
+        WAVE_EVALUATOR_UNROLL
+        for(int i = 0; i < count; ++i){
+            __m128 theta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(waves.waveVectorX[i])),
+                                                 _mm_mul_ps(z, _mm_set1_ps(waves.waveVectorZ[i]))),
+                                      _mm_set1_ps(waves.phase[i]));
+            __m128 s, c;
+            SinCosSSE(theta, s, c);
+
+            __m128 directionX = _mm_set1_ps(waves.directionX[i]);
+            __m128 directionZ = _mm_set1_ps(waves.directionZ[i]);
+
+            positionY = _mm_add_ps(positionY, _mm_mul_ps(_mm_set1_ps(waves.amplitude[i]), s));
+            if(Model::kHorizontal){
+                __m128 width = _mm_mul_ps(_mm_set1_ps(waves.width[i]), c);
+                positionX = _mm_add_ps(positionX, _mm_mul_ps(directionX, width));
+                positionZ = _mm_add_ps(positionZ, _mm_mul_ps(directionZ, width));
+            }
+
+            if(kNormal){
+                __m128 slope = _mm_mul_ps(_mm_set1_ps(waves.slope[i]), c);
+                if(Model::kHorizontal){
+                    normalY = _mm_sub_ps(normalY, _mm_mul_ps(_mm_set1_ps(waves.steepSlope[i]), s));
+                }
+                normalX = _mm_sub_ps(normalX, _mm_mul_ps(directionX, slope));
+                normalZ = _mm_sub_ps(normalZ, _mm_mul_ps(directionZ, slope));
+            }
+
+            if(kJacobian && Model::kHorizontal){
+                jacobianXX = _mm_sub_ps(jacobianXX, _mm_mul_ps(_mm_set1_ps(waves.displacementXX[i]), s));
+                jacobianXZ = _mm_sub_ps(jacobianXZ, _mm_mul_ps(_mm_set1_ps(waves.displacementXZ[i]), s));
+                jacobianZZ = _mm_sub_ps(jacobianZZ, _mm_mul_ps(_mm_set1_ps(waves.displacementZZ[i]), s));
+            }
+        }
+        _mm_storeu_ps(&batch.positionX[p], positionX);
+        _mm_storeu_ps(&batch.positionY[p], positionY);
+        _mm_storeu_ps(&batch.positionZ[p], positionZ);
+        if(kNormal){
+            _mm_storeu_ps(&batch.normalX[p], normalX);
+            _mm_storeu_ps(&batch.normalY[p], normalY);
+            _mm_storeu_ps(&batch.normalZ[p], normalZ);
+        }
+        if(kJacobian){
+            _mm_storeu_ps(&batch.jacobianXX[p], jacobianXX);
+            _mm_storeu_ps(&batch.jacobianXZ[p], jacobianXZ);
+            _mm_storeu_ps(&batch.jacobianZZ[p], jacobianZZ);
+        }
+    }
+    EvaluateScalar<Model, kNormal, kJacobian, kWaveCount>(waves, batch, p, end);
+}
+
+// FastSinCos for 8 values, the polynomials use FMA
+WAVE_EVALUATOR_AVX2
+inline void SinCosAVX2(__m256 x, __m256& s, __m256& c){
+    __m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(kTwoOverPi)));
+    __m256 j = _mm256_cvtepi32_ps(q);
+    __m256 r = _mm256_fnmadd_ps(j, _mm256_set1_ps(kPiOver2A), x);
+    r = _mm256_fnmadd_ps(j, _mm256_set1_ps(kPiOver2B), r);
+    r = _mm256_fnmadd_ps(j, _mm256_set1_ps(kPiOver2C), r);
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 sinR = _mm256_fmadd_ps(r2, _mm256_set1_ps(kSin3), _mm256_set1_ps(kSin2));
+    sinR = _mm256_fmadd_ps(r2, sinR, _mm256_set1_ps(kSin1));
+    sinR = _mm256_fmadd_ps(_mm256_mul_ps(r, r2), sinR, r);
+    __m256 cosR = _mm256_fmadd_ps(r2, _mm256_set1_ps(kCos3), _mm256_set1_ps(kCos2));
+    cosR = _mm256_fmadd_ps(r2, cosR, _mm256_set1_ps(kCos1));
+    cosR = _mm256_fmadd_ps(_mm256_mul_ps(r2, r2), cosR, _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), r2, _mm256_set1_ps(1.0f)));
+
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, one), one));
+    __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30));
+    __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, one), _mm256_set1_epi32(2)), 30));
+    s = _mm256_xor_ps(_mm256_blendv_ps(sinR, cosR, swap), sinSign);
+    c = _mm256_xor_ps(_mm256_blendv_ps(cosR, sinR, swap), cosSign);
+}
+
+// Eight points at a time, the rest with the scalar kernel
+template<class Model, bool kNormal, bool kJacobian, int kWaveCount>
+WAVE_EVALUATOR_AVX2
+void EvaluateAVX2(const WaveColumns& waves, WaveBatch& batch, size_t begin, size_t end){
+    const int count = kWaveCount > 0 ? kWaveCount : static_cast<int>(waves.amplitude.size());
+    size_t p = begin;
+    for(; p + 8 <= end; p += 8){
+        __m256 x = _mm256_loadu_ps(&batch.x[p]);
+        __m256 z = _mm256_loadu_ps(&batch.z[p]);
+        __m256 positionX = x, positionY = _mm256_setzero_ps(), positionZ = z;
+        __m256 normalX = _mm256_setzero_ps(), normalY = _mm256_set1_ps(1.0f), normalZ = _mm256_setzero_ps();
+        __m256 jacobianXX = _mm256_set1_ps(1.0f), jacobianXZ = _mm256_setzero_ps(), jacobianZZ = _mm256_set1_ps(1.0f);
+        WAVE_EVALUATOR_UNROLL
+        for(int i = 0; i < count; ++i){
+            // Same rounding as the shader's dot(), see WAVE_EVALUATOR_AVX2
+            __m256 theta = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(waves.waveVectorX[i])),
+                                                       _mm256_mul_ps(z, _mm256_set1_ps(waves.waveVectorZ[i]))),
+                                         _mm256_set1_ps(waves.phase[i]));
+            __m256 s, c;
+            SinCosAVX2(theta, s, c);
+
+            __m256 directionX = _mm256_set1_ps(waves.directionX[i]);
+            __m256 directionZ = _mm256_set1_ps(waves.directionZ[i]);
+
+            positionY = _mm256_fmadd_ps(_mm256_set1_ps(waves.amplitude[i]), s, positionY);
+            if(Model::kHorizontal){
+                __m256 width = _mm256_mul_ps(_mm256_set1_ps(waves.width[i]), c);
+                positionX = _mm256_fmadd_ps(directionX, width, positionX);
+                positionZ = _mm256_fmadd_ps(directionZ, width, positionZ);
+            }
+
+            if(kNormal){
+                __m256 slope = _mm256_mul_ps(_mm256_set1_ps(waves.slope[i]), c);
+                if(Model::kHorizontal){
+                    normalY = _mm256_fnmadd_ps(_mm256_set1_ps(waves.steepSlope[i]), s, normalY);
+                }
+                normalX = _mm256_fnmadd_ps(directionX, slope, normalX);
+                normalZ = _mm256_fnmadd_ps(directionZ, slope, normalZ);
+            }
+
+            if(kJacobian && Model::kHorizontal){
+                jacobianXX = _mm256_fnmadd_ps(_mm256_set1_ps(waves.displacementXX[i]), s, jacobianXX);
+                jacobianXZ = _mm256_fnmadd_ps(_mm256_set1_ps(waves.displacementXZ[i]), s, jacobianXZ);
+                jacobianZZ = _mm256_fnmadd_ps(_mm256_set1_ps(waves.displacementZZ[i]), s, jacobianZZ);
+            }
+        }
+        _mm256_storeu_ps(&batch.positionX[p], positionX);
+        _mm256_storeu_ps(&batch.positionY[p], positionY);
+        _mm256_storeu_ps(&batch.positionZ[p], positionZ);
+        if(kNormal){
+            _mm256_storeu_ps(&batch.normalX[p], normalX);
+            _mm256_storeu_ps(&batch.normalY[p], normalY);
+            _mm256_storeu_ps(&batch.normalZ[p], normalZ);
+        }
+        if(kJacobian){
+            _mm256_storeu_ps(&batch.jacobianXX[p], jacobianXX);
+            _mm256_storeu_ps(&batch.jacobianXZ[p], jacobianXZ);
+            _mm256_storeu_ps(&batch.jacobianZZ[p], jacobianZZ);
+        }
+    }
+    EvaluateScalar<Model, kNormal, kJacobian, kWaveCount>(waves, batch, p, end);
+}
+#endif
+
+// The kernel of one combination for 'kernel'
+template<class Model, bool kNormal, bool kJacobian, int kWaveCount>
+KernelFunction PickKernel(WaveKernel kernel){
+    switch(kernel){
+#if defined(WAVE_EVALUATOR_X86)
+        case WaveKernel::AVX2:
+            return EvaluateAVX2<Model, kNormal, kJacobian, kWaveCount>;
+        case WaveKernel::SSE:
+            return EvaluateSSE<Model, kNormal, kJacobian, kWaveCount>;
+#endif
+        default:
+            return EvaluateScalar<Model, kNormal, kJacobian, kWaveCount>;
+    }
+}
+
+// The kernel unrolled for 'waveCount' waves if there is one, the loop otherwise
+template<class Model, bool kNormal, bool kJacobian>
+KernelFunction PickKernel(WaveKernel kernel, int waveCount){
+    static_assert(WaveEvaluator::kMaxUnrolledWaves == 4, "one case per unrolled wave count");
+    switch(waveCount){
+        case 1: return PickKernel<Model, kNormal, kJacobian, 1>(kernel);
+        case 2: return PickKernel<Model, kNormal, kJacobian, 2>(kernel);
+        case 3: return PickKernel<Model, kNormal, kJacobian, 3>(kernel);
+        case 4: return PickKernel<Model, kNormal, kJacobian, 4>(kernel);
+        default: return PickKernel<Model, kNormal, kJacobian, 0>(kernel);
+    }
+}
+
+// The kernel that writes 'outputs'
+template<class Model>
+KernelFunction PickKernel(WaveKernel kernel, int waveCount, WaveOutputs outputs){
+    switch(outputs){
+        case WaveOutputs::Position:
+            return PickKernel<Model, false, false>(kernel, waveCount);
+        case WaveOutputs::PositionJacobian:
+            return PickKernel<Model, false, true>(kernel, waveCount);
+        case WaveOutputs::PositionNormalJacobian:
+            return PickKernel<Model, true, true>(kernel, waveCount);
+        default:
+            return PickKernel<Model, true, false>(kernel, waveCount);
+    }
+}
+}
+
+// Resizes every array to 'count' points
+void WaveBatch::Resize(size_t count, bool jacobian){
+    std::vector<float>* arrays[] = {&x, &z, &positionX, &positionY, &positionZ, &normalX, &normalY, &normalZ};
+    for(std::vector<float>* array : arrays){
+        array->resize(count);
+    }
+    std::vector<float>* jacobianArrays[] = {&jacobianXX, &jacobianXZ, &jacobianZZ};
+    for(std::vector<float>* array : jacobianArrays){
+        array->resize(jacobian ? count : 0);
+    }
+}
+
+// Constructor takes the first 'activeWaves' waves of 'waves' at time 0
+WaveEvaluator::WaveEvaluator(const WaveSet& waves, int activeWaves)
+    : m_waves(waves){
+    int count = std::max(0, std::min(activeWaves, waves.size()));
+    m_model = WaveModel::Sine;
+    for(int i = 0; i < count; ++i){
+        const GerstnerWaveConstants& wave = waves.constants()[i];
+        m_columns.directionX.push_back(wave.direction.x);
+        m_columns.directionZ.push_back(wave.direction.y);
+        m_columns.waveVectorX.push_back(wave.waveVector.x);
+        m_columns.waveVectorZ.push_back(wave.waveVector.y);
+        m_columns.amplitude.push_back(wave.amplitude);
+        m_columns.width.push_back(wave.width);
+        m_columns.slope.push_back(wave.slope);
+        m_columns.steepSlope.push_back(wave.steepSlope);
+        m_columns.displacementXX.push_back(wave.width * wave.direction.x * wave.waveVector.x);
+        m_columns.displacementXZ.push_back(wave.width * wave.direction.x * wave.waveVector.y);
+        m_columns.displacementZZ.push_back(wave.width * wave.direction.y * wave.waveVector.y);
+        if(wave.width != 0.0f){
+            m_model = WaveModel::Gerstner;
+        }
+    }
+    m_columns.phase.resize(count);
+    SetTime(0.0);
+}
+
+// Moves the waves to 'time' seconds
+void WaveEvaluator::SetTime(double time){
+    m_time = time;
+    for(int i = 0; i < getWaveCount(); ++i){
+        m_columns.phase[i] = m_waves.Phase(i, time);
+    }
+}
+
+// Evaluates the points [begin, end) of 'batch' with 'kernel', every output the batch has
+void WaveEvaluator::Evaluate(WaveBatch& batch, size_t begin, size_t end, WaveKernel kernel) const{
+    WaveOutputs outputs = batch.hasJacobian() ? WaveOutputs::PositionNormalJacobian : WaveOutputs::PositionNormal;
+    Evaluate(batch, begin, end, kernel, outputs);
+}
+
+// Evaluates the points [begin, end) of 'batch' with 'kernel', only 'outputs'
+void WaveEvaluator::Evaluate(WaveBatch& batch, size_t begin, size_t end, WaveKernel kernel, WaveOutputs outputs) const{
+    end = std::min(end, batch.size());
+    if(begin >= end){
+        return;
+    }
+    int waveCount = m_unrolled ? getWaveCount() : 0;
+    KernelFunction function = m_model == WaveModel::Sine ? PickKernel<SineModel>(kernel, waveCount, outputs)
+                                                         : PickKernel<GerstnerModel>(kernel, waveCount, outputs);
+    function(m_columns, batch, begin, end);
+}
+
+// Evaluates every point of 'batch' with the fastest supported kernel
+void WaveEvaluator::Evaluate(WaveBatch& batch) const{
+    Evaluate(batch, 0, batch.size(), BestKernel());
+}
+
+// Returns true if this build and CPU can run 'kernel'
+bool WaveEvaluator::IsSupported(WaveKernel kernel){
+    switch(kernel){
+        case WaveKernel::Scalar:
+            return true;
+#if defined(WAVE_EVALUATOR_X86)
+        case WaveKernel::SSE:
+            return true;
+        case WaveKernel::AVX2:
+            // Also checks that the OS saves the AVX registers
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        default:
+            return false;
+    }
+}
+
+// Returns the fastest kernel this build and CPU can run
+WaveKernel WaveEvaluator::BestKernel(){
+    static const WaveKernel best = IsSupported(WaveKernel::AVX2) ? WaveKernel::AVX2 :
+                                   IsSupported(WaveKernel::SSE) ? WaveKernel::SSE : WaveKernel::Scalar;
+    return best;
+}
+
+// Returns the name of 'model' for printing
+const char* WaveEvaluator::ModelName(WaveModel model){
+    return model == WaveModel::Sine ? "sine" : "gerstner";
+}
+
+// Returns the name of 'outputs' for printing
+const char* WaveEvaluator::OutputsName(WaveOutputs outputs){
+    switch(outputs){
+        case WaveOutputs::Position:
+            return "position";
+        case WaveOutputs::PositionJacobian:
+            return "position and jacobian";
+        case WaveOutputs::PositionNormalJacobian:
+            return "position, normal and jacobian";
+        default:
+            return "position and normal";
+    }
+}
+
+// Returns the name of 'kernel' for printing
+const char* WaveEvaluator::KernelName(WaveKernel kernel){
+    switch(kernel){
+        case WaveKernel::SSE:
+            return "SSE";
+        case WaveKernel::AVX2:
+            return "AVX2";
+        default:
+            return "scalar";
+    }
+}
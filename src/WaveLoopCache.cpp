@@ -0,0 +1,160 @@
+#include "WaveLoopCache.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include "glm/gtc/packing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace{
+// Identifies a loop cache file and its layout version
+const char kCacheMagic[8] = {'G', 'W', 'L', 'O', 'O', 'P', '0', '3'};
+
+template <typename T>
+void AppendBytes(std::vector<uint8_t>& bytes, const T& value){
+    const uint8_t* raw = reinterpret_cast<const uint8_t*>(&value);
+    bytes.insert(bytes.end(), raw, raw + sizeof(T));
+}
+}
+
+// Constructor quantizes 'waves' so that they loop, nothing is baked yet
+WaveLoopCache::WaveLoopCache(const WaveSet& waves, int activeWaves, const WaveLoopSettings& settings)
+    : m_waves(waves.MakePeriodic(settings.tileSize, settings.period)),
+      m_activeWaves(std::min(activeWaves, waves.size())),
+      m_settings(settings){
+}
+
+// Serialized settings and waves, used as both the hash input and file header
+std::vector<uint8_t> WaveLoopCache::Header() const{
+    std::vector<uint8_t> header;
+    AppendBytes(header, m_settings.resolution);
+    AppendBytes(header, m_settings.frames);
+    AppendBytes(header, m_settings.tileSize);
+    AppendBytes(header, m_settings.period);
+    AppendBytes(header, m_activeWaves);
+    for(int i = 0; i < m_activeWaves; ++i){
+        AppendBytes(header, m_waves.waves()[i]);
+    }
+    return header;
+}
+
+// File name derived from a hash of everything that affects the bake
+std::string WaveLoopCache::CacheFileName() const{
+    // 64 bit FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for(uint8_t byte : Header()){
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+
+    std::stringstream name;
+    name << m_settings.cacheDirectory << "/waveloop_" << std::hex << hash << ".bin";
+    return name.str();
+}
+
+// Evaluates frames [first, first + count)
+void WaveLoopCache::BakeFrames(int first, int count){
+    PROFILE_ZONE("WaveLoopCache::BakeFrames");
+    const int resolution = m_settings.resolution;
+    const float texelSize = m_settings.tileSize / resolution;
+
+    for(int frame = first; frame < first + count; ++frame){
+        // Texel centres, so a filtered fetch at t/period lands exactly on a frame
+        float time = (frame + 0.5f) * m_settings.period / m_settings.frames;
+        for(int z = 0; z < resolution; ++z){
+            for(int x = 0; x < resolution; ++x){
+                glm::vec2 start((x + 0.5f) * texelSize, (z + 0.5f) * texelSize);
+                glm::vec3 normal;
+                glm::vec3 position = m_waves.Evaluate(start, time, m_activeWaves, normal);
+                // Shaded like the live waves, with the normal at the displaced position
+                normal = glm::normalize(m_waves.ShadingNormal(glm::vec2(position.x, position.z), time, m_activeWaves));
+                glm::vec3 displacement = position - glm::vec3(start.x, 0.0f, start.y);
+
+                size_t texel = (static_cast<size_t>(frame) * resolution + z) * resolution + x;
+                for(int c = 0; c < 3; ++c){
+                    m_displacement[texel * 4 + c] = glm::packHalf1x16(displacement[c]);
+                    m_normals[texel * 4 + c] = glm::packHalf1x16(normal[c]);
+                }
+                m_displacement[texel * 4 + 3] = 0;
+                m_normals[texel * 4 + 3] = 0;
+            }
+        }
+    }
+}
+
+// Writes the cache file
+void WaveLoopCache::WriteCache(const std::string& fileName) const{
+    std::error_code error;
+    std::filesystem::create_directories(m_settings.cacheDirectory, error);
+
+    std::ofstream file(fileName, std::ios::binary);
+    if(!file.is_open()){
+        std::cout << "WaveLoopCache: could not write " << fileName << "\n";
+        return;
+    }
+
+    std::vector<uint8_t> header = Header();
+    uint32_t headerSize = static_cast<uint32_t>(header.size());
+    file.write(kCacheMagic, sizeof(kCacheMagic));
+    file.write(reinterpret_cast<const char*>(&headerSize), sizeof(headerSize));
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(m_displacement.data()), m_displacement.size() * sizeof(uint16_t));
+    file.write(reinterpret_cast<const char*>(m_normals.data()), m_normals.size() * sizeof(uint16_t));
+}
+
+// Reads the cache file, fails on any mismatch with the current settings
+bool WaveLoopCache::ReadCache(const std::string& fileName){
+    std::ifstream file(fileName, std::ios::binary);
+    if(!file.is_open()){
+        return false;
+    }
+
+    char magic[sizeof(kCacheMagic)];
+    uint32_t headerSize = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&headerSize), sizeof(headerSize));
+
+    std::vector<uint8_t> expected = Header();
+    if(!file || std::memcmp(magic, kCacheMagic, sizeof(magic)) != 0 || headerSize != expected.size()){
+        return false;
+    }
+    std::vector<uint8_t> header(headerSize);
+    file.read(reinterpret_cast<char*>(header.data()), headerSize);
+    if(!file || header != expected){
+        return false;
+    }
+
+    file.read(reinterpret_cast<char*>(m_displacement.data()), m_displacement.size() * sizeof(uint16_t));
+    file.read(reinterpret_cast<char*>(m_normals.data()), m_normals.size() * sizeof(uint16_t));
+    return static_cast<bool>(file);
+}
+
+// Loads the loop from the disk cache, or bakes it and stores it there
+bool WaveLoopCache::Build(){
+    PROFILE_ZONE("WaveLoopCache::Build");
+    size_t texels = static_cast<size_t>(m_settings.resolution) * m_settings.resolution * m_settings.frames;
+    m_displacement.resize(texels * 4);
+    m_normals.resize(texels * 4);
+
+    std::string fileName;
+    if(!m_settings.cacheDirectory.empty()){
+        fileName = CacheFileName();
+        if(ReadCache(fileName)){
+            return true;
+        }
+    }
+
+    // Frames are independent, one JobSystem job each
+    JobSystem::ParallelFor(m_settings.frames, 1, [this](size_t begin, size_t end){
+        BakeFrames(static_cast<int>(begin), static_cast<int>(end - begin));
+    });
+
+    if(!fileName.empty()){
+        WriteCache(fileName);
+    }
+    return false;
+}
@@ -0,0 +1,200 @@
+#include "WaveSet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Constructor creates the default four waves
+WaveSet::WaveSet(){
+    m_waves = {
+        // direction                                   amplitude steepness frequency speed
+        {glm::vec2(glm::sin(0.32f), glm::cos(0.32f)), 1.64f,    1.64f,    3.0f,     2.0f},
+        {glm::vec2(glm::sin(0.75f), glm::cos(0.25f)), 2.5f,     0.5f,     1.0f,     0.3f},
+        {glm::vec2(glm::sin(1.0f),  glm::cos(1.0f)),  1.25f,    1.3f,     4.0f,     4.0f},
+        {glm::vec2(glm::sin(0.5f),  glm::cos(0.5f)),  6.0f,     2.5f,     2.0f,     1.0f}
+    };
+    ComputeConstants();
+}
+
+// Constructor from an explicit list of waves
+WaveSet::WaveSet(const std::vector<GerstnerWave>& waves) : m_waves(waves){
+    if(size() > kMaxWaves){
+        std::cout << "WaveSet: only the first " << kMaxWaves << " waves fit in the shader\n";
+        m_waves.resize(kMaxWaves);
+    }
+    ComputeConstants();
+}
+
+// Recomputes m_constants from m_waves
+void WaveSet::ComputeConstants(){
+    m_constants.clear();
+    for(const GerstnerWave& wave : m_waves){
+        GerstnerWaveConstants constants;
+        constants.direction = wave.direction;
+        constants.waveVector = wave.direction * wave.frequency;
+        constants.amplitude = wave.amplitude;
+        constants.width = wave.steepness * wave.amplitude;
+        constants.slope = wave.amplitude * wave.frequency;
+        constants.steepSlope = wave.steepness * wave.amplitude * wave.frequency;
+        constants.speed = wave.speed;
+        constants.phaseOffset = wave.phase;
+        constants.waveNumber = glm::length(constants.waveVector);
+        m_constants.push_back(constants);
+    }
+}
+
+// Writes the first 'activeWaves' waves at 'time' seconds as gerstner_waves texels
+void WaveSet::WriteTexels(int activeWaves, double time, std::vector<glm::vec4>& texels) const{
+    int count = std::min({activeWaves, size(), kMaxWaves});
+    // Same layout as the texelFetch()es in gerstner_tese.glsl
+    texels.resize(static_cast<size_t>(std::max(count, 0)) * kTexelsPerWave);
+    for(int i = 0; i < count; ++i){
+        const GerstnerWaveConstants& constants = m_constants[i];
+        texels[i * kTexelsPerWave + 0] = glm::vec4(constants.direction, constants.waveVector);
+        texels[i * kTexelsPerWave + 1] = glm::vec4(constants.amplitude, constants.width, constants.slope, constants.steepSlope);
+        texels[i * kTexelsPerWave + 2] = glm::vec4(Phase(i, time), constants.waveNumber, 0.0f, 0.0f);
+    }
+}
+
+// Uploads num_of_waves to 'program' and 'texels' into 'buffer'
+void WaveSet::Upload(GLuint program, GLuint buffer, const std::vector<glm::vec4>& texels){
+    GLsizei count = static_cast<GLsizei>(std::min<size_t>(texels.size() / kTexelsPerWave, kMaxWaves));
+    GLint u_GerstnerWavesLengthLocation = glGetUniformLocation(program, "num_of_waves");
+    if(u_GerstnerWavesLengthLocation>=0){
+        glUniform1ui(u_GerstnerWavesLengthLocation, count);
+    }else{
+        std::cout << "Could not find num_of_waves, maybe a mispelling?\n";
+        exit(EXIT_FAILURE);
+    }
+
+    // Orphaned, so this frame does not wait for the GPU to finish with the last one
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, kMaxWaves * kTexelsPerWave * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    if(count > 0){
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, count * kTexelsPerWave * sizeof(glm::vec4), texels.data());
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Phase of wave 'wave' at 'time', wrapped to [0, 2pi) in double
+float WaveSet::Phase(int wave, double time) const{
+    const double twoPi = 6.283185307179586;
+    double phase = std::fmod(time * m_constants[wave].speed + m_constants[wave].phaseOffset, twoPi);
+    if(phase < 0.0){
+        phase += twoPi;
+    }
+    return static_cast<float>(phase);
+}
+
+// Position as gerstner_wave() in gerstner_tese.glsl, and the normal at the start point
+glm::vec3 WaveSet::Evaluate(const glm::vec2& position, double time, int activeWaves, glm::vec3& normal) const{
+    glm::vec3 wavePosition(position.x, 0.0f, position.y);
+    normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    int count = std::min(activeWaves, size());
+
+    for(int i = 0; i < count; ++i){
+        const GerstnerWaveConstants& wave = m_constants[i];
+        float theta = glm::dot(position, wave.waveVector) + Phase(i, time);
+        float s = std::sin(theta), c = std::cos(theta);
+
+        wavePosition.y += wave.amplitude * s;
+        wavePosition.x += wave.direction.x * (wave.width * c);
+        wavePosition.z += wave.direction.y * (wave.width * c);
+
+        normal.y -= wave.steepSlope * s;
+        normal.x -= wave.direction.x * (wave.slope * c);
+        normal.z -= wave.direction.y * (wave.slope * c);
+    }
+
+    return wavePosition;
+}
+
+// Same as the normal loop of gerstner_wave() in gerstner_tese.glsl
+glm::vec3 WaveSet::ShadingNormal(const glm::vec2& position, double time, int activeWaves) const{
+    glm::vec3 normal(0.0f, 1.0f, 0.0f);
+    int count = std::min(activeWaves, size());
+
+    for(int i = 0; i < count; ++i){
+        const GerstnerWaveConstants& wave = m_constants[i];
+        float theta = glm::dot(position, wave.waveVector) + Phase(i, time);
+        float s = std::sin(theta), c = std::cos(theta);
+
+        normal.y -= wave.steepSlope * s;
+        normal.x -= wave.direction.x * (wave.slope * c);
+        normal.z -= wave.direction.y * (wave.slope * c);
+    }
+
+    return normal;
+}
+
+// Same as the old gerstner_wave_position() in gerstner_tese.glsl
+glm::vec3 WaveSet::EvaluateLegacyPosition(const glm::vec2& position, float time, int activeWaves) const{
+    glm::vec3 wavePosition(position.x, 0.0f, position.y);
+    int count = std::min(activeWaves, size());
+
+    for(int i = 0; i < count; ++i){
+        const GerstnerWave& wave = m_waves[i];
+        float theta = glm::dot(position, wave.direction) * wave.frequency + time * wave.speed + wave.phase;
+        float width = wave.steepness * wave.amplitude * std::cos(theta);
+
+        wavePosition.y += wave.amplitude * std::sin(theta);
+        wavePosition.x += wave.direction.x * width;
+        wavePosition.z += wave.direction.y * width;
+    }
+
+    return wavePosition;
+}
+
+// Same as the old gerstner_wave_normal() in gerstner_tese.glsl
+glm::vec3 WaveSet::EvaluateLegacyNormal(const glm::vec3& position, float time, int activeWaves) const{
+    glm::vec3 waveNormal(0.0f, 1.0f, 0.0f);
+    int count = std::min(activeWaves, size());
+
+    for(int i = 0; i < count; ++i){
+        const GerstnerWave& wave = m_waves[i];
+        float psi = glm::dot(glm::vec2(position.x, position.z), wave.direction) * wave.frequency + time * wave.speed + wave.phase;
+        float alpha = wave.amplitude * wave.frequency * std::sin(psi);
+        float omega = wave.amplitude * wave.frequency * std::cos(psi);
+
+        waveNormal.y -= wave.steepness * alpha;
+        waveNormal.x -= wave.direction.x * omega;
+        waveNormal.z -= wave.direction.y * omega;
+    }
+
+    return waveNormal;
+}
+
+// Returns a copy that tiles every 'tileSize'
+WaveSet WaveSet::MakeTileable(float tileSize) const{
+    const float twoPi = 6.28318530718f;
+    const float latticeStep = twoPi / tileSize;
+
+    std::vector<GerstnerWave> tileable = m_waves;
+    for(GerstnerWave& wave : tileable){
+        // Snap the wave vector (direction * frequency) onto the tile lattice,
+        // the direction stays a unit vector and the frequency takes the length
+        glm::vec2 waveVector = wave.direction * wave.frequency;
+        waveVector = glm::round(waveVector / latticeStep) * latticeStep;
+        if(glm::length(waveVector) < latticeStep){
+            waveVector = glm::vec2(latticeStep, 0.0f);
+        }
+        wave.frequency = glm::length(waveVector);
+        wave.direction = waveVector / wave.frequency;
+    }
+
+    return WaveSet(tileable);
+}
+
+// Returns a copy that tiles every 'tileSize' and loops every 'period' seconds
+WaveSet WaveSet::MakePeriodic(float tileSize, float period) const{
+    const float twoPi = 6.28318530718f;
+    const float speedStep = twoPi / period;
+
+    std::vector<GerstnerWave> periodic = MakeTileable(tileSize).waves();
+    for(GerstnerWave& wave : periodic){
+        // Whole number of phase cycles per loop
+        wave.speed = std::max(1.0f, std::round(wave.speed / speedStep)) * speedStep;
+    }
+
+    return WaveSet(periodic);
+}
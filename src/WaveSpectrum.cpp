@@ -0,0 +1,106 @@
+#include "WaveSpectrum.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace{
+const float kPi = 3.14159265f;
+const float kGravity = 9.81f;
+// Fully developed sea: Phillips constant and peak frequency * wind speed / g
+const float kFullyDevelopedAlpha = 8.1e-3f;
+const float kFullyDevelopedPeak = 0.855f;
+// The band starts this far below the peak, where the spectrum is about gone
+const float kLowestFrequency = 0.5f;
+}
+
+// Constructor works out the peak and scale of the spectrum
+WaveSpectrum::WaveSpectrum(const SeaStateSettings& settings) : m_settings(settings){
+    float U = std::max(0.1f, m_settings.windSpeed);
+    m_alpha = kFullyDevelopedAlpha;
+    m_peakFrequency = kFullyDevelopedPeak * kGravity / U;
+    m_gamma = 1.0f;
+    if(m_settings.spectrum == WindSeaSpectrum::JONSWAP){
+        // Same fit as FFTOcean, a long fetch ends at the fully developed sea
+        float F = std::max(1.0f, m_settings.fetch);
+        m_alpha = std::max(m_alpha, 0.076f * std::pow(U * U / (F * kGravity), 0.22f));
+        m_peakFrequency = std::max(m_peakFrequency, 22.0f * std::pow(kGravity * kGravity / (U * F), 1.0f / 3.0f));
+        m_gamma = 3.3f;
+    }
+}
+
+// Spectral density in m^2 s at angular frequency 'omega'
+float WaveSpectrum::Density(float omega) const{
+    if(omega <= 0.0f){
+        return 0.0f;
+    }
+    float ratio = m_peakFrequency / omega;
+    float density = m_alpha * kGravity * kGravity / std::pow(omega, 5.0f) * std::exp(-1.25f * ratio * ratio * ratio * ratio);
+    if(m_gamma != 1.0f){
+        float sigma = (omega <= m_peakFrequency) ? 0.07f : 0.09f;
+        float offset = (omega - m_peakFrequency) / (sigma * m_peakFrequency);
+        density *= std::pow(m_gamma, std::exp(-0.5f * offset * offset));
+    }
+    return density;
+}
+
+// Significant wave height of the whole spectrum
+float WaveSpectrum::SignificantWaveHeight() const{
+    // Trapezoids on a log scale from well below to well above the peak
+    const int steps = 4096;
+    const float low = 0.2f * m_peakFrequency, high = 50.0f * m_peakFrequency;
+    const float step = std::log(high / low) / steps;
+    double variance = 0.0;
+    for(int i = 0; i < steps; ++i){
+        float a = low * std::exp(step * i), b = low * std::exp(step * (i + 1));
+        variance += 0.5 * (Density(a) + Density(b)) * (b - a);
+    }
+    return 4.0f * static_cast<float>(std::sqrt(variance));
+}
+
+// Samples settings.waveCount waves, longest first
+std::vector<GerstnerWave> WaveSpectrum::Generate() const{
+    const int count = std::max(0, m_settings.waveCount);
+    std::vector<GerstnerWave> waves(count);
+    std::mt19937 generator(m_settings.seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Deep water: omega^2 = g k
+    const float low = kLowestFrequency * m_peakFrequency;
+    const float high = std::max(2.0f * low, std::sqrt(kGravity * 2.0f * kPi / std::max(1e-3f, m_settings.minWavelength)));
+    const float binRatio = std::log(high / low) / std::max(1, count);
+    glm::vec2 wind = glm::length(m_settings.windDirection) > 0.0f ? glm::normalize(m_settings.windDirection) : glm::vec2(1.0f, 0.0f);
+
+    float slopeSum = 0.0f;
+    for(int i = 0; i < count; ++i){
+        float lower = low * std::exp(binRatio * i);
+        float upper = lower * std::exp(binRatio);
+        float omega = lower * std::exp(binRatio * unit(generator));
+        float waveNumber = omega * omega / kGravity;
+
+        // cos^2 spread around the wind, by rejection
+        float angle;
+        do{
+            angle = (unit(generator) - 0.5f) * kPi;
+        }while(unit(generator) > std::cos(angle) * std::cos(angle));
+        glm::vec2 travel(wind.x * std::cos(angle) - wind.y * std::sin(angle),
+                         wind.x * std::sin(angle) + wind.y * std::cos(angle));
+
+        GerstnerWave& wave = waves[i];
+        // theta = k.x + speed * time, so crests travel against 'direction'
+        wave.direction = -travel;
+        wave.amplitude = std::sqrt(2.0f * Density(omega) * (upper - lower));
+        wave.frequency = waveNumber;
+        wave.speed = omega;
+        wave.phase = unit(generator) * 2.0f * kPi;
+        slopeSum += wave.amplitude * waveNumber;
+    }
+
+    // One steepness for all, so no point of the surface folds over
+    float choppiness = glm::clamp(m_settings.choppiness, 0.0f, 1.0f);
+    float steepness = slopeSum > 0.0f ? std::min(1.0f, choppiness / slopeSum) : 0.0f;
+    for(GerstnerWave& wave : waves){
+        wave.steepness = steepness;
+    }
+    return waves;
+}
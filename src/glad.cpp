@@ -248,6 +248,8 @@ int GLAD_GL_VERSION_3_1;
 int GLAD_GL_VERSION_3_2;
 int GLAD_GL_VERSION_3_3;
 int GLAD_GL_VERSION_4_0;
+int GLAD_GL_ARB_buffer_storage;
+int GLAD_GL_ARB_pipeline_statistics_query;
 PFNGLCOPYTEXIMAGE1DPROC glad_glCopyTexImage1D;
 PFNGLVERTEXATTRIBI3UIPROC glad_glVertexAttribI3ui;
 PFNGLWINDOWPOS2SPROC glad_glWindowPos2s;
@@ -973,6 +975,7 @@ PFNGLFRONTFACEPROC glad_glFrontFace;
 PFNGLGETBOOLEANI_VPROC glad_glGetBooleani_v;
 PFNGLCLEARBUFFERUIVPROC glad_glClearBufferuiv;
 PFNGLPATCHPARAMETERIPROC glad_glPatchParameteri;
+PFNGLBUFFERSTORAGEPROC glad_glBufferStorage;
 static void load_GL_VERSION_1_0(GLADloadproc load) {
 	if(!GLAD_GL_VERSION_1_0) return;
 	glad_glCullFace = (PFNGLCULLFACEPROC)load("glCullFace");
@@ -1740,9 +1743,14 @@ static void load_GL_VERSION_4_0(GLADloadproc load) {
 	if(!GLAD_GL_VERSION_4_0) return;
 	glad_glPatchParameteri = (PFNGLPATCHPARAMETERIPROC)load("glPatchParameteri");
 }
+static void load_GL_ARB_buffer_storage(GLADloadproc load) {
+	if(!GLAD_GL_ARB_buffer_storage) return;
+	glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+}
 static int find_extensionsGL(void) {
 	if (!get_exts()) return 0;
-	(void)&has_ext;
+	GLAD_GL_ARB_buffer_storage = has_ext("GL_ARB_buffer_storage");
+	GLAD_GL_ARB_pipeline_statistics_query = has_ext("GL_ARB_pipeline_statistics_query");
 	free_exts();
 	return 1;
 }
@@ -1823,6 +1831,7 @@ int gladLoadGLLoader(GLADloadproc load) {
 	load_GL_VERSION_4_0(load);
 
 	if (!find_extensionsGL()) return 0;
+	load_GL_ARB_buffer_storage(load);
 	return GLVersion.major != 0 || GLVersion.minor != 0;
 }
 
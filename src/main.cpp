@@ -1,5 +1,5 @@
 /* Compilation on Linux: 
- g++ -std=c++17 ./src/*.cpp -o prog -I ./include/ -I./../common/thirdparty/ -lSDL2 -ldl
+ g++ -std=c++17 -O2 ./src/*.cpp -o prog -I ./include/ -I./../common/thirdparty/ -lSDL2 -ldl -pthread
 */
 
 // Third Party Libraries
@@ -15,10 +15,38 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <random>
+#include <cstdlib>
+#include <stdexcept>
 
 // Our libraries
 #include "Camera.hpp"
 #include "PPM.hpp"
+#include "FFTOcean.hpp"
+#include "WaveSet.hpp"
+#include "WaveSpectrum.hpp"
+#include "WaveLoopCache.hpp"
+#include "DetailNormalMap.hpp"
+#include "GLStateCache.hpp"
+#include "FrameGraph.hpp"
+#include "UniformRing.hpp"
+#include "GPUProfiler.hpp"
+#include "Profiler.hpp"
+#include "HeadlessContext.hpp"
+#include "SimulationClock.hpp"
+#include "FrameStats.hpp"
+#include "DynamicResolution.hpp"
+#include "QualityGovernor.hpp"
+#include "WaveEvaluator.hpp"
+#include "SurfaceQuery.hpp"
+#include "BuoyancySystem.hpp"
+#include "JobSystem.hpp"
+#include "InputTimeline.hpp"
+#include "SimulationThread.hpp"
 
 // vvvvvvvvvvvvvvvvvvvvvvvvvv Globals vvvvvvvvvvvvvvvvvvvvvvvvvv
 // Globals generally are prefixed with 'g' in this application.
@@ -37,6 +65,10 @@ bool gQuit = false; // If this is quit = 'true' then the program terminates.
 // program object that will be used for our OpenGL draw calls.
 GLuint gGraphicsPipelineShaderProgram	= 0;
 GLuint gSkyboxPipelineShaderProgram     = 0;
+GLuint gFFTPipelineShaderProgram        = 0;
+GLuint gLoopPipelineShaderProgram       = 0;
+GLuint gUpscalePipelineShaderProgram    = 0;
+GLuint gBodyPipelineShaderProgram       = 0;
 
 // OpenGL Objects
 // Vertex Array Object (VAO)
@@ -46,16 +78,33 @@ GLuint gSkyboxPipelineShaderProgram     = 0;
 // correct layout and correct buffers with one call after being setup.
 GLuint gVertexArrayObjectFloor= 0;
 GLuint gVertexArrayObjectSkybox = 0;
+// Empty, the upscale pass makes its triangle from gl_VertexID
+GLuint gVertexArrayObjectFullscreen = 0;
+// Skybox cube plus one instance per floating body
+GLuint gVertexArrayObjectBodies = 0;
 // Vertex Buffer Object (VBO)
 // Vertex Buffer Objects store information relating to vertices (e.g. positions, normals, textures)
 // VBOs are our mechanism for arranging geometry on the GPU.
 GLuint  gVertexBufferObjectFloor            = 0;
 GLuint  gVertexBufferObjectSkybox           = 0;
+// Position, orientation and half extents of every floating body
+GLuint  gVertexBufferObjectBodyInstances    = 0;
 
 // Water texture
 GLuint gTexId                    = 0;
 // Cubemap texture
 GLuint gCubeTexId                = 0;
+// FFT ocean displacement and normal maps
+GLuint gFFTDisplacementTexId     = 0;
+GLuint gFFTNormalTexId           = 0;
+// Baked wave loop displacement and normals (3D textures)
+GLuint gLoopDisplacementTexId    = 0;
+GLuint gLoopNormalTexId          = 0;
+// Normal map of the gerstner waves too short for the mesh
+GLuint gDetailNormalTexId        = 0;
+// Per wave constants of the gerstner waves, a texture buffer over gWaveBufferObject
+GLuint gWaveBufferObject         = 0;
+GLuint gWaveTexId                = 0;
 
 // Camera
 Camera gCamera;
@@ -67,6 +116,100 @@ size_t gFloorTriangles  = 0;
 float gOceanSize = 1500.0f;
 // Number of gerstner waves
 int num_of_waves = 1;
+// The gerstner waves themselves
+WaveSet gWaveSet;
+// Sea state the waves are sampled from when any of the --wind-speed style
+// options is given, the hand picked WaveSet otherwise
+SeaStateSettings gSeaState;
+bool gUseSeaState = false;
+// Run the wave spectrum timings and checks instead of the application
+bool gRunSpectrumBenchmark = false;
+// The ocean quad is split into gPatchGrid x gPatchGrid patches so that
+// gerstner_tesc.glsl can band limit the waves per patch, each one is
+// tessellated gTessLevel times per side. 8 x 8 keeps the vertices of the old
+// single patch at level 100, which GL clamps to GL_MAX_TESS_GEN_LEVEL (64).
+const int gPatchGrid = 8;
+float gTessLevel = 8.0f;
+// With --detail-map the gerstner ocean leaves its short waves to a detail
+// normal map and only needs enough vertices for the long swells. Off by
+// default: the four default waves are all shorter than the vertex spacing,
+// so the map would take every one of them and leave the mesh flat.
+bool gUseDetailMap = false;
+float gDetailTessLevel = 2.0f;
+DetailNormalSettings gDetailNormalSettings;
+DetailNormalMap* gDetailNormalMap = nullptr;
+
+// How the ocean surface is generated
+enum class OceanMode{
+    Gerstner,   // Sum of gerstner waves evaluated in the TES
+    FFT,        // CPU FFT ocean sampled from displacement/normal maps
+    Loop        // Gerstner waves baked into a looping 3D texture
+};
+OceanMode gOceanMode = OceanMode::Gerstner;
+// CPU FFT ocean, created once the command line has been read
+FFTOceanSettings gFFTOceanSettings;
+FFTOcean* gFFTOcean = nullptr;
+// Run the FFT timings instead of the application
+bool gRunFFTBenchmark = false;
+// Check the fused gerstner evaluator against the old one instead of running the application
+bool gVerifyWaves = false;
+// Run the CPU wave evaluator timings instead of the application
+bool gRunWaveBenchmark = false;
+// Run the surface height query timings and checks instead of the application
+bool gRunSurfaceQueryBenchmark = false;
+SurfaceQuerySettings gSurfaceQuerySettings;
+// --bodies, boxes floating on the gerstner waves, none by default
+int gBodyCount = 0;
+BuoyancySettings gBuoyancySettings;
+BuoyancySystem* gBuoyancySystem = nullptr;
+// Waves and mesh cutoff the bodies float on, to notice when the number keys,
+// the tessellation or the quality governor change them
+int gBodyWaveCount = 0;
+float gBodyWaveNumber = 0.0f;
+// Run the buoyancy timings instead of the application
+bool gRunBuoyancyBenchmark = false;
+// Clock all ocean modes animate with, ticked once per simulation step
+SimulationClock gSimulationClock;
+// --sim-thread off steps the simulation on the render thread, between its GL calls
+bool gUseSimulationThread = true;
+// Steps the clock, the waves, the FFT ocean, the detail map and the bodies one
+// frame ahead of the GL calls, see SimulationStep
+SimulationThread* gSimulation = nullptr;
+// Camera movement in units per second
+float gCameraSpeed = 6.0f;
+// When each key went down and up, the camera moves by how long its keys were held
+InputTimeline gInputTimeline;
+// --input-rate, times per second events are pumped while the frame waits, so
+// they are timestamped close to when they happened
+double gInputRate = 500.0;
+// --vsync, swap interval: 0 off, 1 on, -1 adaptive (swaps late frames right away instead of waiting)
+int gSwapInterval = 1;
+// --fps-cap, frames per second the loop sleeps down to, 0 for no cap
+double gFrameRateCap = 0.0;
+// Time between consecutive frames, printed on exit and with the h key
+FrameStats gFrameStats;
+// --dynamic-resolution draws the ocean and skybox into gSceneTarget at a scale
+// that follows their GPU time, and upscales and sharpens it into the window
+bool gUseDynamicResolution = false;
+DynamicResolutionSettings gDynamicResolutionSettings;
+DynamicResolution* gDynamicResolution = nullptr;
+RenderTargetHandle gSceneTarget = FrameGraph::kBackbuffer;
+// --sharpness of the upscale, 0 to 1
+float gSharpness = 0.5f;
+// --quality-governor lowers tessellation, wave count and render scale while
+// frames cost more than the budget, and raises them again when there is room
+bool gUseQualityGovernor = false;
+QualityGovernorSettings gQualityGovernorSettings;
+QualityGovernor* gQualityGovernor = nullptr;
+// Run the long uptime precision test instead of the application
+bool gRunSoakTest = false;
+// Run the hitch counting check of FrameStats instead of the application
+bool gVerifyFrameStats = false;
+// Run the replay check of InputTimeline instead of the application
+bool gVerifyInput = false;
+// Baked loop of the gerstner waves, rebuilt when the wave count changes
+WaveLoopSettings gWaveLoopSettings;
+WaveLoopCache* gWaveLoopCache = nullptr;
 
 // Chosen environment
 int chosenEnvironment = 0;
@@ -75,6 +218,48 @@ std::vector<std::vector<std::string>> cubemapFaces;
 // Polygon Mode
 GLenum gPolygonMode = GL_FILL;
 
+// Every per frame state change goes through here so repeated calls are dropped
+GLStateCache gGLState;
+// Passes of a frame, the graph owns clears, viewport and depth state
+FrameGraph* gFrameGraph = nullptr;
+
+// Mirrors the std140 FrameUniforms block declared by the shaders
+struct FrameUniforms{
+    glm::mat4 model;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 skyboxView;
+    glm::vec3 cameraPos;
+    float pixelAngle;
+    float detailWaveNumber;
+    float padding[3];
+};
+// Every program reads FrameUniforms from this binding point
+const GLuint gFrameUniformsBinding = 0;
+// Triple buffered slots for FrameUniforms, written once per frame
+UniformRing* gFrameUniformRing = nullptr;
+// The frame uniform ring is mapped persistently where buffer storage exists,
+// --no-persistent-map maps one slot per frame instead
+bool gPersistentMapping = true;
+// --gpu-profile times every frame graph pass with timer queries
+bool gGPUProfile = false;
+// --gpu-profile-csv also writes each pass time to this file
+std::string gGPUProfileCsv;
+GPUProfiler* gGPUProfiler = nullptr;
+// --trace writes the CPU zones of the session to this file as a Chrome trace
+std::string gTraceFile;
+// --job-threads, JobSystem worker threads, 0 picks one less than the cores
+int gJobThreads = 0;
+// --headless renders into an offscreen framebuffer, without a window or display server
+bool gHeadless = false;
+HeadlessContext* gHeadlessContext = nullptr;
+// --frames, number of frames a headless run draws before it exits
+int gHeadlessFrames = 60;
+// --capture, frames (counted from 1) saved as PPM, only the last one when empty
+std::vector<int> gCaptureFrames;
+// --capture-prefix, captures are written to <prefix>_<frame>.ppm
+std::string gCapturePrefix = "frame";
+
 // ^^^^^^^^^^^^^^^^^^^^^^^^ Globals ^^^^^^^^^^^^^^^^^^^^^^^^^^^
 
 
@@ -127,6 +312,22 @@ std::string LoadShaderAsString(const std::string& filename){
     return result;
 }
 
+/**
+* Inserts '#define name' right after the #version line of a shader, so one
+* file can be compiled with and without an optional feature.
+*
+* @param source Shader source from LoadShaderAsString
+* @param name Macro to define
+* @return the source with the macro defined
+*/
+std::string DefineInShader(const std::string& source, const std::string& name){
+    size_t versionEnd = source.find('\n');
+    if(versionEnd == std::string::npos){
+        return source;
+    }
+    return source.substr(0, versionEnd + 1) + "#define " + name + "\n" + source.substr(versionEnd + 1);
+}
+
 
 /**
 * CompileShader will compile any valid vertex, fragment, geometry, tesselation, or compute shader.
@@ -280,25 +481,91 @@ GLuint CreateShaderProgram(const std::string& vertexShaderSource, const std::str
 }
 
 
+/**
+* Points the FrameUniforms block of 'program' at gFrameUniformsBinding and
+* checks that the block laid out by the compiler fits the FrameUniforms struct
+*
+* @param program Linked shader program
+* @return void
+*/
+void BindFrameUniformBlock(GLuint program){
+    GLuint frameUniformsIndex = glGetUniformBlockIndex(program,"FrameUniforms");
+    if(frameUniformsIndex != GL_INVALID_INDEX){
+        glUniformBlockBinding(program,frameUniformsIndex,gFrameUniformsBinding);
+    }else{
+        std::cout << "Could not find FrameUniforms, maybe a mispelling?\n";
+        exit(EXIT_FAILURE);
+    }
+
+    GLint blockSize = 0;
+    glGetActiveUniformBlockiv(program,frameUniformsIndex,GL_UNIFORM_BLOCK_DATA_SIZE,&blockSize);
+    if(blockSize > static_cast<GLint>(sizeof(FrameUniforms))){
+        std::cout << "FrameUniforms is " << blockSize << " bytes in the shaders but "
+                  << sizeof(FrameUniforms) << " on the CPU\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
 /**
 * Create the graphics pipeline
 *
 * @return void
 */
 void CreateGraphicsPipeline(){
+    PROFILE_ZONE("CreateGraphicsPipeline");
 
     std::string vertexShaderSource      = LoadShaderAsString("./shaders/vert.glsl");
     std::string fragmentShaderSource    = LoadShaderAsString("./shaders/frag.glsl");
     std::string tessControlShaderSource = LoadShaderAsString("./shaders/gerstner_tesc.glsl");
     std::string tessEvalShaderSource    = LoadShaderAsString("./shaders/gerstner_tese.glsl");
 
-	gGraphicsPipelineShaderProgram = CreateShaderProgramWithTessellation(vertexShaderSource,fragmentShaderSource,
+    // The detail normal map is compiled into the gerstner ocean only when it is used
+    std::string gerstnerFragmentShaderSource = gUseDetailMap ? DefineInShader(fragmentShaderSource, "DETAIL_MAP")
+                                                             : fragmentShaderSource;
+
+	gGraphicsPipelineShaderProgram = CreateShaderProgramWithTessellation(vertexShaderSource,gerstnerFragmentShaderSource,
                                                                          tessControlShaderSource, tessEvalShaderSource);
     
     std::string skyboxVertexShaderSource      = LoadShaderAsString("./shaders/skybox_vert.glsl");
     std::string skyboxFragmentShaderSource    = LoadShaderAsString("./shaders/skybox_frag.glsl");
 
     gSkyboxPipelineShaderProgram = CreateShaderProgram(skyboxVertexShaderSource, skyboxFragmentShaderSource);
+
+    // The FFT ocean shares the vertex and control stages with the gerstner pipeline
+    std::string fftFragmentShaderSource = LoadShaderAsString("./shaders/fft_frag.glsl");
+    std::string fftTessEvalShaderSource = LoadShaderAsString("./shaders/fft_tese.glsl");
+
+    gFFTPipelineShaderProgram = CreateShaderProgramWithTessellation(vertexShaderSource, fftFragmentShaderSource,
+                                                                    tessControlShaderSource, fftTessEvalShaderSource);
+
+    // The baked loop only swaps the evaluation stage
+    std::string loopTessEvalShaderSource = LoadShaderAsString("./shaders/loop_tese.glsl");
+
+    gLoopPipelineShaderProgram = CreateShaderProgramWithTessellation(vertexShaderSource, fragmentShaderSource,
+                                                                     tessControlShaderSource, loopTessEvalShaderSource);
+
+    // Upscales the dynamic resolution scene into the window
+    std::string upscaleVertexShaderSource   = LoadShaderAsString("./shaders/upscale_vert.glsl");
+    std::string upscaleFragmentShaderSource = LoadShaderAsString("./shaders/upscale_frag.glsl");
+
+    gUpscalePipelineShaderProgram = CreateShaderProgram(upscaleVertexShaderSource, upscaleFragmentShaderSource);
+    glGenVertexArrays(1, &gVertexArrayObjectFullscreen);
+
+    // Floating bodies, one instanced draw
+    std::string bodyVertexShaderSource   = LoadShaderAsString("./shaders/body_vert.glsl");
+    std::string bodyFragmentShaderSource = LoadShaderAsString("./shaders/body_frag.glsl");
+
+    gBodyPipelineShaderProgram = CreateShaderProgram(bodyVertexShaderSource, bodyFragmentShaderSource);
+
+    // View, projection and camera data reach every program through one buffer
+    GLuint programs[] = {gGraphicsPipelineShaderProgram, gSkyboxPipelineShaderProgram,
+                         gFFTPipelineShaderProgram, gLoopPipelineShaderProgram, gBodyPipelineShaderProgram};
+    for(GLuint program : programs){
+        BindFrameUniformBlock(program);
+    }
+    gFrameUniformRing = new UniformRing(sizeof(FrameUniforms), 3, gPersistentMapping);
+    std::cout << "Frame uniforms: " << (gFrameUniformRing->isPersistent() ? "persistently mapped ring"
+                                                                         : "ring mapped one slot per frame") << "\n";
 }
 
 
@@ -309,6 +576,7 @@ void CreateGraphicsPipeline(){
 * @return void
 */
 void InitializeProgram(){
+    PROFILE_ZONE("InitializeProgram");
 	// Initialize SDL
 	if(SDL_Init(SDL_INIT_VIDEO)< 0){
 		std::cout << "SDL could not initialize! SDL Error: " << SDL_GetError() << "\n";
@@ -350,18 +618,43 @@ void InitializeProgram(){
 		std::cout << "glad did not initialize" << std::endl;
 		exit(1);
 	}
+
+	// Adaptive vsync needs EXT_swap_control_tear, fall back to plain vsync without it
+	if(SDL_GL_SetSwapInterval(gSwapInterval) != 0 && gSwapInterval == -1){
+		std::cout << "Adaptive vsync is not supported, using vsync\n";
+		gSwapInterval = 1;
+		SDL_GL_SetSwapInterval(gSwapInterval);
+	}
 	
 }
 
 void loadCubemap(std::vector<std::string> faces)
 {
+    PROFILE_ZONE("loadCubemap");
+    // Decoding the text PPMs is most of the load, one job per face. Only the
+    // uploads below need the context.
+    std::vector<PPM> facePPMs(faces.size());
+    JobSystem::ParallelFor(faces.size(), 1, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i){
+            PROFILE_ZONE("DecodePPM");
+            facePPMs[i] = PPM(faces[i].c_str());
+        }
+    });
+
+    // Replaces the previous environment. Unbound through the cache first, so
+    // the cache does not keep the old name bound if GL hands it out again.
+    if(gCubeTexId != 0){
+        gGLState.BindTexture(0, GL_TEXTURE_CUBE_MAP, 0);
+        glDeleteTextures(1, &gCubeTexId);
+    }
     glGenTextures(1, &gCubeTexId);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, gCubeTexId);
+    // Unit 0, where the skybox and the ocean sample it
+    gGLState.BindTexture(0, GL_TEXTURE_CUBE_MAP, gCubeTexId);
 
     int width, height;
     for (unsigned int i = 0; i < faces.size(); i++)
     {
-        PPM skyboxPPM = PPM(faces[i].c_str());
+        const PPM& skyboxPPM = facePPMs[i];
         //skyboxPPM.flipPPM();
         std::vector<uint8_t> skyboxPixelData = skyboxPPM.pixelData();
         height = skyboxPPM.getHeight();
@@ -385,175 +678,1408 @@ void loadCubemap(std::vector<std::string> faces)
 }
 
 /**
-* Setup your geometry during the vertex specification step
+* Creates the FFT ocean and the textures its displacement and normal maps are
+* uploaded to every frame.
 *
 * @return void
 */
+void FFTOceanSpecification(){
+    PROFILE_ZONE("FFTOceanSpecification");
+    gFFTOcean = new FFTOcean(gFFTOceanSettings);
+    int resolution = gFFTOcean->getResolution();
+
+    GLuint* textures[] = {&gFFTDisplacementTexId, &gFFTNormalTexId};
+    for(GLuint* texture : textures){
+        glGenTextures(1, texture);
+        glBindTexture(GL_TEXTURE_2D, *texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, resolution, resolution, 0, GL_RGB, GL_FLOAT, nullptr);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        // Maps tile across the whole ocean
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 /**
-* Setup your geometry during the vertex specification step
+* Initialization of the headless mode. Creates a surfaceless context and the
+* gScreenWidth x gScreenHeight framebuffer the frames are drawn into, no
+* window or display server is needed.
 *
 * @return void
 */
-void VertexSpecification(){
+void InitializeHeadless(){
+    PROFILE_ZONE("InitializeHeadless");
+    gHeadlessContext = new HeadlessContext();
+    if(!gHeadlessContext->CreateContext()){
+        std::cout << "Headless context could not be created: " << gHeadlessContext->getError() << "\n";
+        exit(1);
+    }
 
-	// Vertex Arrays Object (VAO) Setup
-	glGenVertexArrays(1, &gVertexArrayObjectFloor);
-	// We bind (i.e. select) to the Vertex Array Object (VAO) that we want to work withn.
-	glBindVertexArray(gVertexArrayObjectFloor);
-	// Vertex Buffer Object (VBO) creation
-	glGenBuffers(1, &gVertexBufferObjectFloor);
+    // Initialize GLAD Library
+    if(!gladLoadGLLoader(HeadlessContext::GetProcAddress)){
+        std::cout << "glad did not initialize" << std::endl;
+        exit(1);
+    }
 
-    // Generate our data for the buffer
-    //GeneratePlaneBufferData();
-    std::vector<GLfloat> vertexDataQuad
-    {
-        -gOceanSize, 0.0, -gOceanSize,     // Bottom-left vertex of quad
-        0.0, 1.0, 0.0,         // normal
-        gOceanSize, 0.0, -gOceanSize,      // Bottom-right vertex
-        0.0, 1.0, 0.0,         // normal
-        gOceanSize, 0.0, gOceanSize,       // Top-right vertex
-        0.0, 1.0, 0.0,         // normal
-        -gOceanSize, 0.0, gOceanSize,      // Top-left vertex
-        0.0, 1.0, 0.0          // normal
-    };
+    if(!gHeadlessContext->CreateFramebuffer(gScreenWidth, gScreenHeight)){
+        std::cout << "Headless framebuffer could not be created: " << gHeadlessContext->getError() << "\n";
+        exit(1);
+    }
+    glViewport(0, 0, gScreenWidth, gScreenHeight);
+    std::cout << "Headless: " << glGetString(GL_RENDERER) << ", " << gScreenWidth << "x" << gScreenHeight << "\n";
+}
 
-    gFloorTriangles = vertexDataQuad.size();
+/**
+* Creates the detail normal map and its texture.
+*
+* @return void
+*/
+void DetailNormalMapSpecification(){
+    PROFILE_ZONE("DetailNormalMapSpecification");
+    gDetailNormalMap = new DetailNormalMap(gWaveSet, gDetailNormalSettings);
+    int resolution = gDetailNormalMap->getResolution();
+
+    glGenTextures(1, &gDetailNormalTexId);
+    glBindTexture(GL_TEXTURE_2D, gDetailNormalTexId);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, resolution, resolution, 0, GL_RGB, GL_FLOAT, nullptr);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    // Mips average the short waves away in the distance, which is what they look like there
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObjectFloor);
-	glBufferData(GL_ARRAY_BUFFER, // Kind of buffer we are working with  
-                                  // (e.g. GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER)
-							 vertexDataQuad.size() * sizeof(GL_FLOAT), 	// Size of data in bytes
-							 vertexDataQuad.data(), 						// Raw array of data
-							 GL_STATIC_DRAW);	
- 
-    // =============================
-    // offsets every 3 floats
-    // v     v
-    // 
-    // x,y,z,nx,ny,nz
-    //
-    // |------------------| strides is '6' floats
-    //
-    // ============================
-    // Position information (x,y,z)
-	glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,sizeof(GL_FLOAT)*6,(GLvoid*)0);
-    // Normal information (nx,ny,nz)
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,sizeof(GL_FLOAT)*6, (GLvoid*)(sizeof(GL_FLOAT)*3));
+/**
+* Creates the texture buffer the gerstner waves are uploaded to every frame,
+* large enough for WaveSet::kMaxWaves.
+*
+* @return void
+*/
+void WaveBufferSpecification(){
+    glGenBuffers(1, &gWaveBufferObject);
+    glBindBuffer(GL_TEXTURE_BUFFER, gWaveBufferObject);
+    glBufferData(GL_TEXTURE_BUFFER, WaveSet::kMaxWaves * WaveSet::kTexelsPerWave * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &gWaveTexId);
+    glBindTexture(GL_TEXTURE_BUFFER, gWaveTexId);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, gWaveBufferObject);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
 
-	// Unbind our currently bound Vertex Array Object
-	glBindVertexArray(0);
-	// Disable any attributes we opened in our Vertex Attribute Arrray,
-	// as we do not want to leave them open. 
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
+/**
+* Tessellation level of the gerstner ocean, lower when the detail map draws the short waves.
+*
+* @return tessellation level per patch side
+*/
+float GerstnerTessLevel(){
+    float tessLevel = gUseDetailMap ? gDetailTessLevel : gTessLevel;
+    if(gQualityGovernor != nullptr){
+        tessLevel = std::max(1.0f, tessLevel * gQualityGovernor->getLevel().tessScale);
+    }
+    return tessLevel;
+}
 
-    // // Texture data setup
-    // // Generate Texture object
-    // glGenTextures(1, &gTexId);
-    // // Bind it to GL_TEXTURE_2D
-    // glBindTexture(GL_TEXTURE_2D, gTexId);
-    // // Populate Texture data
-    // std::string fileName = "./water.ppm";
-    // PPM texturePPM = PPM(fileName);
-    // //texturePPM.flipPPM();
-    // std::vector<uint8_t> texturePixelData = texturePPM.pixelData();
-    // int height = texturePPM.getHeight();
-    // int width = texturePPM.getWidth();
-    // glTexImage2D(
-    //     GL_TEXTURE_2D,          // 2D Texture
-    //     0,                      // Mipmap level 0(highest resolution)
-    //     GL_RGB,                 // Internal format
-    //     width,                  // Image width
-    //     height,                 // Image height
-    //     0,                      // Border(must be 0)
-    //     GL_RGB,                 // Image format
-    //     GL_UNSIGNED_BYTE,       // Data type of each pixel
-    //     texturePixelData.data() // Raw texture pixel data
-    // );
-    // // Generate mipmaps for our texture
-    // glGenerateMipmap(GL_TEXTURE_2D);
-    // // Parameters for minification, magnification, wrap on s and t using bilinear filtering
-    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+/**
+* Tessellation level of the FFT and baked loop oceans.
+*
+* @return tessellation level per patch side
+*/
+float OceanTessLevel(){
+    if(gQualityGovernor != nullptr){
+        return std::max(1.0f, gTessLevel * gQualityGovernor->getLevel().tessScale);
+    }
+    return gTessLevel;
+}
 
-    glGenVertexArrays(1, &gVertexArrayObjectSkybox);
-	// We bind (i.e. select) to the Vertex Array Object (VAO) that we want to work withn.
-	glBindVertexArray(gVertexArrayObjectSkybox);
+/**
+* Waves in 'quarters' quarters of the wave set, at least one. The number keys
+* and the quality governor count in quarters so they work the same for the 4
+* default waves and a sampled sea state of hundreds.
+*
+* @param quarters 1 to 4
+* @return number of waves
+*/
+int WaveQuarters(int quarters){
+    return std::max(1, gWaveSet.size() * quarters / 4);
+}
 
-    std::vector<GLfloat> vertexDataSkybox
-    {
-        // positions          
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        1.0f, -1.0f, -1.0f,
-        1.0f, -1.0f, -1.0f,
-        1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
+/**
+* Gerstner waves drawn: the ones picked with the number keys, as far as the
+* quality governor allows.
+*
+* @return number of active waves
+*/
+int ActiveWaveCount(){
+    if(gQualityGovernor != nullptr){
+        return std::min(num_of_waves, WaveQuarters(gQualityGovernor->getLevel().maxWaves));
+    }
+    return num_of_waves;
+}
 
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
+/**
+* Vertices the tessellator emits for the whole ocean at 'tessLevel', rounded
+* up to even like fractional_even_spacing. Edges shared by two patches count twice.
+*
+* @param tessLevel Tessellation level per patch side
+* @return number of tessellated vertices per frame
+*/
+size_t OceanVertexCount(float tessLevel){
+    size_t segments = 2 * static_cast<size_t>(std::ceil(tessLevel / 2.0f));
+    return static_cast<size_t>(gPatchGrid) * gPatchGrid * (segments + 1) * (segments + 1);
+}
 
-        1.0f, -1.0f, -1.0f,
-        1.0f, -1.0f,  1.0f,
-        1.0f,  1.0f,  1.0f,
-        1.0f,  1.0f,  1.0f,
-        1.0f,  1.0f, -1.0f,
-        1.0f, -1.0f, -1.0f,
+/**
+* Wave number above which gerstner waves are drawn by the detail normal map
+* instead of the mesh: waves shorter than two vertex spacings by default.
+*
+* @return wave number, effectively infinite without the detail map
+*/
+float DetailWaveNumber(){
+    if(!gUseDetailMap){
+        return 1e30f;
+    }
+    float wavelength = gDetailNormalSettings.wavelength;
+    if(wavelength <= 0.0f){
+        wavelength = 2.0f * (2.0f * gOceanSize / (gPatchGrid * GerstnerTessLevel()));
+    }
+    return 6.28318530718f / wavelength;
+}
 
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        1.0f,  1.0f,  1.0f,
-        1.0f,  1.0f,  1.0f,
-        1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
+/**
+* The gerstner waves the mesh draws: the first 'activeWaves', without the
+* ones above 'maxWaveNumber' that the detail normal map draws instead. The
+* floating bodies ride these, so they move with the water on screen.
+*
+* @param activeWaves Waves picked with the number keys
+* @param maxWaveNumber Wave number cutoff of the mesh, see DetailWaveNumber
+* @return the waves in the mesh
+*/
+WaveSet MeshWaves(int activeWaves, float maxWaveNumber){
+    std::vector<GerstnerWave> waves;
+    int count = std::min(activeWaves, gWaveSet.size());
+    for(int i = 0; i < count; ++i){
+        if(gWaveSet.constants()[i].waveNumber <= maxWaveNumber){
+            waves.push_back(gWaveSet.waves()[i]);
+        }
+    }
+    return WaveSet(waves);
+}
 
-        -1.0f,  1.0f, -1.0f,
-        1.0f,  1.0f, -1.0f,
-        1.0f,  1.0f,  1.0f,
-        1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
+/**
+* Uploads the detail normal map of a snapshot.
+*
+* @param snapshot Snapshot with a detail normal map
+* @return void
+*/
+void UploadDetailNormalMap(const FrameSnapshot& snapshot){
+    PROFILE_ZONE("UploadDetailNormalMap");
+    int resolution = gDetailNormalMap->getResolution();
+
+    // Upload on the unit it is drawn from so Draw() finds it already bound
+    gGLState.BindTexture(3, GL_TEXTURE_2D, gDetailNormalTexId);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, resolution, resolution, GL_RGB, GL_FLOAT, snapshot.detailNormals.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
 
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-        1.0f, -1.0f, -1.0f,
-        1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-        1.0f, -1.0f,  1.0f
-    };
+/**
+* Sets the detail normal map uniforms of frag.glsl built with DETAIL_MAP. 'program' must be in use.
+*
+* @param program Program built with frag.glsl and DETAIL_MAP
+* @return void
+*/
+void SetDetailUniforms(GLuint program){
+    // Texture units: 0 skybox, 1 and 2 ocean maps, 3 detail normals
+    GLint u_DetailNormalsLocation = glGetUniformLocation(program,"u_DetailNormals");
+    if(u_DetailNormalsLocation>=0){
+        glUniform1i(u_DetailNormalsLocation,3);
+    }else{
+        std::cout << "Could not find u_DetailNormals, maybe a mispelling?\n";
+        exit(EXIT_FAILURE);
+    }
 
-	// Vertex Buffer Object (VBO) creation
-	glGenBuffers(1, &gVertexBufferObjectSkybox);
-    glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObjectSkybox);
-	glBufferData(GL_ARRAY_BUFFER, // Kind of buffer we are working with  
-                                  // (e.g. GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER)
-							 vertexDataSkybox.size() * sizeof(GL_FLOAT), 	// Size of data in bytes
-							 vertexDataSkybox.data(), 						// Raw array of data
-							 GL_STATIC_DRAW);
+    GLint u_DetailTileSizeLocation = glGetUniformLocation(program,"u_DetailTileSize");
+    if(u_DetailTileSizeLocation>=0){
+        glUniform1f(u_DetailTileSizeLocation,gDetailNormalSettings.tileSize);
+    }else{
+        std::cout << "Could not find u_DetailTileSize, maybe a mispelling?\n";
+        exit(EXIT_FAILURE);
+    }
+}
 
-    // Position information (x,y,z)
-	glEnableVertexAttribArray(0);
+/**
+* Adds 'count' boxes at rest in a square grid 4 units apart, centred 260
+* units in front of the starting camera, which is 80 units up and looks
+* level, so the grid starts just above the bottom of the view. One in ten is boat sized, the rest
+* is debris of random size and density.
+*
+* @param system Buoyancy system to add the bodies to
+* @param count Number of bodies
+* @return void
+*/
+void SpawnBodies(BuoyancySystem& system, int count){
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float spacing = 4.0f;
+    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+    for(int i = 0; i < count; ++i){
+        glm::vec3 position((i % side - (side - 1) * 0.5f) * spacing, 0.0f,
+                           (i / side - (side - 1) * 0.5f) * spacing - 260.0f);
+        float yaw = unit(generator) * 6.2831853f;
+        if(i % 10 == 0){
+            system.AddBody(position, glm::vec3(1.2f, 0.5f, 3.5f), 0.4f, yaw);
+        }else{
+            glm::vec3 half(0.3f + unit(generator) * 0.8f, 0.15f + unit(generator) * 0.3f, 0.3f + unit(generator) * 0.8f);
+            system.AddBody(position, half, 0.3f + unit(generator) * 0.5f, yaw);
+        }
+    }
+}
+
+/**
+* Spawns --bodies boxes in a grid in front of the camera, one in ten a boat
+* sized hull and the rest debris, and sets up their instanced vertex array.
+*
+* @return void
+*/
+void BodySpecification(){
+    PROFILE_ZONE("BodySpecification");
+    if(gBodyCount == 0){
+        return;
+    }
+    gBodyWaveCount = ActiveWaveCount();
+    gBodyWaveNumber = DetailWaveNumber();
+    WaveSet waves = MeshWaves(gBodyWaveCount, gBodyWaveNumber);
+    gBuoyancySystem = new BuoyancySystem(waves, waves.size(), gBuoyancySettings);
+    SpawnBodies(*gBuoyancySystem, gBodyCount);
+
+    glGenVertexArrays(1, &gVertexArrayObjectBodies);
+    glBindVertexArray(gVertexArrayObjectBodies);
+
+    // The skybox's unit cube is the mesh of every body
+    glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObjectSkybox);
+    glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,sizeof(GL_FLOAT)*3,(GLvoid*)0);
 
-	// Unbind our currently bound Vertex Array Object
-	glBindVertexArray(0);
-	// Disable any attributes we opened in our Vertex Attribute Arrray,
-	// as we do not want to leave them open. 
-	glDisableVertexAttribArray(0);
+    // Position, orientation and half extents, advancing once per instance
+    glGenBuffers(1, &gVertexBufferObjectBodyInstances);
+    glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObjectBodyInstances);
+    for(GLuint attribute = 1; attribute <= 3; ++attribute){
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4)*3,
+                              (GLvoid*)(sizeof(glm::vec4)*(attribute - 1)));
+        glVertexAttribDivisor(attribute, 1);
+    }
 
-    cubemapFaces =
-    {
-        {
-            "./skybox_media/sky_right.ppm",
-            "./skybox_media/sky_left.ppm",
+    glBindVertexArray(0);
+    for(GLuint attribute = 0; attribute <= 3; ++attribute){
+        glDisableVertexAttribArray(attribute);
+    }
+    std::cout << "Floating bodies: " << gBodyCount << " on " << gBuoyancySystem->getThreadCount() << " threads, riding the "
+              << waves.size() << " of " << gBodyWaveCount << " waves the mesh draws\n";
+}
+
+/**
+* Steps the floating bodies to the current simulation time and writes their
+* instances into the snapshot. Runs on the simulation thread.
+*
+* @param request Step being run
+* @param snapshot Snapshot being filled
+* @return void
+*/
+void StepBodies(const SimulationRequest& request, FrameSnapshot& snapshot){
+    PROFILE_ZONE("StepBodies");
+    if(request.activeWaves != gBodyWaveCount || request.meshWaveNumber != gBodyWaveNumber){
+        gBodyWaveCount = request.activeWaves;
+        gBodyWaveNumber = request.meshWaveNumber;
+        WaveSet waves = MeshWaves(gBodyWaveCount, gBodyWaveNumber);
+        gBuoyancySystem->SetWaves(waves, waves.size());
+    }
+    gBuoyancySystem->Update(gSimulationClock.getTime(), static_cast<float>(gSimulationClock.getDelta()));
+    gBuoyancySystem->WriteInstances(snapshot.bodyInstances);
+}
+
+/**
+* Uploads the body instances of a snapshot.
+*
+* @param snapshot Snapshot with body instances
+* @return void
+*/
+void UploadBodies(const FrameSnapshot& snapshot){
+    PROFILE_ZONE("UploadBodies");
+    const std::vector<glm::vec4>& instances = snapshot.bodyInstances;
+    // Orphan last frame's data instead of waiting for the GPU to finish with it
+    glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObjectBodyInstances);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(glm::vec4), instances.data());
+}
+
+/**
+* Replaces the gerstner waves with ones sampled from gSeaState and rebuilds
+* everything that keeps its own copy of them. Every wave is drawn, the number
+* keys pick quarters of them. No simulation step may be running.
+*
+* @return void
+*/
+void ApplySeaState(){
+    PROFILE_ZONE("ApplySeaState");
+    auto start = std::chrono::steady_clock::now();
+    WaveSpectrum spectrum(gSeaState);
+    gWaveSet = WaveSet(spectrum.Generate());
+    num_of_waves = gWaveSet.size();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    if(gDetailNormalMap != nullptr){
+        delete gDetailNormalMap;
+        gDetailNormalMap = new DetailNormalMap(gWaveSet, gDetailNormalSettings);
+    }
+    // Baked again the next time the loop ocean is shown
+    delete gWaveLoopCache;
+    gWaveLoopCache = nullptr;
+    if(gBuoyancySystem != nullptr){
+        gBodyWaveCount = ActiveWaveCount();
+        gBodyWaveNumber = DetailWaveNumber();
+        WaveSet waves = MeshWaves(gBodyWaveCount, gBodyWaveNumber);
+        gBuoyancySystem->SetWaves(waves, waves.size());
+    }
+
+    std::cout << "Sea state: " << (gSeaState.spectrum == WindSeaSpectrum::JONSWAP ? "JONSWAP" : "Pierson-Moskowitz")
+              << ", wind " << gSeaState.windSpeed << " m/s, " << gWaveSet.size() << " waves, significant height "
+              << spectrum.SignificantWaveHeight() << " m, peak period "
+              << 6.28318530718f / spectrum.getPeakFrequency() << " s, generated in " << elapsed.count() << " ms\n";
+}
+
+/**
+* Uploads the FFT ocean maps of a snapshot.
+*
+* @param snapshot Snapshot with FFT ocean maps
+* @return void
+*/
+void UploadFFTOcean(const FrameSnapshot& snapshot){
+    PROFILE_ZONE("UploadFFTOcean");
+    int resolution = gFFTOcean->getResolution();
+
+    // Upload on the units they are drawn from so Draw() finds them already bound
+    gGLState.BindTexture(1, GL_TEXTURE_2D, gFFTDisplacementTexId);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, resolution, resolution, GL_RGB, GL_FLOAT, snapshot.fftDisplacement.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    gGLState.BindTexture(2, GL_TEXTURE_2D, gFFTNormalTexId);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, resolution, resolution, GL_RGB, GL_FLOAT, snapshot.fftNormals.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+/**
+* One step of the simulation, on gSimulation's thread: ticks the clock and
+* steps what 'request' asks for into 'snapshot'. It reads only the request
+* and objects the render thread leaves alone while a step may be running.
+*
+* @param request What the render thread asked for
+* @param snapshot Snapshot to fill, reused from an earlier step
+* @return void
+*/
+void SimulationStep(const SimulationRequest& request, FrameSnapshot& snapshot){
+    gSimulationClock.Tick();
+    snapshot.frame = gSimulationClock.getFrame();
+    snapshot.time = gSimulationClock.getTime();
+
+    // gerstner_waves texels, phases wrapped on the CPU in double
+    gWaveSet.WriteTexels(request.activeWaves, snapshot.time, snapshot.waveTexels);
+
+    // Short waves move from the mesh to the detail normal map
+    snapshot.detailNormals.clear();
+    if(request.gerstner && request.detailWaveNumber >= 0.0f){
+        PROFILE_ZONE("UpdateDetailNormalMap");
+        gDetailNormalMap->Update(snapshot.time, request.activeWaves, request.detailWaveNumber);
+        snapshot.detailNormals = gDetailNormalMap->normalData();
+    }
+
+    snapshot.bodyInstances.clear();
+    if(gBuoyancySystem != nullptr && request.gerstner){
+        StepBodies(request, snapshot);
+    }
+
+    snapshot.fftDisplacement.clear();
+    snapshot.fftNormals.clear();
+    if(request.fft){
+        PROFILE_ZONE("UpdateFFTOcean");
+        gFFTOcean->Update(snapshot.time);
+        snapshot.fftDisplacement = gFFTOcean->displacementData();
+        snapshot.fftNormals = gFFTOcean->normalData();
+    }
+}
+
+/**
+* What the next simulation step has to produce for the current ocean mode,
+* wave count and detail map, all of it state the render thread owns.
+*
+* @return request for gSimulation
+*/
+SimulationRequest CurrentSimulationRequest(){
+    SimulationRequest request;
+    request.activeWaves = ActiveWaveCount();
+    request.gerstner = gOceanMode == OceanMode::Gerstner;
+    request.fft = gOceanMode == OceanMode::FFT;
+    request.detailWaveNumber = gUseDetailMap ? DetailWaveNumber() : -1.0f;
+    request.meshWaveNumber = DetailWaveNumber();
+    return request;
+}
+
+/**
+* Takes the newest snapshot from gSimulation and requests the next step,
+* which runs while this frame issues its GL calls. A fixed step clock waits
+* for every step, so a run shows the same steps in the same order however
+* the threads were scheduled. It also waits while the snapshot is of
+* another ocean mode, like on the first frame or after the f key.
+*
+* @return true if the snapshot is new since the last frame
+*/
+bool AcquireSnapshot(){
+    PROFILE_ZONE("AcquireSnapshot");
+    SimulationRequest request = CurrentSimulationRequest();
+    auto answers = [&request](const FrameSnapshot& snapshot){
+        return snapshot.frame > 0 && snapshot.request.gerstner == request.gerstner && snapshot.request.fft == request.fft;
+    };
+
+    if(gSimulationClock.getMode() == ClockMode::FixedStep || !answers(gSimulation->Latest())){
+        gSimulation->WaitIdle();
+    }
+    bool fresh = gSimulation->Acquire();
+    // The step that was running when the mode changed stepped the old ocean
+    if(!answers(gSimulation->Latest())){
+        gSimulation->Request(request);
+        gSimulation->WaitIdle();
+        fresh = gSimulation->Acquire();
+    }
+    gSimulation->Request(request);
+    return fresh;
+}
+
+/**
+* Times FFTOcean::Update at the resolutions we care about and prints the
+* average cost of one update. Runs without a window or an OpenGL context.
+*
+* @return void
+*/
+void RunFFTBenchmark(){
+    const int resolutions[] = {128, 256, 512};
+    for(int resolution : resolutions){
+        FFTOceanSettings settings = gFFTOceanSettings;
+        settings.resolution = resolution;
+        FFTOcean ocean(settings);
+
+        // Warm up once so allocations are not part of the timings
+        ocean.Update(0.0);
+        const int iterations = 2048 * 2048 / (resolution * resolution) * 4;
+        auto start = std::chrono::steady_clock::now();
+        for(int i = 0; i < iterations; ++i){
+            ocean.Update(i / 60.0);
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "FFT ocean " << resolution << "x" << resolution << ": "
+                  << elapsed.count() / iterations << " ms per update\n";
+    }
+}
+
+/**
+* Compares the gerstner evaluator used by gerstner_tese.glsl, which reads the
+* constants premultiplied on the CPU, with the separate position and normal
+* loops it replaced, on a grid over the whole ocean. Both take the normal at
+* the displaced position. Also checks the tileable copy the loop mode bakes.
+*
+* @return true if the new evaluator matches the old one
+*/
+bool RunWaveVerification(){
+    const int gridSize = 256;
+    // Short uptimes only, later on the old float 'time * speed' is the one that
+    // drifts (see --soak-test)
+    const float times[] = {0.0f, 1.7f, 60.0f};
+    const int activeWaves = gWaveSet.size();
+
+    float maxPositionError = 0.0f;
+    float maxNormalError = 0.0f;
+    float maxNormalAngle = 0.0f;
+    double meanNormalAngle = 0.0;
+    int samples = 0;
+    for(float time : times){
+        for(int z = 0; z < gridSize; ++z){
+            for(int x = 0; x < gridSize; ++x){
+                glm::vec2 start = (glm::vec2(x, z) / float(gridSize - 1) * 2.0f - 1.0f) * gOceanSize;
+
+                glm::vec3 startNormal;
+                glm::vec3 position = gWaveSet.Evaluate(start, time, activeWaves, startNormal);
+                glm::vec3 normal = gWaveSet.ShadingNormal(glm::vec2(position.x, position.z), time, activeWaves);
+                glm::vec3 legacyPosition = gWaveSet.EvaluateLegacyPosition(start, time, activeWaves);
+                glm::vec3 legacyNormal = gWaveSet.EvaluateLegacyNormal(legacyPosition, time, activeWaves);
+
+                // Same displaced point for both, so only the constants and the phase rounding differ
+                glm::vec3 samePointNormal = gWaveSet.ShadingNormal(glm::vec2(legacyPosition.x, legacyPosition.z), time, activeWaves);
+
+                maxPositionError = std::max(maxPositionError, glm::length(position - legacyPosition));
+                maxNormalError = std::max(maxNormalError, glm::length(samePointNormal - legacyNormal) / glm::length(legacyNormal));
+
+                float angle = std::acos(glm::clamp(glm::dot(glm::normalize(normal), glm::normalize(legacyNormal)), -1.0f, 1.0f));
+                maxNormalAngle = std::max(maxNormalAngle, angle);
+                meanNormalAngle += angle;
+                ++samples;
+            }
+        }
+    }
+
+    std::cout << "New vs old position, max error: " << maxPositionError << "\n";
+    std::cout << "New vs old normal at the same displaced point, max relative error: " << maxNormalError << "\n";
+    std::cout << "New vs old normal at the displaced point, mean angle: " << glm::degrees(meanNormalAngle / samples)
+              << " deg, max: " << glm::degrees(maxNormalAngle) << " deg\n";
+
+    // The loop mode bakes the waves snapped to its tile: their directions must
+    // stay unit vectors and the surface must repeat every tile
+    const float tileSize = gWaveLoopSettings.tileSize;
+    WaveSet tileable = gWaveSet.MakeTileable(tileSize);
+    float maxDirectionError = 0.0f;
+    float maxWaveVectorShift = 0.0f;
+    for(int i = 0; i < activeWaves; ++i){
+        const GerstnerWave& live = gWaveSet.waves()[i];
+        const GerstnerWave& snapped = tileable.waves()[i];
+        maxDirectionError = std::max(maxDirectionError, std::abs(glm::length(snapped.direction) - 1.0f));
+        maxWaveVectorShift = std::max(maxWaveVectorShift,
+                                      glm::length(snapped.direction * snapped.frequency - live.direction * live.frequency));
+    }
+    float maxTileError = 0.0f;
+    for(int z = 0; z < 32; ++z){
+        for(int x = 0; x < 32; ++x){
+            glm::vec2 start = glm::vec2(x, z) / 32.0f * tileSize;
+            glm::vec3 normal, tiledNormal;
+            glm::vec3 position = tileable.Evaluate(start, 1.7, activeWaves, normal);
+            glm::vec3 tiled = tileable.Evaluate(start + glm::vec2(tileSize), 1.7, activeWaves, tiledNormal);
+            maxTileError = std::max(maxTileError, glm::length(tiled - glm::vec3(tileSize, 0.0f, tileSize) - position));
+            maxTileError = std::max(maxTileError, glm::length(tiledNormal - normal));
+        }
+    }
+    std::cout << "Tileable waves (tile " << tileSize << "), direction length error: " << maxDirectionError
+              << ", max wave vector shift: " << maxWaveVectorShift << ", max repeat error: " << maxTileError << "\n";
+
+    // CPU timings of both evaluators over the same points
+    const int iterations = 16;
+    // Keeps the compiler from dropping the loops
+    volatile float sink = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; ++i){
+        for(int z = 0; z < gridSize; ++z){
+            for(int x = 0; x < gridSize; ++x){
+                glm::vec2 point(x, z);
+                glm::vec3 position = gWaveSet.EvaluateLegacyPosition(point, i * 0.1f, activeWaves);
+                sink += position.y + gWaveSet.EvaluateLegacyNormal(position, i * 0.1f, activeWaves).y;
+            }
+        }
+    }
+    std::chrono::duration<double, std::milli> legacyTime = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; ++i){
+        for(int z = 0; z < gridSize; ++z){
+            for(int x = 0; x < gridSize; ++x){
+                glm::vec3 normal;
+                glm::vec3 position = gWaveSet.Evaluate(glm::vec2(x, z), i * 0.1f, activeWaves, normal);
+                sink += position.y + gWaveSet.ShadingNormal(glm::vec2(position.x, position.z), i * 0.1f, activeWaves).y;
+            }
+        }
+    }
+    std::chrono::duration<double, std::milli> newTime = std::chrono::steady_clock::now() - start;
+    double points = static_cast<double>(iterations) * gridSize * gridSize;
+    std::cout << "CPU per point, old: " << legacyTime.count() * 1e6 / points << " ns, new: "
+              << newTime.count() * 1e6 / points << " ns (" << activeWaves << " waves)\n";
+
+    // Positions sit up to gOceanSize from the origin, so allow a few float ulps
+    // of phase error, which the old loops round differently. A normal taken at
+    // the wrong point is off by tens of degrees.
+    bool passed = maxPositionError < 1e-2f && maxNormalError < 5e-3f;
+    passed = passed && glm::degrees(meanNormalAngle / samples) < 0.1 && glm::degrees(maxNormalAngle) < 2.0f;
+    passed = passed && maxDirectionError < 1e-5f && maxTileError < 1e-3f;
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed;
+}
+
+/**
+* Compares every WaveEvaluator kernel this CPU runs with WaveSet::Evaluate,
+* which follows gerstner_tese.glsl with std::sin and std::cos, on a grid
+* over the whole ocean at the same times as RunWaveVerification. Covers the
+* gerstner and sine models, the unrolled kernels and the generic loop, and
+* checks that the kernels writing fewer outputs agree with the full one.
+*
+* @return true if every kernel matches the shader math
+*/
+bool RunWaveKernelVerification(){
+    // Odd, so the points left over after the last full SIMD block are checked too
+    const int gridSize = 257;
+    const float times[] = {0.0f, 1.7f, 60.0f};
+    const int activeWaves = gWaveSet.size();
+
+    WaveBatch batch, partial;
+    batch.Resize(static_cast<size_t>(gridSize) * gridSize, true);
+    partial.Resize(batch.size(), true);
+    for(int z = 0; z < gridSize; ++z){
+        for(int x = 0; x < gridSize; ++x){
+            glm::vec2 start = (glm::vec2(x, z) / float(gridSize - 1) * 2.0f - 1.0f) * gOceanSize;
+            batch.x[z * gridSize + x] = start.x;
+            batch.z[z * gridSize + x] = start.y;
+        }
+    }
+    partial.x = batch.x;
+    partial.z = batch.z;
+
+    // The same waves without steepness run the sine kernels
+    std::vector<GerstnerWave> sineWaves = gWaveSet.waves();
+    for(GerstnerWave& wave : sineWaves){
+        wave.steepness = 0.0f;
+    }
+    const WaveSet waveSets[] = {gWaveSet, WaveSet(sineWaves)};
+
+    bool passed = true;
+    const WaveKernel kernels[] = {WaveKernel::Scalar, WaveKernel::SSE, WaveKernel::AVX2};
+    for(WaveKernel kernel : kernels){
+        if(!WaveEvaluator::IsSupported(kernel)){
+            std::cout << WaveEvaluator::KernelName(kernel) << " kernel: not supported here\n";
+            continue;
+        }
+        for(const WaveSet& waveSet : waveSets){
+            WaveEvaluator evaluator(waveSet, activeWaves);
+            for(bool unrolled : {true, false}){
+                evaluator.SetUnrolled(unrolled);
+                float maxPositionError = 0.0f;
+                float maxNormalError = 0.0f;
+                bool outputsAgree = true;
+                for(float time : times){
+                    evaluator.SetTime(time);
+                    evaluator.Evaluate(batch, 0, batch.size(), kernel, WaveOutputs::PositionNormalJacobian);
+                    for(size_t i = 0; i < batch.size(); ++i){
+                        glm::vec3 normal;
+                        glm::vec3 position = waveSet.Evaluate(glm::vec2(batch.x[i], batch.z[i]), time, activeWaves, normal);
+                        glm::vec3 kernelPosition(batch.positionX[i], batch.positionY[i], batch.positionZ[i]);
+                        glm::vec3 kernelNormal(batch.normalX[i], batch.normalY[i], batch.normalZ[i]);
+                        maxPositionError = std::max(maxPositionError, glm::length(position - kernelPosition));
+                        maxNormalError = std::max(maxNormalError, glm::length(normal - kernelNormal));
+                    }
+
+                    // Fewer outputs leave out terms, they do not change the others
+                    evaluator.Evaluate(partial, 0, partial.size(), kernel, WaveOutputs::Position);
+                    outputsAgree = outputsAgree && partial.positionX == batch.positionX &&
+                                   partial.positionY == batch.positionY && partial.positionZ == batch.positionZ;
+                    evaluator.Evaluate(partial, 0, partial.size(), kernel, WaveOutputs::PositionJacobian);
+                    outputsAgree = outputsAgree && partial.jacobianXX == batch.jacobianXX &&
+                                   partial.jacobianXZ == batch.jacobianXZ && partial.jacobianZZ == batch.jacobianZZ;
+                    evaluator.Evaluate(partial, 0, partial.size(), kernel, WaveOutputs::PositionNormal);
+                    outputsAgree = outputsAgree && partial.normalX == batch.normalX &&
+                                   partial.normalY == batch.normalY && partial.normalZ == batch.normalZ;
+                }
+                std::cout << WaveEvaluator::KernelName(kernel) << " kernel, " << WaveEvaluator::ModelName(evaluator.getModel())
+                          << (unrolled ? "" : ", generic loop") << " vs shader math, max position error: "
+                          << maxPositionError << ", max normal error: " << maxNormalError
+                          << (outputsAgree ? "" : ", outputs DISAGREE") << "\n";
+                // The kernels round the phase like the shader does, only their sin and
+                // cos are a few ulps off, scaled by the wave amplitudes
+                passed = passed && maxPositionError < 1e-3f && maxNormalError < 1e-3f && outputsAgree;
+            }
+        }
+    }
+
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed;
+}
+
+/**
+* Times WaveSet::Evaluate, then every WaveEvaluator kernel this CPU runs for
+* every wave model and set of outputs on a million points spread over the
+* ocean. Up to WaveEvaluator::kMaxUnrolledWaves waves the unrolled kernels
+* are compared with the generic loop.
+*
+* @return void
+*/
+void RunWaveBenchmark(){
+    const int gridSize = 1024;
+    const int iterations = 16;
+    const int activeWaves = gWaveSet.size();
+
+    WaveBatch batch;
+    batch.Resize(static_cast<size_t>(gridSize) * gridSize, true);
+    for(int z = 0; z < gridSize; ++z){
+        for(int x = 0; x < gridSize; ++x){
+            glm::vec2 start = (glm::vec2(x, z) / float(gridSize - 1) * 2.0f - 1.0f) * gOceanSize;
+            batch.x[z * gridSize + x] = start.x;
+            batch.z[z * gridSize + x] = start.y;
+        }
+    }
+    const double points = static_cast<double>(iterations) * batch.size();
+    std::cout << activeWaves << " waves, " << batch.size() << " points\n";
+
+    // Keeps the compiler from dropping the loops
+    volatile float sink = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; ++i){
+        for(size_t p = 0; p < batch.size(); ++p){
+            glm::vec3 normal;
+            sink += gWaveSet.Evaluate(glm::vec2(batch.x[p], batch.z[p]), i * 0.1, activeWaves, normal).y + normal.y;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "WaveSet::Evaluate, position and normal: " << points / elapsed.count() / 1e6 << " M points/s\n";
+
+    // The same waves without steepness run the sine kernels
+    std::vector<GerstnerWave> sineWaves = gWaveSet.waves();
+    for(GerstnerWave& wave : sineWaves){
+        wave.steepness = 0.0f;
+    }
+    WaveSet sineWaveSet(sineWaves);
+    WaveEvaluator evaluators[] = {WaveEvaluator(gWaveSet, activeWaves), WaveEvaluator(sineWaveSet, activeWaves)};
+    const WaveOutputs outputs[] = {WaveOutputs::Position, WaveOutputs::PositionNormal,
+                                   WaveOutputs::PositionJacobian, WaveOutputs::PositionNormalJacobian};
+    const bool unrolls = activeWaves <= WaveEvaluator::kMaxUnrolledWaves;
+
+    // Nanoseconds per point of one combination
+    auto time = [&](WaveEvaluator& evaluator, WaveKernel kernel, WaveOutputs output){
+        auto begin = std::chrono::steady_clock::now();
+        for(int i = 0; i < iterations; ++i){
+            evaluator.SetTime(i * 0.1);
+            evaluator.Evaluate(batch, 0, batch.size(), kernel, output);
+            sink += batch.positionY[i];
+        }
+        std::chrono::duration<double> spent = std::chrono::steady_clock::now() - begin;
+        return spent.count() * 1e9 / points;
+    };
+
+    const WaveKernel kernels[] = {WaveKernel::Scalar, WaveKernel::SSE, WaveKernel::AVX2};
+    for(WaveKernel kernel : kernels){
+        if(!WaveEvaluator::IsSupported(kernel)){
+            std::cout << WaveEvaluator::KernelName(kernel) << ": not supported here\n";
+            continue;
+        }
+        for(WaveEvaluator& evaluator : evaluators){
+            for(WaveOutputs output : outputs){
+                evaluator.SetUnrolled(true);
+                double nanoseconds = time(evaluator, kernel, output);
+                std::cout << WaveEvaluator::KernelName(kernel) << ", " << WaveEvaluator::ModelName(evaluator.getModel())
+                          << ", " << WaveEvaluator::OutputsName(output) << ": " << 1e3 / nanoseconds
+                          << " M points/s (" << nanoseconds << " ns per point";
+                if(unrolls){
+                    evaluator.SetUnrolled(false);
+                    std::cout << ", " << time(evaluator, kernel, output) << " with the generic loop";
+                }
+                std::cout << ")\n";
+            }
+        }
+    }
+}
+
+/**
+* Steps 10k floating bodies with 1, 2, 4, ... threads up to the hardware
+* concurrency and prints the time per physics step. Then it lets them
+* settle for 10 s, since they start at rest on a moving sea, and checks
+* that at least 95% of them float: partly under water, neither thrown into
+* the air nor pushed under. They ride the waves the mesh draws, like in the
+* application.
+*
+* @return true if enough bodies float
+*/
+bool RunBuoyancyBenchmark(){
+    const int bodies = gBodyCount > 0 ? gBodyCount : 10000;
+    const int steps = 120;
+    const int settleSteps = 600;
+    const float minFloating = 0.95f;
+    WaveSet waves = MeshWaves(num_of_waves, DetailWaveNumber());
+    int maxThreads = gBuoyancySettings.threadCount > 0 ? gBuoyancySettings.threadCount
+                                                       : JobSystem::getConcurrency();
+    std::cout << bodies << " bodies, " << BuoyancySystem::kHullPoints << " hull points each, batches of "
+              << gBuoyancySettings.batchSize << ", " << waves.size() << " of " << num_of_waves << " waves";
+    if(waves.size() < num_of_waves){
+        std::cout << " (the rest are drawn by the detail normal map)";
+    }
+    std::cout << "\n";
+
+    for(int threads = 1; ; threads = std::min(threads * 2, maxThreads)){
+        BuoyancySettings settings = gBuoyancySettings;
+        settings.threadCount = threads;
+        BuoyancySystem system(waves, waves.size(), settings);
+        SpawnBodies(system, bodies);
+
+        double total = 0.0;
+        for(int step = 1; step <= steps; ++step){
+            system.Step(step * settings.step);
+            total += system.getStepMs();
+        }
+        std::cout << threads << " threads: " << total / steps << " ms per step, "
+                  << bodies * steps / total * 1e-3 << " M bodies/s\n";
+
+        if(threads == maxThreads){
+            for(int step = steps + 1; step <= settleSteps; ++step){
+                system.Step(step * settings.step);
+            }
+            // Floating: the water line crosses the hull
+            const BodyArrays& state = system.bodies();
+            size_t floating = 0;
+            for(size_t i = 0; i < system.size(); ++i){
+                floating += state.submerged[i] > 0.0f && state.submerged[i] < 1.0f ? 1 : 0;
+            }
+            bool passed = floating >= minFloating * system.size();
+            std::cout << floating << " of " << system.size() << " bodies floating after "
+                      << settleSteps * settings.step << " s, at least " << minFloating * 100.0f << "% have to\n";
+            std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+            return passed;
+        }
+    }
+}
+
+/**
+* Samples 16, 64, 256 and 1024 waves from the --wind-speed style sea state and
+* prints how long that takes, the significant wave height of the waves against
+* the spectrum's and the sum of steepness * amplitude * wave number. Then checks
+* that the horizontal displacement of the waves never folds the surface: the
+* determinant of its jacobian has to stay positive on a grid of points.
+*
+* @return true if no sea state folds over
+*/
+bool RunSpectrumBenchmark(){
+    const int counts[] = {16, 64, 256, 1024};
+    const int gridSize = 256;
+    const float gridSpacing = 0.37f;
+    const double time = 12.5;
+
+    bool passed = true;
+    for(int count : counts){
+        SeaStateSettings settings = gSeaState;
+        settings.waveCount = count;
+        WaveSpectrum spectrum(settings);
+
+        const int iterations = 20;
+        std::vector<GerstnerWave> waves;
+        auto start = std::chrono::steady_clock::now();
+        for(int i = 0; i < iterations; ++i){
+            waves = spectrum.Generate();
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        double variance = 0.0, choppiness = 0.0;
+        for(const GerstnerWave& wave : waves){
+            variance += 0.5 * wave.amplitude * wave.amplitude;
+            choppiness += wave.steepness * wave.amplitude * wave.frequency;
+        }
+
+        WaveSet waveSet(waves);
+        WaveEvaluator evaluator(waveSet, waveSet.size());
+        evaluator.SetTime(time);
+        WaveBatch batch;
+        batch.Resize(static_cast<size_t>(gridSize) * gridSize, true);
+        for(int z = 0; z < gridSize; ++z){
+            for(int x = 0; x < gridSize; ++x){
+                batch.x[z * gridSize + x] = x * gridSpacing;
+                batch.z[z * gridSize + x] = z * gridSpacing;
+            }
+        }
+        evaluator.Evaluate(batch, 0, batch.size(), WaveEvaluator::BestKernel(), WaveOutputs::PositionJacobian);
+        float minDeterminant = 1.0f;
+        for(size_t i = 0; i < batch.size(); ++i){
+            float determinant = batch.jacobianXX[i] * batch.jacobianZZ[i] - batch.jacobianXZ[i] * batch.jacobianXZ[i];
+            minDeterminant = std::min(minDeterminant, determinant);
+        }
+        bool folds = minDeterminant <= 0.0f;
+        passed = passed && !folds;
+
+        std::cout << count << " waves: " << elapsed.count() / iterations << " ms, significant height "
+                  << 4.0 * std::sqrt(variance) << " m (spectrum " << spectrum.SignificantWaveHeight()
+                  << " m), sum of Q*A*k " << choppiness << ", smallest jacobian " << minDeterminant
+                  << (folds ? " FOLDS" : "") << "\n";
+    }
+    return passed;
+}
+
+/**
+* Solves the surface height above 1k, 10k and 100k random world points with
+* SurfaceQuery, checks every source against WaveSet::Evaluate and shows how far
+* off the height of the wave sum evaluated at the point itself would be. Then
+* shows how many points one call solves within the --surface-query-budget-ms
+* budget (default 2 ms).
+*
+* @return true if every converged source lands on its point
+*/
+bool RunSurfaceQueryBenchmark(){
+    const size_t counts[] = {1000, 10000, 100000};
+    const int activeWaves = num_of_waves;
+    const double time = 12.5;
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> coordinate(-0.9f * gOceanSize, 0.9f * gOceanSize);
+
+    SurfaceQuerySettings settings = gSurfaceQuerySettings;
+    settings.budgetMs = 0.0;
+    SurfaceQuery query(gWaveSet, activeWaves, settings);
+    query.SetTime(time);
+    std::cout << activeWaves << " waves, " << query.getThreadCount() << " threads, tolerance "
+              << settings.tolerance << "\n";
+
+    bool passed = true;
+    for(size_t count : counts){
+        SurfaceQueryBatch batch;
+        batch.Resize(count);
+        for(size_t i = 0; i < count; ++i){
+            batch.x[i] = coordinate(generator);
+            batch.z[i] = coordinate(generator);
+        }
+        query.Solve(batch);
+
+        // The shader math at the source must land on the point and give the same height
+        float maxLandingError = 0.0f;
+        double naiveError = 0.0;
+        for(size_t i = 0; i < count; ++i){
+            glm::vec3 normal;
+            glm::vec3 position = gWaveSet.Evaluate(glm::vec2(batch.sourceX[i], batch.sourceZ[i]), time, activeWaves, normal);
+            if(batch.error[i] <= settings.tolerance){
+                float landingError = glm::length(glm::vec2(position.x - batch.x[i], position.z - batch.z[i]));
+                maxLandingError = std::max(maxLandingError, std::max(landingError, std::abs(position.y - batch.height[i])));
+            }
+            naiveError += std::abs(gWaveSet.Evaluate(glm::vec2(batch.x[i], batch.z[i]), time, activeWaves, normal).y -
+                                   batch.height[i]);
+        }
+        passed = passed && maxLandingError < 1e-2f;
+
+        std::cout << count << " points: " << query.getSolveMs() << " ms, "
+                  << count / query.getSolveMs() * 1e-3 << " M points/s, " << query.getUnconverged()
+                  << " not converged, shader math at the sources off by " << maxLandingError
+                  << ", height at the point itself off by " << naiveError / count << " on average\n";
+    }
+
+    // As many points as fit in the budget per call, the rest in the next calls
+    settings.budgetMs = gSurfaceQuerySettings.budgetMs > 0.0 ? gSurfaceQuerySettings.budgetMs : 2.0;
+    SurfaceQuery budgeted(gWaveSet, activeWaves, settings);
+    budgeted.SetTime(time);
+    SurfaceQueryBatch batch;
+    batch.Resize(100000);
+    for(size_t i = 0; i < batch.size(); ++i){
+        batch.x[i] = coordinate(generator);
+        batch.z[i] = coordinate(generator);
+    }
+    size_t solved = budgeted.Solve(batch);
+    std::cout << "Budget " << settings.budgetMs << " ms: " << solved << " of " << batch.size()
+              << " points in " << budgeted.getSolveMs() << " ms\n";
+
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed;
+}
+
+/**
+* Feeds FrameStats a made up session: 5 ms frames with one 40 ms stall,
+* then a lasting drop to 16 ms frames, then one 100 ms stall. Each stall
+* is one hitch and must not move the average, while the drop may only
+* count as hitches until the average has caught up with it.
+*
+* @return true if the hitches were counted that way
+*/
+bool RunFrameStatsCheck(){
+    FrameStats stats;
+    for(int frame = 0; frame < 100; ++frame){
+        stats.Record(5.0);
+    }
+    stats.Record(40.0);
+    unsigned long long stallHitches = stats.getHitches();
+    double stallAverage = stats.getAverage();
+    for(int frame = 0; frame < 300; ++frame){
+        stats.Record(16.0);
+    }
+    unsigned long long dropHitches = stats.getHitches() - stallHitches;
+    double dropAverage = stats.getAverage();
+    stats.Record(100.0);
+    unsigned long long lastHitches = stats.getHitches() - stallHitches - dropHitches;
+
+    std::cout << "Stall: " << stallHitches << " hitches, average " << stallAverage << " ms\n";
+    std::cout << "Drop to 16 ms: " << dropHitches << " hitches, average " << dropAverage << " ms\n";
+    std::cout << "Stall after the drop: " << lastHitches << " hitches\n";
+    std::cout << stats.Summary() << "\n";
+    bool passed = stallHitches == 1 && std::abs(stallAverage - 5.0) < 1e-9 &&
+                  dropHitches <= 10 && std::abs(dropAverage - 16.0) < 0.1 && lastHitches == 1;
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed;
+}
+
+/**
+* Replays key events through InputTimeline the way Input() applies them:
+* each frame takes the events that happened since the last one, with their
+* own times, and moves by the held time of its window. A 1 s hold must move
+* the camera the same distance at 30 and at 144 fps, and a 50 ms tap that
+* starts and ends inside a 300 ms hitch must still move it for 50 ms.
+*
+* @return true if the distances match the held times
+*/
+bool RunInputTimelineCheck(){
+    struct KeyEvent{
+        double time;
+        bool down;
+    };
+    const int key = SDL_SCANCODE_W;
+    // Distance moved over frames ending at 'frameTimes'
+    auto replay = [&](const std::vector<KeyEvent>& events, const std::vector<double>& frameTimes){
+        InputTimeline timeline;
+        timeline.EndWindow(frameTimes.front());
+        size_t next = 0;
+        double distance = 0.0;
+        for(size_t frame = 1; frame < frameTimes.size(); ++frame){
+            double now = frameTimes[frame];
+            for(; next < events.size() && events[next].time <= now; ++next){
+                if(events[next].down){
+                    timeline.Press(key, events[next].time);
+                }else{
+                    timeline.Release(key, events[next].time);
+                }
+            }
+            distance += gCameraSpeed * timeline.HeldTime(key, now);
+            timeline.EndWindow(now);
+        }
+        return distance;
+    };
+    // Frames 'rate' times a second for 'seconds'
+    auto steadyFrames = [](double rate, double seconds){
+        std::vector<double> times;
+        for(int frame = 0; frame <= static_cast<int>(seconds * rate); ++frame){
+            times.push_back(frame / rate);
+        }
+        return times;
+    };
+
+    const std::vector<KeyEvent> hold = {{0.1, true}, {1.1, false}};
+    double hold30 = replay(hold, steadyFrames(30.0, 2.0));
+    double hold144 = replay(hold, steadyFrames(144.0, 2.0));
+
+    // 60 fps with a 300 ms hitch after 0.5 s, the tap falls inside it
+    std::vector<double> hitchFrames;
+    for(double time : steadyFrames(60.0, 1.0)){
+        if(time <= 0.5 || time >= 0.8){
+            hitchFrames.push_back(time);
+        }
+    }
+    const std::vector<KeyEvent> tap = {{0.6, true}, {0.65, false}};
+    double tapDistance = replay(tap, hitchFrames);
+
+    std::cout << "1 s hold: " << hold30 << " units at 30 fps, " << hold144 << " units at 144 fps, "
+              << gCameraSpeed << " expected\n";
+    std::cout << "50 ms tap in a 300 ms hitch: " << tapDistance << " units, " << gCameraSpeed * 0.05 << " expected\n";
+    const double tolerance = 1e-9;
+    bool passed = std::abs(hold30 - gCameraSpeed) < tolerance && std::abs(hold144 - gCameraSpeed) < tolerance &&
+                  std::abs(tapDistance - gCameraSpeed * 0.05) < tolerance;
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed;
+}
+
+/**
+* Fast-forwards the clock to increasing uptimes and animates one second of
+* gerstner waves at 60 fps from each, comparing the heights of the shader
+* math with a double precision reference. Also shows what the old float
+* 'time * speed' would have done at the same uptimes.
+*
+* @return true if day 30 is as accurate as hour 1
+*/
+bool RunSoakTest(){
+    const double hour = 3600.0, day = 24.0 * hour;
+    const double uptimes[] = {hour, day, 7.0 * day, 30.0 * day, 365.0 * day};
+    const int frames = 60;
+    const int activeWaves = gWaveSet.size();
+
+    // Double precision height of the undisplaced point 'position'
+    auto referenceHeight = [&](const glm::dvec2& position, double time){
+        double height = 0.0;
+        for(const GerstnerWave& wave : gWaveSet.waves()){
+            glm::dvec2 direction(wave.direction);
+            height += wave.amplitude * std::sin(glm::dot(position, direction) * double(wave.frequency) + time * double(wave.speed) + double(wave.phase));
+        }
+        return height;
+    };
+
+    double hourError = 0.0, monthError = 0.0;
+    for(double uptime : uptimes){
+        double maxError = 0.0, maxLegacyError = 0.0;
+        for(int frame = 0; frame < frames; ++frame){
+            double time = uptime + frame / 60.0;
+            for(int i = 0; i < 64; ++i){
+                glm::vec2 start(i * 1.37f, i * -0.61f);
+                double reference = referenceHeight(glm::dvec2(start), time);
+
+                glm::vec3 normal;
+                double height = gWaveSet.Evaluate(start, time, activeWaves, normal).y;
+                double legacyHeight = gWaveSet.EvaluateLegacyPosition(start, static_cast<float>(time), activeWaves).y;
+                maxError = std::max(maxError, std::abs(height - reference));
+                maxLegacyError = std::max(maxLegacyError, std::abs(legacyHeight - reference));
+            }
+        }
+
+        if(uptime == hour){
+            hourError = maxError;
+        }
+        if(uptime == 30.0 * day){
+            monthError = maxError;
+        }
+        std::cout << "Uptime " << uptime / day << " days: max height error " << maxError
+                  << ", with float time " << maxLegacyError << "\n";
+    }
+
+    bool passed = monthError <= 2.0 * hourError + 1e-5;
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed;
+}
+
+/**
+* Makes sure the baked wave loop matches the current number of waves,
+* loading it from the disk cache or baking it, and uploads it as two 3D textures.
+*
+* @return void
+*/
+void UpdateWaveLoop(){
+    PROFILE_ZONE("UpdateWaveLoop");
+    if(gWaveLoopCache != nullptr && gWaveLoopCache->activeWaves() == std::min(ActiveWaveCount(), gWaveSet.size())){
+        return;
+    }
+
+    delete gWaveLoopCache;
+    gWaveLoopCache = new WaveLoopCache(gWaveSet, ActiveWaveCount(), gWaveLoopSettings);
+    auto start = std::chrono::steady_clock::now();
+    bool fromDisk = gWaveLoopCache->Build();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << (fromDisk ? "Loaded" : "Baked") << " wave loop for " << gWaveLoopCache->activeWaves()
+              << " waves in " << elapsed.count() << " s\n";
+
+    const WaveLoopSettings& settings = gWaveLoopCache->settings();
+    const std::vector<uint16_t>* data[] = {&gWaveLoopCache->displacementData(), &gWaveLoopCache->normalData()};
+    GLuint* textures[] = {&gLoopDisplacementTexId, &gLoopNormalTexId};
+    for(int i = 0; i < 2; ++i){
+        if(*textures[i] == 0){
+            glGenTextures(1, textures[i]);
+        }
+        // Units 1 and 2, where Draw() expects them
+        gGLState.BindTexture(1 + i, GL_TEXTURE_3D, *textures[i]);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, settings.resolution, settings.resolution, settings.frames,
+                     0, GL_RGBA, GL_HALF_FLOAT, data[i]->data());
+        // Linear in x, z and time, repeating so both the tile and the loop wrap
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+    }
+}
+
+/**
+* Sets the skybox sampler of the FFT and loop ocean pipelines, their camera
+* data comes from FrameUniforms. The program must be in use.
+*
+* @return void
+*/
+void SetOceanSkyboxUniform(GLuint program){
+    // The skybox is always on texture unit 0
+    GLint u_SkyboxLocation = glGetUniformLocation(program,"skybox");
+    if(u_SkyboxLocation>=0){
+        glUniform1i(u_SkyboxLocation,0);
+    }else{
+        std::cout << "Could not find skybox, maybe a mispelling?\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+* Sets the tessellation level read by gerstner_tesc.glsl, which all ocean
+* programs share. 'program' must be in use.
+*
+* @param program Ocean shader program
+* @param tessLevel Tessellation level per patch side
+* @return void
+*/
+void SetTessellationUniforms(GLuint program, float tessLevel){
+    GLint u_TessLevelLocation = glGetUniformLocation(program,"u_TessLevel");
+    if(u_TessLevelLocation>=0){
+        glUniform1f(u_TessLevelLocation,tessLevel);
+    }else{
+        std::cout << "Could not find u_TessLevel, maybe a mispelling?\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+* Setup your geometry during the vertex specification step
+*
+* @return void
+*/
+/**
+* Setup your geometry during the vertex specification step
+*
+* @return void
+*/
+void VertexSpecification(){
+    PROFILE_ZONE("VertexSpecification");
+
+	// Vertex Arrays Object (VAO) Setup
+	glGenVertexArrays(1, &gVertexArrayObjectFloor);
+	// We bind (i.e. select) to the Vertex Array Object (VAO) that we want to work withn.
+	glBindVertexArray(gVertexArrayObjectFloor);
+	// Vertex Buffer Object (VBO) creation
+	glGenBuffers(1, &gVertexBufferObjectFloor);
+
+    // Generate our data for the buffer
+    //GeneratePlaneBufferData();
+    // One 4 vertex patch per grid cell
+    std::vector<GLfloat> vertexDataQuad;
+    float patchSize = 2.0f * gOceanSize / gPatchGrid;
+    for(int z = 0; z < gPatchGrid; ++z){
+        for(int x = 0; x < gPatchGrid; ++x){
+            float x0 = -gOceanSize + x * patchSize, x1 = x0 + patchSize;
+            float z0 = -gOceanSize + z * patchSize, z1 = z0 + patchSize;
+            std::vector<GLfloat> patch
+            {
+                x0, 0.0, z0,       // Bottom-left vertex of quad
+                0.0, 1.0, 0.0,     // normal
+                x1, 0.0, z0,       // Bottom-right vertex
+                0.0, 1.0, 0.0,     // normal
+                x1, 0.0, z1,       // Top-right vertex
+                0.0, 1.0, 0.0,     // normal
+                x0, 0.0, z1,       // Top-left vertex
+                0.0, 1.0, 0.0      // normal
+            };
+            vertexDataQuad.insert(vertexDataQuad.end(), patch.begin(), patch.end());
+        }
+    }
+
+    // Number of vertices, 6 floats each
+    gFloorTriangles = vertexDataQuad.size() / 6;
+
+    glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObjectFloor);
+	glBufferData(GL_ARRAY_BUFFER, // Kind of buffer we are working with  
+                                  // (e.g. GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER)
+							 vertexDataQuad.size() * sizeof(GL_FLOAT), 	// Size of data in bytes
+							 vertexDataQuad.data(), 						// Raw array of data
+							 GL_STATIC_DRAW);	
+ 
+    // =============================
+    // offsets every 3 floats
+    // v     v
+    // 
+    // x,y,z,nx,ny,nz
+    //
+    // |------------------| strides is '6' floats
+    //
+    // ============================
+    // Position information (x,y,z)
+	glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,sizeof(GL_FLOAT)*6,(GLvoid*)0);
+    // Normal information (nx,ny,nz)
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,sizeof(GL_FLOAT)*6, (GLvoid*)(sizeof(GL_FLOAT)*3));
+
+	// Unbind our currently bound Vertex Array Object
+	glBindVertexArray(0);
+	// Disable any attributes we opened in our Vertex Attribute Arrray,
+	// as we do not want to leave them open. 
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+
+    // // Texture data setup
+    // // Generate Texture object
+    // glGenTextures(1, &gTexId);
+    // // Bind it to GL_TEXTURE_2D
+    // glBindTexture(GL_TEXTURE_2D, gTexId);
+    // // Populate Texture data
+    // std::string fileName = "./water.ppm";
+    // PPM texturePPM = PPM(fileName);
+    // //texturePPM.flipPPM();
+    // std::vector<uint8_t> texturePixelData = texturePPM.pixelData();
+    // int height = texturePPM.getHeight();
+    // int width = texturePPM.getWidth();
+    // glTexImage2D(
+    //     GL_TEXTURE_2D,          // 2D Texture
+    //     0,                      // Mipmap level 0(highest resolution)
+    //     GL_RGB,                 // Internal format
+    //     width,                  // Image width
+    //     height,                 // Image height
+    //     0,                      // Border(must be 0)
+    //     GL_RGB,                 // Image format
+    //     GL_UNSIGNED_BYTE,       // Data type of each pixel
+    //     texturePixelData.data() // Raw texture pixel data
+    // );
+    // // Generate mipmaps for our texture
+    // glGenerateMipmap(GL_TEXTURE_2D);
+    // // Parameters for minification, magnification, wrap on s and t using bilinear filtering
+    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    glGenVertexArrays(1, &gVertexArrayObjectSkybox);
+	// We bind (i.e. select) to the Vertex Array Object (VAO) that we want to work withn.
+	glBindVertexArray(gVertexArrayObjectSkybox);
+
+    std::vector<GLfloat> vertexDataSkybox
+    {
+        // positions          
+        -1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f, -1.0f,
+        1.0f, -1.0f, -1.0f,
+        1.0f, -1.0f, -1.0f,
+        1.0f,  1.0f, -1.0f,
+        -1.0f,  1.0f, -1.0f,
+
+        -1.0f, -1.0f,  1.0f,
+        -1.0f, -1.0f, -1.0f,
+        -1.0f,  1.0f, -1.0f,
+        -1.0f,  1.0f, -1.0f,
+        -1.0f,  1.0f,  1.0f,
+        -1.0f, -1.0f,  1.0f,
+
+        1.0f, -1.0f, -1.0f,
+        1.0f, -1.0f,  1.0f,
+        1.0f,  1.0f,  1.0f,
+        1.0f,  1.0f,  1.0f,
+        1.0f,  1.0f, -1.0f,
+        1.0f, -1.0f, -1.0f,
+
+        -1.0f, -1.0f,  1.0f,
+        -1.0f,  1.0f,  1.0f,
+        1.0f,  1.0f,  1.0f,
+        1.0f,  1.0f,  1.0f,
+        1.0f, -1.0f,  1.0f,
+        -1.0f, -1.0f,  1.0f,
+
+        -1.0f,  1.0f, -1.0f,
+        1.0f,  1.0f, -1.0f,
+        1.0f,  1.0f,  1.0f,
+        1.0f,  1.0f,  1.0f,
+        -1.0f,  1.0f,  1.0f,
+        -1.0f,  1.0f, -1.0f,
+
+        -1.0f, -1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,
+        1.0f, -1.0f, -1.0f,
+        1.0f, -1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,
+        1.0f, -1.0f,  1.0f
+    };
+
+	// Vertex Buffer Object (VBO) creation
+	glGenBuffers(1, &gVertexBufferObjectSkybox);
+    glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObjectSkybox);
+	glBufferData(GL_ARRAY_BUFFER, // Kind of buffer we are working with  
+                                  // (e.g. GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER)
+							 vertexDataSkybox.size() * sizeof(GL_FLOAT), 	// Size of data in bytes
+							 vertexDataSkybox.data(), 						// Raw array of data
+							 GL_STATIC_DRAW);
+
+    // Position information (x,y,z)
+	glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,sizeof(GL_FLOAT)*3,(GLvoid*)0);
+
+	// Unbind our currently bound Vertex Array Object
+	glBindVertexArray(0);
+	// Disable any attributes we opened in our Vertex Attribute Arrray,
+	// as we do not want to leave them open. 
+	glDisableVertexAttribArray(0);
+
+    cubemapFaces =
+    {
+        {
+            "./skybox_media/sky_right.ppm",
+            "./skybox_media/sky_left.ppm",
             "./skybox_media/sky_top.ppm",
             "./skybox_media/sky_bottom.ppm",
             "./skybox_media/sky_front.ppm",
@@ -587,55 +2113,62 @@ void VertexSpecification(){
     loadCubemap(cubemapFaces[chosenEnvironment]);  
 }
 
+/**
+* The window's framebuffer as a frame graph target
+*
+* @return RenderTargetDesc
+*/
+RenderTargetDesc BackbufferDescription(){
+    RenderTargetDesc backbuffer;
+    backbuffer.width = gScreenWidth;
+    backbuffer.height = gScreenHeight;
+    backbuffer.clearColorValue = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
+    return backbuffer;
+}
+
+/**
+* The target the ocean and skybox are drawn into: the window, or with
+* dynamic resolution or the quality governor the window size times the current scale
+*
+* @return RenderTargetDesc
+*/
+RenderTargetDesc SceneTargetDescription(){
+    RenderTargetDesc scene = BackbufferDescription();
+    if(gQualityGovernor != nullptr || gDynamicResolution != nullptr){
+        // The governor takes the scale over from dynamic resolution
+        float scale = (gQualityGovernor != nullptr) ? gQualityGovernor->getLevel().renderScale
+                                                    : gDynamicResolution->getScale();
+        scene.width = std::max(1, static_cast<int>(std::lround(gScreenWidth * scale)));
+        scene.height = std::max(1, static_cast<int>(std::lround(gScreenHeight * scale)));
+    }
+    return scene;
+}
+
 /**
 * PreDraw
 * Typically we will use this for setting some sort of 'state'
 * Note: some of the calls may take place at different stages (post-processing) of the
 * 		 pipeline.
+* Uploads what the simulation step of 'snapshot' produced, only once per snapshot.
+*
+* @param snapshot Newest snapshot from gSimulation
+* @param fresh True if it was not uploaded yet
 * @return void
 */
-void PreDraw(){
-    glEnable(GL_DEPTH_TEST);
-
+void PreDraw(const FrameSnapshot& snapshot, bool fresh){
+    PROFILE_ZONE("PreDraw");
     // Set the polygon fill mode
-    glPolygonMode(GL_FRONT_AND_BACK,gPolygonMode);
-
-    // Initialize clear color
-    // This is the background of the screen.
-    glViewport(0, 0, gScreenWidth, gScreenHeight);
-    glClearColor( 0.1f, 0.1f, 0.1f, 1.0f );
+    gGLState.PolygonMode(gPolygonMode);
 
-    //Clear color buffer and Depth Buffer
-  	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    // Clears, viewport and depth state are set per pass by gFrameGraph
 
     // Use our shader
-	glUseProgram(gGraphicsPipelineShaderProgram);
+	gGLState.UseProgram(gGraphicsPipelineShaderProgram);
 
     // Model transformation by translating our object into world space
     glm::mat4 model = glm::translate(glm::mat4(1.0f),glm::vec3(0.0f,0.0f,0.0f)); 
 
-    glPatchParameteri(GL_PATCH_VERTICES, 4);
-
-    // Retrieve our location of our Model Matrix
-    GLint u_ModelMatrixLocation = glGetUniformLocation( gGraphicsPipelineShaderProgram,"u_ModelMatrix");
-    if(u_ModelMatrixLocation >=0){
-        glUniformMatrix4fv(u_ModelMatrixLocation,1,GL_FALSE,&model[0][0]);
-    }else{
-        std::cout << "Could not find u_ModelMatrix, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
-    }
-
-
-    // Update the View Matrix
-    GLint u_ViewMatrixLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram,"u_ViewMatrix");
-    if(u_ViewMatrixLocation>=0){
-        glm::mat4 viewMatrix = gCamera.GetViewMatrix();
-        glUniformMatrix4fv(u_ViewMatrixLocation,1,GL_FALSE,&viewMatrix[0][0]);
-    }else{
-        std::cout << "Could not find u_ViewMatrix, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
-    }
-
+    gGLState.PatchVertices(4);
 
     // Projection matrix (in perspective) 
     glm::mat4 perspective = glm::perspective(glm::radians(45.0f),
@@ -643,295 +2176,447 @@ void PreDraw(){
                                              0.1f,
                                              2000.0f);
 
-    // Retrieve our location of our perspective matrix uniform 
-    GLint u_ProjectionLocation= glGetUniformLocation( gGraphicsPipelineShaderProgram,"u_Projection");
-    if(u_ProjectionLocation>=0){
-        glUniformMatrix4fv(u_ProjectionLocation,1,GL_FALSE,&perspective[0][0]);
-    }else{
-        std::cout << "Could not find u_Projection, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    glm::vec3 cameraPos = glm::vec3(gCamera.GetEyeXPosition() + gCamera.GetViewXDirection(),
+                                  gCamera.GetEyeYPosition() + gCamera.GetViewYDirection(),
+                                  gCamera.GetEyeZPosition() + gCamera.GetViewZDirection());
+
+    // Model, view, projection and camera data for every program at once,
+    // written straight into this frame's slot of the ring
+    {
+        PROFILE_ZONE("UpdateFrameUniforms");
+        FrameUniforms* frame = static_cast<FrameUniforms*>(gFrameUniformRing->Begin());
+        frame->model = model;
+        frame->view = gCamera.GetViewMatrix();
+        frame->projection = perspective;
+        frame->skyboxView = glm::mat4(glm::mat3(gCamera.GetViewMatrix()));
+        frame->cameraPos = cameraPos;
+        // World size of one pixel at unit distance, for the per patch band limit
+        frame->pixelAngle = 2.0f * std::tan(glm::radians(45.0f) / 2.0f) / SceneTargetDescription().height;
+        frame->detailWaveNumber = DetailWaveNumber();
+        gFrameUniformRing->End(gFrameUniformsBinding);
     }
 
     // Retrieve our location of our texture sampler uniform 
     // GLint u_TextureSamplerLocation = glGetUniformLocation( gGraphicsPipelineShaderProgram,"tex");
     // if(u_TextureSamplerLocation>=0){
     //     glUniform1i(u_TextureSamplerLocation,0);
-    // }else{
-    //     std::cout << "Could not find tex, maybe a mispelling?\n";
-    //     exit(EXIT_FAILURE);
-    // }
-
-    GLint u_SkyTextureSamplerLocation = glGetUniformLocation( gGraphicsPipelineShaderProgram,"skybox");
-    if(u_SkyTextureSamplerLocation>=0){
-        glUniform1i(u_SkyTextureSamplerLocation,0);
-    }else{
-        std::cout << "Could not find skybox, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
-    }
-
-    glm::vec3 cameraPos = glm::vec3(gCamera.GetEyeXPosition() + gCamera.GetViewXDirection(),
-                                  gCamera.GetEyeYPosition() + gCamera.GetViewYDirection(),
-                                  gCamera.GetEyeZPosition() + gCamera.GetViewZDirection());
-
-    GLint u_ViewPosition = glGetUniformLocation(gGraphicsPipelineShaderProgram,"cameraPos");
-    if(u_ViewPosition >=0){
-        glUniform3fv(u_ViewPosition,1,&cameraPos[0]);
-    }else{
-        std::cout << "Could not find cameraPos, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
-    } 
-    
+    // }else{
+    //     std::cout << "Could not find tex, maybe a mispelling?\n";
+    //     exit(EXIT_FAILURE);
+    // }
 
-    GLint u_GerstnerWavesLengthLocation= glGetUniformLocation( gGraphicsPipelineShaderProgram,"num_of_waves");
-    if(u_GerstnerWavesLengthLocation>=0){
-        glUniform1ui(u_GerstnerWavesLengthLocation,num_of_waves);
+    GLint u_SkyTextureSamplerLocation = glGetUniformLocation( gGraphicsPipelineShaderProgram,"skybox");
+    if(u_SkyTextureSamplerLocation>=0){
+        glUniform1i(u_SkyTextureSamplerLocation,0);
     }else{
-        std::cout << "Could not find num_of_waves, maybe a mispelling?\n";
+        std::cout << "Could not find skybox, maybe a mispelling?\n";
         exit(EXIT_FAILURE);
     }
 
-    GLint u_GerstnerWaveTimeLocation= glGetUniformLocation( gGraphicsPipelineShaderProgram,"time");
-    if(u_GerstnerWaveTimeLocation>=0){
-        glUniform1f(u_GerstnerWaveTimeLocation,static_cast<float>(SDL_GetTicks()) / 1000.0f);
+    GLint u_GerstnerWavesLocation = glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves");
+    if(u_GerstnerWavesLocation>=0){
+        glUniform1i(u_GerstnerWavesLocation,4);
     }else{
-        std::cout << "Could not find time, maybe a mispelling?\n";
+        std::cout << "Could not find gerstner_waves, maybe a mispelling?\n";
         exit(EXIT_FAILURE);
     }
 
-    // Wave 0 ---------------------------------------
-    GLint u_GerstnerWaveDirectionLocation= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[0].direction");
-    if(u_GerstnerWaveDirectionLocation>=0){
-        glUniform2f(u_GerstnerWaveDirectionLocation,glm::sin(0.32f), glm::cos(0.32f));
-    }else{
-        std::cout << "Could not find gerstner_waves[0].direction, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    // num_of_waves and the gerstner_waves buffer, phases wrapped on the CPU
+    if(fresh){
+        WaveSet::Upload(gGraphicsPipelineShaderProgram, gWaveBufferObject, snapshot.waveTexels);
     }
 
-    GLint u_GerstnerWaveAmplitudeLocation= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[0].amplitude");
-    if(u_GerstnerWaveAmplitudeLocation>=0){
-        glUniform1f(u_GerstnerWaveAmplitudeLocation,1.64f);
-    }else{
-        std::cout << "Could not find gerstner_waves[0].amplitude, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
-    }
+    SetTessellationUniforms(gGraphicsPipelineShaderProgram, GerstnerTessLevel());
 
-    GLint u_GerstnerWaveSteepnessLocation= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[0].steepness");
-    if(u_GerstnerWaveSteepnessLocation>=0){
-        glUniform1f(u_GerstnerWaveSteepnessLocation,1.64f);
-    }else{
-        std::cout << "Could not find gerstner_waves[0].steepness, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    // Short waves move from the mesh to the detail normal map
+    if(fresh && !snapshot.detailNormals.empty()){
+        UploadDetailNormalMap(snapshot);
     }
-
-    GLint u_GerstnerWaveFrequencyLocation= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[0].frequency");
-    if(u_GerstnerWaveFrequencyLocation>=0){
-        glUniform1f(u_GerstnerWaveFrequencyLocation,3.0f);
-    }else{
-        std::cout << "Could not find gerstner_waves[0].frequency, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    if(gUseDetailMap){
+        SetDetailUniforms(gGraphicsPipelineShaderProgram);
     }
 
-    GLint u_GerstnerWaveSpeedLocation= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[0].speed");
-    if(u_GerstnerWaveSpeedLocation>=0){
-        glUniform1f(u_GerstnerWaveSpeedLocation,2.0f);
-    }else{
-        std::cout << "Could not find gerstner_waves[0].speed, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    if(fresh && !snapshot.bodyInstances.empty()){
+        UploadBodies(snapshot);
     }
 
-    // Wave 1 -----------------------------------
-    GLint u_GerstnerWaveDirectionLocation1= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[1].direction");
-    if(u_GerstnerWaveDirectionLocation1>=0){
-        glUniform2f(u_GerstnerWaveDirectionLocation1,glm::sin(0.75f), glm::cos(0.25f));
-    }else{
-        std::cout << "Could not find gerstner_waves[1].direction, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
-    }
+    // FFT ocean -----------------------------------
+    if(gOceanMode == OceanMode::FFT){
+        if(fresh && !snapshot.fftDisplacement.empty()){
+            UploadFFTOcean(snapshot);
+        }
+        gGLState.UseProgram(gFFTPipelineShaderProgram);
 
-    GLint u_GerstnerWaveAmplitudeLocation1= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[1].amplitude");
-    if(u_GerstnerWaveAmplitudeLocation1>=0){
-        glUniform1f(u_GerstnerWaveAmplitudeLocation1,2.5f);
-    }else{
-        std::cout << "Could not find gerstner_waves[1].amplitude, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
-    }
+        SetOceanSkyboxUniform(gFFTPipelineShaderProgram);
+        SetTessellationUniforms(gFFTPipelineShaderProgram, OceanTessLevel());
 
-    GLint u_GerstnerWaveSteepnessLocation1= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[1].steepness");
-    if(u_GerstnerWaveSteepnessLocation1>=0){
-        glUniform1f(u_GerstnerWaveSteepnessLocation1,0.5f);
-    }else{
-        std::cout << "Could not find gerstner_waves[1].steepness, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+        // Texture units: 0 skybox, 1 displacement map, 2 normal map
+        GLint u_FFTDisplacementLocation = glGetUniformLocation(gFFTPipelineShaderProgram,"u_Displacement");
+        if(u_FFTDisplacementLocation>=0){
+            glUniform1i(u_FFTDisplacementLocation,1);
+        }else{
+            std::cout << "Could not find u_Displacement, maybe a mispelling?\n";
+            exit(EXIT_FAILURE);
+        }
+
+        GLint u_FFTNormalMapLocation = glGetUniformLocation(gFFTPipelineShaderProgram,"u_NormalMap");
+        if(u_FFTNormalMapLocation>=0){
+            glUniform1i(u_FFTNormalMapLocation,2);
+        }else{
+            std::cout << "Could not find u_NormalMap, maybe a mispelling?\n";
+            exit(EXIT_FAILURE);
+        }
+
+        GLint u_FFTPatchSizeLocation = glGetUniformLocation(gFFTPipelineShaderProgram,"u_PatchSize");
+        if(u_FFTPatchSizeLocation>=0){
+            glUniform1f(u_FFTPatchSizeLocation,gFFTOcean->getPatchSize());
+        }else{
+            std::cout << "Could not find u_PatchSize, maybe a mispelling?\n";
+            exit(EXIT_FAILURE);
+        }
+
+        // Pick the mip whose texel size matches the spacing of the tessellated
+        // vertices, sampling finer than that only aliases
+        float vertexSpacing = 2.0f * gOceanSize / (gPatchGrid * OceanTessLevel());
+        float texelSize = gFFTOcean->getPatchSize() / gFFTOcean->getResolution();
+        float displacementLod = std::max(0.0f, std::log2(vertexSpacing / texelSize));
+        GLint u_FFTDisplacementLodLocation = glGetUniformLocation(gFFTPipelineShaderProgram,"u_DisplacementLod");
+        if(u_FFTDisplacementLodLocation>=0){
+            glUniform1f(u_FFTDisplacementLodLocation,displacementLod);
+        }else{
+            std::cout << "Could not find u_DisplacementLod, maybe a mispelling?\n";
+            exit(EXIT_FAILURE);
+        }
     }
 
-    GLint u_GerstnerWaveFrequencyLocation1= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[1].frequency");
-    if(u_GerstnerWaveFrequencyLocation1>=0){
-        glUniform1f(u_GerstnerWaveFrequencyLocation1,1.0f);
-    }else{
-        std::cout << "Could not find gerstner_waves[1].frequency, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    // Baked loop -----------------------------------
+    if(gOceanMode == OceanMode::Loop){
+        UpdateWaveLoop();
+        gGLState.UseProgram(gLoopPipelineShaderProgram);
+        SetOceanSkyboxUniform(gLoopPipelineShaderProgram);
+        SetTessellationUniforms(gLoopPipelineShaderProgram, OceanTessLevel());
+
+        // Texture units: 0 skybox, 1 displacement, 2 normals
+        GLint u_LoopDisplacementLocation = glGetUniformLocation(gLoopPipelineShaderProgram,"u_LoopDisplacement");
+        if(u_LoopDisplacementLocation>=0){
+            glUniform1i(u_LoopDisplacementLocation,1);
+        }else{
+            std::cout << "Could not find u_LoopDisplacement, maybe a mispelling?\n";
+            exit(EXIT_FAILURE);
+        }
+
+        GLint u_LoopNormalsLocation = glGetUniformLocation(gLoopPipelineShaderProgram,"u_LoopNormals");
+        if(u_LoopNormalsLocation>=0){
+            glUniform1i(u_LoopNormalsLocation,2);
+        }else{
+            std::cout << "Could not find u_LoopNormals, maybe a mispelling?\n";
+            exit(EXIT_FAILURE);
+        }
+
+        GLint u_LoopTileSizeLocation = glGetUniformLocation(gLoopPipelineShaderProgram,"u_LoopTileSize");
+        if(u_LoopTileSizeLocation>=0){
+            glUniform1f(u_LoopTileSizeLocation,gWaveLoopCache->settings().tileSize);
+        }else{
+            std::cout << "Could not find u_LoopTileSize, maybe a mispelling?\n";
+            exit(EXIT_FAILURE);
+        }
+
+        // Wrap in double before dropping to float so the phase stays exact
+        double period = gWaveLoopCache->settings().period;
+        double seconds = snapshot.time;
+        GLint u_LoopPhaseLocation = glGetUniformLocation(gLoopPipelineShaderProgram,"u_LoopPhase");
+        if(u_LoopPhaseLocation>=0){
+            glUniform1f(u_LoopPhaseLocation,static_cast<float>(std::fmod(seconds, period) / period));
+        }else{
+            std::cout << "Could not find u_LoopPhase, maybe a mispelling?\n";
+            exit(EXIT_FAILURE);
+        }
     }
 
-    GLint u_GerstnerWaveSpeedLocation1= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[1].speed");
-    if(u_GerstnerWaveSpeedLocation1>=0){
-        glUniform1f(u_GerstnerWaveSpeedLocation1,0.3f);
+    // View and projection come from FrameUniforms
+    gGLState.UseProgram(gSkyboxPipelineShaderProgram);
+
+    // Retrieve our location of our texture sampler uniform 
+    GLint u_SkyboxTextureSamplerLocation = glGetUniformLocation(gSkyboxPipelineShaderProgram,"skybox");
+    if(u_SkyboxTextureSamplerLocation>=0){
+        glUniform1i(u_SkyboxTextureSamplerLocation,0);
     }else{
-        std::cout << "Could not find gerstner_waves[1].speed, maybe a mispelling?\n";
+        std::cout << "Could not find skybox, maybe a mispelling?\n";
         exit(EXIT_FAILURE);
     }
+}
 
-    // Wave 2 -----------------------------------
-    GLint u_GerstnerWaveDirectionLocation2= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[2].direction");
-    if(u_GerstnerWaveDirectionLocation2>=0){
-        glUniform2f(u_GerstnerWaveDirectionLocation2,glm::sin(1.0f), glm::cos(1.0f));
+
+/**
+* Ocean pass of the frame graph, draws the patches of the current ocean mode
+*
+* @return void
+*/
+void DrawOcean(){
+    PROFILE_ZONE("DrawOcean");
+    if(gOceanMode == OceanMode::FFT){
+        gGLState.UseProgram(gFFTPipelineShaderProgram);
+        gGLState.BindTexture(1, GL_TEXTURE_2D, gFFTDisplacementTexId);
+        gGLState.BindTexture(2, GL_TEXTURE_2D, gFFTNormalTexId);
+    }else if(gOceanMode == OceanMode::Loop){
+        gGLState.UseProgram(gLoopPipelineShaderProgram);
+        gGLState.BindTexture(1, GL_TEXTURE_3D, gLoopDisplacementTexId);
+        gGLState.BindTexture(2, GL_TEXTURE_3D, gLoopNormalTexId);
     }else{
-        std::cout << "Could not find gerstner_waves[2].direction, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+        gGLState.UseProgram(gGraphicsPipelineShaderProgram);
+        gGLState.BindTexture(3, GL_TEXTURE_2D, gDetailNormalTexId);
+        gGLState.BindTexture(4, GL_TEXTURE_BUFFER, gWaveTexId);
     }
+    // Enable our attributes
+	gGLState.BindVertexArray(gVertexArrayObjectFloor);
 
-    GLint u_GerstnerWaveAmplitudeLocation2= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[2].amplitude");
-    if(u_GerstnerWaveAmplitudeLocation2>=0){
-        glUniform1f(u_GerstnerWaveAmplitudeLocation2,1.25f);
-    }else{
-        std::cout << "Could not find gerstner_waves[2].amplitude, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    // Set texture data
+    // glActiveTexture(GL_TEXTURE0);
+    // glBindTexture(GL_TEXTURE_2D, gTexId);
+
+    // Set skybox texture map
+    gGLState.BindTexture(0, GL_TEXTURE_CUBE_MAP, gCubeTexId);
+
+    //Render data
+    glDrawArrays(GL_PATCHES,0,gFloorTriangles);
+}
+
+/**
+* Bodies pass of the frame graph, one instanced draw of every floating body
+*
+* @return void
+*/
+void DrawBodies(){
+    PROFILE_ZONE("DrawBodies");
+    if(gOceanMode != OceanMode::Gerstner){
+        return;
     }
+    gGLState.UseProgram(gBodyPipelineShaderProgram);
+    gGLState.BindVertexArray(gVertexArrayObjectBodies);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<GLsizei>(gBuoyancySystem->size()));
+}
+
+/**
+* Skybox pass of the frame graph, its pass state asks for GL_LEQUAL so the
+* cube drawn at the far plane passes where the ocean left the depth cleared
+*
+* @return void
+*/
+void DrawSkybox(){
+    PROFILE_ZONE("DrawSkybox");
+    gGLState.UseProgram(gSkyboxPipelineShaderProgram);
+    // skybox cube
+    gGLState.BindVertexArray(gVertexArrayObjectSkybox);
+    gGLState.BindTexture(0, GL_TEXTURE_CUBE_MAP, gCubeTexId);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+
+    // The skybox program and vertex array stay bound, gGLState knows about
+    // them so there is nothing to gain from unbinding here
+}
 
-    GLint u_GerstnerWaveSteepnessLocation2= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[2].steepness");
-    if(u_GerstnerWaveSteepnessLocation2>=0){
-        glUniform1f(u_GerstnerWaveSteepnessLocation2,1.3f);
+/**
+* Upscale pass of the frame graph, draws the scene target over the whole
+* window with a sharpening filter
+*
+* @return void
+*/
+void DrawUpscale(){
+    PROFILE_ZONE("DrawUpscale");
+    gGLState.UseProgram(gUpscalePipelineShaderProgram);
+    // The wireframe toggle is for the ocean, not for this triangle
+    gGLState.PolygonMode(GL_FILL);
+    gGLState.BindVertexArray(gVertexArrayObjectFullscreen);
+    // Texture units: 0 skybox, 1 and 2 ocean maps, 3 detail normals, 4 scene
+    gGLState.BindTexture(4, GL_TEXTURE_2D, gFrameGraph->GetTexture(gSceneTarget));
+
+    GLint u_SceneLocation = glGetUniformLocation(gUpscalePipelineShaderProgram,"u_Scene");
+    if(u_SceneLocation>=0){
+        glUniform1i(u_SceneLocation,4);
     }else{
-        std::cout << "Could not find gerstner_waves[2].steepness, maybe a mispelling?\n";
+        std::cout << "Could not find u_Scene, maybe a mispelling?\n";
         exit(EXIT_FAILURE);
     }
 
-    GLint u_GerstnerWaveFrequencyLocation2= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[2].frequency");
-    if(u_GerstnerWaveFrequencyLocation2>=0){
-        glUniform1f(u_GerstnerWaveFrequencyLocation2,4.0f);
+    GLint u_SharpnessLocation = glGetUniformLocation(gUpscalePipelineShaderProgram,"u_Sharpness");
+    if(u_SharpnessLocation>=0){
+        glUniform1f(u_SharpnessLocation,gSharpness);
     }else{
-        std::cout << "Could not find gerstner_waves[2].frequency, maybe a mispelling?\n";
+        std::cout << "Could not find u_Sharpness, maybe a mispelling?\n";
         exit(EXIT_FAILURE);
     }
 
-    GLint u_GerstnerWaveSpeedLocation2= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[2].speed");
-    if(u_GerstnerWaveSpeedLocation2>=0){
-        glUniform1f(u_GerstnerWaveSpeedLocation2,4.0f);
-    }else{
-        std::cout << "Could not find gerstner_waves[2].speed, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+/**
+* Declares the passes of a frame. The ocean is drawn first so that the
+* skybox only shades the pixels the ocean left empty. With dynamic
+* resolution both go into gSceneTarget and an upscale pass fills the window
+*
+* @return void
+*/
+void FrameGraphSpecification(){
+    PROFILE_ZONE("FrameGraphSpecification");
+    gFrameGraph = new FrameGraph(gGLState);
+    // Headless frames are drawn into the offscreen framebuffer instead of the window
+    gFrameGraph->SetBackbuffer(BackbufferDescription(),
+                               gHeadlessContext != nullptr ? gHeadlessContext->getFramebuffer() : 0);
+
+    RenderTargetHandle sceneTarget = FrameGraph::kBackbuffer;
+    // ParseCommandLine turns dynamic resolution off next to the governor
+    if(gUseQualityGovernor){
+        gQualityGovernor = new QualityGovernor(gQualityGovernorSettings);
+    }else if(gUseDynamicResolution){
+        gDynamicResolution = new DynamicResolution(gDynamicResolutionSettings);
+    }
+    if(gUseDynamicResolution || gUseQualityGovernor){
+        gSceneTarget = gFrameGraph->CreateTarget(SceneTargetDescription());
+        sceneTarget = gSceneTarget;
     }
 
-    // Wave 3 -----------------------------------
-    GLint u_GerstnerWaveDirectionLocation3= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[3].direction");
-    if(u_GerstnerWaveDirectionLocation3>=0){
-        glUniform2f(u_GerstnerWaveDirectionLocation3,glm::sin(0.5f), glm::cos(0.5f));
-    }else{
-        std::cout << "Could not find gerstner_waves[3].direction, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    RenderPass ocean;
+    ocean.name = "ocean";
+    ocean.target = sceneTarget;
+    ocean.state.depthFunc = GL_LESS;
+    ocean.execute = DrawOcean;
+    gFrameGraph->AddPass(ocean);
+
+    if(gBuoyancySystem != nullptr){
+        RenderPass bodies;
+        bodies.name = "bodies";
+        bodies.target = sceneTarget;
+        bodies.state.depthFunc = GL_LESS;
+        bodies.execute = DrawBodies;
+        gFrameGraph->AddPass(bodies);
     }
 
-    GLint u_GerstnerWaveAmplitudeLocation3= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[3].amplitude");
-    if(u_GerstnerWaveAmplitudeLocation3>=0){
-        glUniform1f(u_GerstnerWaveAmplitudeLocation3,6.0f);
-    }else{
-        std::cout << "Could not find gerstner_waves[3].amplitude, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    RenderPass skybox;
+    skybox.name = "skybox";
+    skybox.target = sceneTarget;
+    // Depth test passes when values are equal to depth buffer's content
+    skybox.state.depthFunc = GL_LEQUAL;
+    skybox.execute = DrawSkybox;
+    gFrameGraph->AddPass(skybox);
+
+    if(sceneTarget != FrameGraph::kBackbuffer){
+        RenderPass upscale;
+        upscale.name = "upscale";
+        upscale.target = FrameGraph::kBackbuffer;
+        upscale.reads.push_back(gSceneTarget);
+        // Every pixel is overwritten, depth is not needed
+        upscale.state.depthTest = false;
+        upscale.state.depthWrite = false;
+        upscale.execute = DrawUpscale;
+        gFrameGraph->AddPass(upscale);
     }
 
-    GLint u_GerstnerWaveSteepnessLocation3= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[3].steepness");
-    if(u_GerstnerWaveSteepnessLocation3>=0){
-        glUniform1f(u_GerstnerWaveSteepnessLocation3,2.5f);
-    }else{
-        std::cout << "Could not find gerstner_waves[3].steepness, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    gFrameGraph->Compile();
+    gFrameGraph->PrintSchedule();
+
+    // Dynamic resolution and the governor are driven by the pass times
+    if(gGPUProfile || gUseDynamicResolution || gUseQualityGovernor){
+        gGPUProfiler = new GPUProfiler();
+        if(!gGPUProfileCsv.empty() && !gGPUProfiler->OpenCsv(gGPUProfileCsv)){
+            std::cout << "Could not open " << gGPUProfileCsv << " for writing\n";
+            exit(EXIT_FAILURE);
+        }
+        gFrameGraph->SetProfiler(gGPUProfiler);
     }
+}
 
-    GLint u_GerstnerWaveFrequencyLocation3= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[3].frequency");
-    if(u_GerstnerWaveFrequencyLocation3>=0){
-        glUniform1f(u_GerstnerWaveFrequencyLocation3,2.0f);
-    }else{
-        std::cout << "Could not find gerstner_waves[3].frequency, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+/**
+* Prints the rolling GPU time of each pass once a second and shows it in
+* the window title
+*
+* @return void
+*/
+void ReportGPUProfile(){
+    static Uint32 lastReport = SDL_GetTicks();
+    Uint32 now = SDL_GetTicks();
+    if(now - lastReport < 1000){
+        return;
     }
+    lastReport = now;
 
-    GLint u_GerstnerWaveSpeedLocation3= glGetUniformLocation( gGraphicsPipelineShaderProgram,"gerstner_waves[3].speed");
-    if(u_GerstnerWaveSpeedLocation3>=0){
-        glUniform1f(u_GerstnerWaveSpeedLocation3,1.0f);
-    }else{
-        std::cout << "Could not find gerstner_waves[3].speed, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    std::string summary = gGPUProfiler->Summary();
+    std::cout << summary << "\n";
+    if(gGraphicsApplicationWindow == nullptr){
+        return;
     }
+    SDL_SetWindowTitle(gGraphicsApplicationWindow, ("Wave simulation | " + summary).c_str());
+}
 
-    glUseProgram(gSkyboxPipelineShaderProgram);
+/**
+* Rolling GPU time of every pass of the frame, whichever passes the frame graph has
+*
+* @return milliseconds
+*/
+double GPUFrameMs(){
+    return gGPUProfiler->TotalAverage();
+}
 
-    // Update the View Matrix
-    GLint u_SkyboxViewMatrixLocation = glGetUniformLocation(gSkyboxPipelineShaderProgram,"view");
-    if(u_SkyboxViewMatrixLocation>=0){
-        glm::mat4 viewMatrix = glm::mat4(glm::mat3(gCamera.GetViewMatrix()));
-        glUniformMatrix4fv(u_SkyboxViewMatrixLocation,1,GL_FALSE,&viewMatrix[0][0]);
-    }else{
-        std::cout << "Could not find view, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+/**
+* Feeds the CPU time of the frame and the rolling GPU time to
+* gQualityGovernor, applies and logs the level it changes to
+*
+* @param cpuMs Milliseconds from the start of the frame to just before the swap
+* @return void
+*/
+void UpdateQualityGovernor(double cpuMs){
+    if(gQualityGovernor == nullptr){
+        return;
     }
-
-    // Retrieve our location of our perspective matrix uniform 
-    GLint u_SkyboxProjectionLocation= glGetUniformLocation(gSkyboxPipelineShaderProgram,"projection");
-    if(u_SkyboxProjectionLocation>=0){
-        glUniformMatrix4fv(u_SkyboxProjectionLocation,1,GL_FALSE,&perspective[0][0]);
-    }else{
-        std::cout << "Could not find projection, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    int previous = gQualityGovernor->getLevelIndex();
+    if(!gQualityGovernor->Update(cpuMs, GPUFrameMs())){
+        return;
     }
+    const QualityLevel& level = gQualityGovernor->getLevel();
+    RenderTargetDesc scene = SceneTargetDescription();
+    gFrameGraph->ResizeTarget(gSceneTarget, scene.width, scene.height);
+    std::cout << "Quality level " << previous << " -> " << gQualityGovernor->getLevelIndex()
+              << " at frame " << gSimulation->Latest().frame << ": tessellation x" << level.tessScale
+              << ", up to " << WaveQuarters(level.maxWaves) << " waves, render scale " << level.renderScale
+              << " (" << scene.width << "x" << scene.height << "). Reason: " << gQualityGovernor->getReason() << "\n";
+}
 
-    // Retrieve our location of our texture sampler uniform 
-    GLint u_SkyboxTextureSamplerLocation = glGetUniformLocation(gSkyboxPipelineShaderProgram,"skybox");
-    if(u_SkyboxTextureSamplerLocation>=0){
-        glUniform1i(u_SkyboxTextureSamplerLocation,0);
-    }else{
-        std::cout << "Could not find skybox, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+/**
+* Feeds the rolling GPU time of the frame to gDynamicResolution and resizes
+* the scene target when it picks another scale
+*
+* @return void
+*/
+void UpdateDynamicResolution(){
+    double gpuMs = GPUFrameMs();
+    if(!gDynamicResolution->Update(gpuMs)){
+        return;
     }
+    RenderTargetDesc scene = SceneTargetDescription();
+    gFrameGraph->ResizeTarget(gSceneTarget, scene.width, scene.height);
+    std::cout << "Render scale " << gDynamicResolution->getScale() << " (" << scene.width << "x" << scene.height
+              << ") for " << gpuMs << " ms of GPU time\n";
 }
 
-
 /**
 * Draw
 * The render function gets called once per loop.
-* Typically this includes 'glDraw' related calls, and the relevant setup of buffers
-* for those calls.
+* Runs the passes of gFrameGraph in the order it compiled them.
 *
 * @return void
 */
 void Draw(){
-    glUseProgram(gGraphicsPipelineShaderProgram);
-    // Enable our attributes
-	glBindVertexArray(gVertexArrayObjectFloor);
-
-    // Set texture data
-    // glActiveTexture(GL_TEXTURE0);
-    // glBindTexture(GL_TEXTURE_2D, gTexId);
-
-    // Set skybox texture map
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, gCubeTexId);
-
-    //Render data
-    glDrawArrays(GL_PATCHES,0,gFloorTriangles);
-
-    // draw skybox as last
-    glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-    glUseProgram(gSkyboxPipelineShaderProgram);
-    // skybox cube
-    glBindVertexArray(gVertexArrayObjectSkybox);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, gCubeTexId);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-    glDepthFunc(GL_LESS); // set depth function back to default
-
-	// Stop using our current graphics pipeline
-	// Note: This is not necessary if we only have one graphics pipeline.
-    glUseProgram(0);
+    PROFILE_ZONE("Draw");
+    if(gGPUProfiler != nullptr){
+        gGPUProfiler->BeginFrame();
+    }
+    gFrameGraph->Execute();
+    // The GPU is done with this frame's uniforms once the fence passes
+    gFrameUniformRing->Fence();
+    if(gGPUProfile){
+        ReportGPUProfile();
+    }
+    if(gDynamicResolution != nullptr){
+        UpdateDynamicResolution();
+    }
 }
 
 /**
@@ -947,12 +2632,58 @@ void getOpenGLVersionInfo(){
 }
 
 
+/**
+* Seconds on the clock input events are timestamped with.
+*
+* @return seconds since the first call
+*/
+double InputClock(){
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+* Moves an SDL event timestamp (milliseconds on SDL_GetTicks()) onto InputClock().
+*
+* @param timestamp Timestamp of the event
+* @return seconds on InputClock()
+*/
+double EventTime(Uint32 timestamp){
+    // Unsigned, so this also holds across the wrap of SDL_GetTicks()
+    Uint32 age = SDL_GetTicks() - timestamp;
+    return InputClock() - std::min(age, Uint32(1000)) * 1e-3;
+}
+
+/**
+* Pumps the window's events into SDL's queue if 1 / gInputRate seconds have
+* passed since the last time, which is when SDL timestamps them. The frame
+* calls this between its stages and while it waits, Input() then handles the
+* queued events at the start of the next frame with their own times. SDL
+* only pumps events on the thread that made the window, so this stays on it.
+*
+* @return void
+*/
+void PumpInput(){
+    static double nextPump = 0.0;
+    if(gHeadless || gInputRate <= 0.0){
+        return;
+    }
+    double now = InputClock();
+    if(now < nextPump){
+        return;
+    }
+    nextPump = now + 1.0 / gInputRate;
+    PROFILE_ZONE("PumpInput");
+    SDL_PumpEvents();
+}
+
 /**
 * Function called in the Main application loop to handle user input
 *
 * @return void
 */
 void Input(){
+    PROFILE_ZONE("Input");
     // Two static variables to hold the mouse position
     static int mouseX=gScreenWidth/2;
     static int mouseY=gScreenHeight/2; 
@@ -972,6 +2703,16 @@ void Input(){
 			std::cout << "ESC: Goodbye! (Leaving MainApplicationLoop())" << std::endl;
             gQuit = true;
         }
+        if(e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_h){
+            std::cout << gFrameStats.Summary() << "\n";
+        }
+        // Held keys repeat, only the first press counts
+        if(e.type == SDL_KEYDOWN && !e.key.repeat){
+            gInputTimeline.Press(e.key.keysym.scancode, EventTime(e.key.timestamp));
+        }
+        if(e.type == SDL_KEYUP){
+            gInputTimeline.Release(e.key.keysym.scancode, EventTime(e.key.timestamp));
+        }
         if(e.type==SDL_MOUSEMOTION){
             // Capture the change in the mouse position
             mouseX+=e.motion.xrel;
@@ -982,6 +2723,11 @@ void Input(){
             if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
                 gScreenWidth = e.window.data1;
                 gScreenHeight = e.window.data2;
+                gFrameGraph->SetBackbuffer(BackbufferDescription());
+                if(gSceneTarget != FrameGraph::kBackbuffer){
+                    RenderTargetDesc scene = SceneTargetDescription();
+                    gFrameGraph->ResizeTarget(gSceneTarget, scene.width, scene.height);
+                }
             }
         }
 	}
@@ -1000,30 +2746,50 @@ void Input(){
     // }
 
     // Camera
-    // Update our position of the camera
-    if (state[SDL_SCANCODE_W]) {
-        gCamera.MoveForward(0.1f);
+    // Update our position of the camera by how long each key was held since
+    // the last frame, so neither the frame rate nor a hitch changes the distance
+    double now = InputClock();
+    float forward = static_cast<float>(gInputTimeline.HeldTime(SDL_SCANCODE_W, now) -
+                                       gInputTimeline.HeldTime(SDL_SCANCODE_S, now));
+    float right = static_cast<float>(gInputTimeline.HeldTime(SDL_SCANCODE_D, now) -
+                                     gInputTimeline.HeldTime(SDL_SCANCODE_A, now));
+    gInputTimeline.EndWindow(now);
+    if (forward > 0.0f) {
+        gCamera.MoveForward(gCameraSpeed * forward);
     }
-    if (state[SDL_SCANCODE_S]) {
-        gCamera.MoveBackward(0.1f);
+    if (forward < 0.0f) {
+        gCamera.MoveBackward(-gCameraSpeed * forward);
     }
-    if (state[SDL_SCANCODE_A]) {
-        gCamera.MoveLeft(0.1f);
+    if (right < 0.0f) {
+        gCamera.MoveLeft(-gCameraSpeed * right);
     }
-    if (state[SDL_SCANCODE_D]) {
-        gCamera.MoveRight(0.1f);
+    if (right > 0.0f) {
+        gCamera.MoveRight(gCameraSpeed * right);
     }
     if (state[SDL_SCANCODE_1]) {
-        num_of_waves = 1;
+        num_of_waves = WaveQuarters(1);
     }
     if (state[SDL_SCANCODE_2]) {
-        num_of_waves = 2;
+        num_of_waves = WaveQuarters(2);
     }
     if (state[SDL_SCANCODE_3]) {
-        num_of_waves = 3;
+        num_of_waves = WaveQuarters(3);
     }
     if (state[SDL_SCANCODE_4]) {
-        num_of_waves = 4;
+        num_of_waves = WaveQuarters(4);
+    }
+    // The simulation step reads the waves and the clock, so it has to finish first
+    if (state[SDL_SCANCODE_UP]) {
+        SDL_Delay(250);
+        gSeaState.windSpeed += 1.0f;
+        gSimulation->WaitIdle();
+        ApplySeaState();
+    }
+    if (state[SDL_SCANCODE_DOWN]) {
+        SDL_Delay(250);
+        gSeaState.windSpeed = std::max(1.0f, gSeaState.windSpeed - 1.0f);
+        gSimulation->WaitIdle();
+        ApplySeaState();
     }
     if (state[SDL_SCANCODE_RIGHT]) {
         chosenEnvironment++;
@@ -1038,6 +2804,27 @@ void Input(){
         loadCubemap(cubemapFaces[chosenEnvironment]);
     }
 
+    if (state[SDL_SCANCODE_F]) {
+        SDL_Delay(250); // Same trick as for the wireframe toggle below
+        if(gOceanMode == OceanMode::Gerstner){
+            gOceanMode = OceanMode::FFT;
+            std::cout << "Ocean mode: FFT\n";
+        }else if(gOceanMode == OceanMode::FFT){
+            gOceanMode = OceanMode::Loop;
+            std::cout << "Ocean mode: baked loop\n";
+        }else{
+            gOceanMode = OceanMode::Gerstner;
+            std::cout << "Ocean mode: Gerstner\n";
+        }
+    }
+
+    if (state[SDL_SCANCODE_P]) {
+        SDL_Delay(250); // Same trick as for the wireframe toggle below
+        gSimulation->WaitIdle();
+        gSimulationClock.TogglePaused();
+        std::cout << (gSimulationClock.isPaused() ? "Simulation paused\n" : "Simulation resumed\n");
+    }
+
     if (state[SDL_SCANCODE_TAB]) {
         SDL_Delay(250); // This is hacky in the name of simplicity,
                        // but we just delay the
@@ -1052,6 +2839,44 @@ void Input(){
 }
 
 
+/**
+* Ends a frame: sleeps until gFrameRateCap allows the next one and records
+* the time since the previous frame ended in gFrameStats.
+*
+* @return void
+*/
+void EndFrame(){
+    typedef std::chrono::steady_clock Clock;
+    static Clock::time_point nextFrame = Clock::now();
+    static Clock::time_point lastFrame;
+    static bool firstFrame = true;
+
+    if(gFrameRateCap > 0.0){
+        PROFILE_ZONE("FrameCap");
+        nextFrame += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / gFrameRateCap));
+        // A late frame starts the schedule over instead of rushing the next ones
+        if(nextFrame < Clock::now()){
+            nextFrame = Clock::now();
+        }else if(gHeadless || gInputRate <= 0.0){
+            std::this_thread::sleep_until(nextFrame);
+        }else{
+            // Keeps pumping input while it waits
+            Clock::duration slice = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / gInputRate));
+            for(Clock::time_point now = Clock::now(); now < nextFrame; now = Clock::now()){
+                std::this_thread::sleep_until(std::min(nextFrame, now + slice));
+                PumpInput();
+            }
+        }
+    }
+
+    Clock::time_point now = Clock::now();
+    if(!firstFrame){
+        gFrameStats.Record(std::chrono::duration<double, std::milli>(now - lastFrame).count());
+    }
+    firstFrame = false;
+    lastFrame = now;
+}
+
 /**
 * Main Application Loop
 * This is an infinite loop in our graphics application
@@ -1070,24 +2895,70 @@ void MainLoop(){
 
 	// While application is running
 	while(!gQuit){
+		PROFILE_ZONE("Frame");
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
 		// Handle Input
 		Input();
+		// Everything this frame draws comes from one snapshot, the next
+		// one is simulated while this one is submitted
+		bool fresh = AcquireSnapshot();
 		// Setup anything (i.e. OpenGL State) that needs to take
 		// place before draw calls
-		PreDraw();
+		PreDraw(gSimulation->Latest(), fresh);
+		// Events that came in during the CPU work get timestamps from here
+		// on instead of waiting for the next frame
+		PumpInput();
 		// Draw Calls in OpenGL
         // When we 'draw' in OpenGL, this activates the graphics pipeline.
         // i.e. when we use glDrawElements or glDrawArrays,
         //      The pipeline that is utilized is whatever 'glUseProgram' is
         //      currently binded.
 		Draw();
+		PumpInput();
+		// Swap and frame cap waits are not part of what the frame costs
+		UpdateQualityGovernor(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
 
 		//Update screen of our specified window
-		SDL_GL_SwapWindow(gGraphicsApplicationWindow);
+		{
+			PROFILE_ZONE("SDL_GL_SwapWindow");
+			SDL_GL_SwapWindow(gGraphicsApplicationWindow);
+		}
+		EndFrame();
 	}
 }
 
 
+/**
+* Headless Application Loop
+* Draws gHeadlessFrames frames without input or a window and saves the
+* frames in gCaptureFrames as PPM images.
+*
+* @return void
+*/
+void HeadlessLoop(){
+    for(int frame = 1; frame <= gHeadlessFrames; ++frame){
+        PROFILE_ZONE("Frame");
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        bool fresh = AcquireSnapshot();
+        PreDraw(gSimulation->Latest(), fresh);
+        Draw();
+        UpdateQualityGovernor(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+
+        bool capture = gCaptureFrames.empty()
+                       ? frame == gHeadlessFrames
+                       : std::find(gCaptureFrames.begin(), gCaptureFrames.end(), frame) != gCaptureFrames.end();
+        if(capture){
+            PROFILE_ZONE("Capture");
+            std::string number = std::to_string(frame);
+            std::string fileName = gCapturePrefix + "_" + std::string(number.size() < 4 ? 4 - number.size() : 0, '0')
+                                   + number + ".ppm";
+            gHeadlessContext->Capture().savePPM(fileName);
+            std::cout << "Saved frame " << frame << " to " << fileName << "\n";
+        }
+        EndFrame();
+    }
+}
+
 
 /**
 * The last function called in the program
@@ -1097,6 +2968,26 @@ void MainLoop(){
 * @return void
 */
 void CleanUp(){
+    // The last requested step runs to the end, it still uses the jobs
+    delete gSimulation;
+    gSimulation = nullptr;
+    // No job may still run, or record zones, once the trace is written and
+    // the objects below are deleted
+    JobSystem::Shutdown();
+    if(!gTraceFile.empty()){
+        if(Profiler::WriteChromeTrace(gTraceFile)){
+            std::cout << "Wrote the CPU trace to " << gTraceFile << " (open it in chrome://tracing or Perfetto)\n";
+        }else{
+            std::cout << "Could not write the CPU trace to " << gTraceFile << "\n";
+        }
+    }
+    std::cout << gFrameStats.Summary() << "\n";
+    gGLState.PrintStats();
+    if(gGPUProfiler != nullptr){
+        std::cout << gGPUProfiler->Summary() << " (" << gGPUProfiler->getDropped()
+                  << " results not ready in time)\n";
+    }
+
 	//Destroy our SDL2 Window
 	SDL_DestroyWindow(gGraphicsApplicationWindow );
 	gGraphicsApplicationWindow = nullptr;
@@ -1106,41 +2997,383 @@ void CleanUp(){
     glDeleteVertexArrays(1, &gVertexArrayObjectFloor);
     glDeleteBuffers(1, &gVertexBufferObjectSkybox);
     glDeleteVertexArrays(1, &gVertexArrayObjectSkybox);
+    glDeleteVertexArrays(1, &gVertexArrayObjectFullscreen);
+    glDeleteBuffers(1, &gVertexBufferObjectBodyInstances);
+    glDeleteVertexArrays(1, &gVertexArrayObjectBodies);
 
 	// Delete our Graphics pipeline
     glDeleteProgram(gGraphicsPipelineShaderProgram);
     glDeleteProgram(gSkyboxPipelineShaderProgram);
+    glDeleteProgram(gFFTPipelineShaderProgram);
+    glDeleteProgram(gUpscalePipelineShaderProgram);
+    glDeleteProgram(gBodyPipelineShaderProgram);
+
+    // Delete the FFT ocean and its maps
+    glDeleteTextures(1, &gFFTDisplacementTexId);
+    glDeleteTextures(1, &gFFTNormalTexId);
+    delete gFFTOcean;
+    gFFTOcean = nullptr;
+
+    // Delete the baked loop
+    glDeleteProgram(gLoopPipelineShaderProgram);
+    glDeleteTextures(1, &gLoopDisplacementTexId);
+    glDeleteTextures(1, &gLoopNormalTexId);
+    delete gWaveLoopCache;
+    gWaveLoopCache = nullptr;
+
+    // Delete the gerstner wave buffer
+    glDeleteTextures(1, &gWaveTexId);
+    glDeleteBuffers(1, &gWaveBufferObject);
+
+    // Delete the detail normal map
+    glDeleteTextures(1, &gDetailNormalTexId);
+    delete gDetailNormalMap;
+    gDetailNormalMap = nullptr;
+    delete gBuoyancySystem;
+    gBuoyancySystem = nullptr;
+    delete gFrameGraph;
+    gFrameGraph = nullptr;
+    delete gFrameUniformRing;
+    gFrameUniformRing = nullptr;
+    delete gGPUProfiler;
+    gGPUProfiler = nullptr;
+    delete gDynamicResolution;
+    gDynamicResolution = nullptr;
+    delete gQualityGovernor;
+    gQualityGovernor = nullptr;
+    // Last, the context has to outlive every OpenGL object
+    delete gHeadlessContext;
+    gHeadlessContext = nullptr;
 
 	//Quit SDL subsystems
 	SDL_Quit();
 }
 
 
+/**
+* Reads the command line options into the matching globals.
+* Unknown options are reported and ignored.
+*
+* @param argc Number of arguments
+* @param args Arguments, args[0] is the program name
+* @return void
+*/
+void ParseCommandLine(int argc, char* args[]){
+    for(int i = 1; i < argc; ++i){
+        std::string option = args[i];
+        bool hasValue = (i + 1 < argc);
+
+        // A value that does not parse leaves the option at its default
+        try{
+            if(option == "--ocean" && hasValue){
+                std::string mode = args[++i];
+                if(mode == "fft"){
+                    gOceanMode = OceanMode::FFT;
+                }else if(mode == "loop"){
+                    gOceanMode = OceanMode::Loop;
+                }else{
+                    gOceanMode = OceanMode::Gerstner;
+                }
+            }else if(option == "--fft-resolution" && hasValue){
+                gFFTOceanSettings.resolution = std::stoi(args[++i]);
+            }else if(option == "--fft-spectrum" && hasValue){
+                std::string spectrum = args[++i];
+                gFFTOceanSettings.spectrum = (spectrum == "jonswap") ? OceanSpectrum::JONSWAP : OceanSpectrum::Phillips;
+            }else if(option == "--fft-threads" && hasValue){
+                gFFTOceanSettings.threadCount = std::stoi(args[++i]);
+            }else if(option == "--fft-benchmark"){
+                gRunFFTBenchmark = true;
+            }else if(option == "--verify-waves"){
+                gVerifyWaves = true;
+            }else if(option == "--wave-benchmark"){
+                gRunWaveBenchmark = true;
+            }else if(option == "--surface-query-benchmark"){
+                gRunSurfaceQueryBenchmark = true;
+            }else if(option == "--surface-query-threads" && hasValue){
+                gSurfaceQuerySettings.threadCount = std::stoi(args[++i]);
+            }else if(option == "--surface-query-budget-ms" && hasValue){
+                gSurfaceQuerySettings.budgetMs = std::stod(args[++i]);
+            }else if(option == "--bodies" && hasValue){
+                gBodyCount = std::max(0, std::stoi(args[++i]));
+            }else if(option == "--body-batch" && hasValue){
+                gBuoyancySettings.batchSize = std::stoi(args[++i]);
+            }else if(option == "--body-threads" && hasValue){
+                gBuoyancySettings.threadCount = std::stoi(args[++i]);
+            }else if(option == "--buoyancy-benchmark"){
+                gRunBuoyancyBenchmark = true;
+            }else if(option == "--wind-speed" && hasValue){
+                gSeaState.windSpeed = std::stof(args[++i]);
+                gUseSeaState = true;
+            }else if(option == "--wind-direction" && hasValue){
+                float angle = glm::radians(std::stof(args[++i]));
+                gSeaState.windDirection = glm::vec2(std::cos(angle), std::sin(angle));
+                gUseSeaState = true;
+            }else if(option == "--fetch" && hasValue){
+                gSeaState.fetch = std::stof(args[++i]);
+                gUseSeaState = true;
+            }else if(option == "--wave-spectrum" && hasValue){
+                std::string spectrum = args[++i];
+                gSeaState.spectrum = (spectrum == "pm") ? WindSeaSpectrum::PiersonMoskowitz : WindSeaSpectrum::JONSWAP;
+                gUseSeaState = true;
+            }else if(option == "--wave-count" && hasValue){
+                gSeaState.waveCount = std::stoi(args[++i]);
+                gUseSeaState = true;
+            }else if(option == "--min-wavelength" && hasValue){
+                gSeaState.minWavelength = std::stof(args[++i]);
+                gUseSeaState = true;
+            }else if(option == "--choppiness" && hasValue){
+                gSeaState.choppiness = std::stof(args[++i]);
+                gUseSeaState = true;
+            }else if(option == "--wave-seed" && hasValue){
+                gSeaState.seed = static_cast<unsigned int>(std::stoul(args[++i]));
+                gUseSeaState = true;
+            }else if(option == "--spectrum-benchmark"){
+                gRunSpectrumBenchmark = true;
+            }else if(option == "--time-offset" && hasValue){
+                gSimulationClock.SetTime(std::stod(args[++i]));
+            }else if(option == "--clock" && hasValue){
+                std::string mode = args[++i];
+                gSimulationClock.SetMode(mode == "fixed" ? ClockMode::FixedStep : ClockMode::RealTime,
+                                         gSimulationClock.getStep());
+            }else if(option == "--fixed-step" && hasValue){
+                gSimulationClock.SetMode(ClockMode::FixedStep, std::stod(args[++i]));
+            }else if(option == "--time-scale" && hasValue){
+                gSimulationClock.SetScale(std::stod(args[++i]));
+            }else if(option == "--paused"){
+                gSimulationClock.SetPaused(true);
+            }else if(option == "--soak-test"){
+                gRunSoakTest = true;
+            }else if(option == "--verify-frame-stats"){
+                gVerifyFrameStats = true;
+            }else if(option == "--verify-input"){
+                gVerifyInput = true;
+            }else if(option == "--tess-level" && hasValue){
+                gTessLevel = std::stof(args[++i]);
+            }else if(option == "--detail-tess-level" && hasValue){
+                gDetailTessLevel = std::stof(args[++i]);
+            }else if(option == "--detail-wavelength" && hasValue){
+                gDetailNormalSettings.wavelength = std::stof(args[++i]);
+            }else if(option == "--detail-resolution" && hasValue){
+                gDetailNormalSettings.resolution = std::stoi(args[++i]);
+            }else if(option == "--detail-map"){
+                gUseDetailMap = true;
+            }else if(option == "--no-detail-map"){
+                gUseDetailMap = false;
+            }else if(option == "--persistent-map"){
+                gPersistentMapping = true;
+            }else if(option == "--no-persistent-map"){
+                gPersistentMapping = false;
+            }else if(option == "--trace" && hasValue){
+                gTraceFile = args[++i];
+            }else if(option == "--job-threads" && hasValue){
+                gJobThreads = std::max(0, std::stoi(args[++i]));
+            }else if(option == "--vsync" && hasValue){
+                std::string mode = args[++i];
+                gSwapInterval = (mode == "off") ? 0 : (mode == "adaptive") ? -1 : 1;
+            }else if(option == "--fps-cap" && hasValue){
+                gFrameRateCap = std::stod(args[++i]);
+            }else if(option == "--input-rate" && hasValue){
+                gInputRate = std::stod(args[++i]);
+            }else if(option == "--sim-thread" && hasValue){
+                gUseSimulationThread = std::string(args[++i]) != "off";
+            }else if(option == "--dynamic-resolution"){
+                gUseDynamicResolution = true;
+            }else if(option == "--target-frame-ms" && hasValue){
+                gDynamicResolutionSettings.targetMs = std::stod(args[++i]);
+            }else if(option == "--min-scale" && hasValue){
+                gDynamicResolutionSettings.minScale = std::stof(args[++i]);
+            }else if(option == "--max-scale" && hasValue){
+                gDynamicResolutionSettings.maxScale = std::stof(args[++i]);
+            }else if(option == "--sharpness" && hasValue){
+                gSharpness = std::stof(args[++i]);
+            }else if(option == "--quality-governor"){
+                gUseQualityGovernor = true;
+            }else if(option == "--frame-budget-ms" && hasValue){
+                gUseQualityGovernor = true;
+                gQualityGovernorSettings.budgetMs = std::stod(args[++i]);
+            }else if(option == "--headless"){
+                gHeadless = true;
+            }else if(option == "--size" && hasValue){
+                std::string size = args[++i];
+                size_t x = size.find('x');
+                if(x != std::string::npos){
+                    int width = std::stoi(size.substr(0, x));
+                    gScreenHeight = std::stoi(size.substr(x + 1));
+                    gScreenWidth = width;
+                }
+            }else if(option == "--frames" && hasValue){
+                gHeadlessFrames = std::stoi(args[++i]);
+            }else if(option == "--capture" && hasValue){
+                std::string frames = args[++i];
+                std::vector<int> captures;
+                size_t start = 0;
+                while(start < frames.size()){
+                    size_t comma = frames.find(',', start);
+                    if(comma == std::string::npos){
+                        comma = frames.size();
+                    }
+                    captures.push_back(std::stoi(frames.substr(start, comma - start)));
+                    start = comma + 1;
+                }
+                gCaptureFrames.insert(gCaptureFrames.end(), captures.begin(), captures.end());
+            }else if(option == "--capture-prefix" && hasValue){
+                gCapturePrefix = args[++i];
+            }else if(option == "--gpu-profile"){
+                gGPUProfile = true;
+            }else if(option == "--gpu-profile-csv" && hasValue){
+                gGPUProfile = true;
+                gGPUProfileCsv = args[++i];
+            }else if(option == "--loop-resolution" && hasValue){
+                gWaveLoopSettings.resolution = std::stoi(args[++i]);
+            }else if(option == "--loop-frames" && hasValue){
+                gWaveLoopSettings.frames = std::stoi(args[++i]);
+            }else if(option == "--loop-tile" && hasValue){
+                gWaveLoopSettings.tileSize = std::stof(args[++i]);
+            }else if(option == "--loop-period" && hasValue){
+                gWaveLoopSettings.period = std::stof(args[++i]);
+            }else if(option == "--loop-cache" && hasValue){
+                gWaveLoopSettings.cacheDirectory = args[++i];
+            }else if(option == "--no-loop-cache"){
+                gWaveLoopSettings.cacheDirectory = "";
+            }else{
+                std::cout << "Unknown option: " << option << "\n";
+            }
+        }catch(const std::exception& error){
+            std::cout << "Could not read the value of " << option << " (" << error.what() << "), keeping the default\n";
+        }
+    }
+
+    // The FFT needs a power of two of at least 4
+    int resolution = gFFTOceanSettings.resolution;
+    if(resolution < 4 || (resolution & (resolution - 1)) != 0){
+        std::cout << "--fft-resolution must be a power of two >= 4, using 256\n";
+        gFFTOceanSettings.resolution = 256;
+    }
+    if(gScreenWidth < 1 || gScreenHeight < 1){
+        std::cout << "--size must be WIDTHxHEIGHT, using 640x480\n";
+        gScreenWidth = 640;
+        gScreenHeight = 480;
+    }
+    gHeadlessFrames = std::max(gHeadlessFrames, 1);
+    DynamicResolutionSettings& scaling = gDynamicResolutionSettings;
+    if(scaling.minScale <= 0.0f || scaling.minScale > scaling.maxScale || scaling.maxScale > 2.0f){
+        std::cout << "--min-scale and --max-scale must satisfy 0 < min <= max <= 2, using 0.5 and 1\n";
+        scaling.minScale = 0.5f;
+        scaling.maxScale = 1.0f;
+    }
+    if(gSimulationClock.getStep() <= 0.0){
+        std::cout << "--fixed-step must be positive, using 1/60 s\n";
+        gSimulationClock.SetMode(gSimulationClock.getMode(), 1.0 / 60.0);
+    }
+    if(gSeaState.waveCount < 1 || gSeaState.waveCount > WaveSet::kMaxWaves){
+        std::cout << "--wave-count must be 1 to " << WaveSet::kMaxWaves << ", using 64\n";
+        gSeaState.waveCount = 64;
+    }
+    if(gUseQualityGovernor && gUseDynamicResolution){
+        std::cout << "--dynamic-resolution is ignored with the quality governor, which sets the render scale itself\n";
+        gUseDynamicResolution = false;
+    }
+    if(gSeaState.windSpeed <= 0.0f || gSeaState.minWavelength <= 0.0f){
+        std::cout << "--wind-speed and --min-wavelength must be positive, using 10 m/s and 1 m\n";
+        gSeaState.windSpeed = 10.0f;
+        gSeaState.minWavelength = 1.0f;
+    }
+}
+
 /**
 * The entry point into our C++ programs.
 *
 * @return program status
 */
 int main( int argc, char* args[] ){
+    ParseCommandLine(argc, args);
+    // The benchmarks use the workers too and return straight from here, so
+    // they are also joined on the way out
+    JobSystem::Start(gJobThreads);
+    std::atexit(JobSystem::Shutdown);
+    if(gRunSpectrumBenchmark){
+        return RunSpectrumBenchmark() ? 0 : 1;
+    }
+    // Before anything copies the waves, the checks below use them too
+    if(gUseSeaState){
+        ApplySeaState();
+    }
+    if(gRunFFTBenchmark){
+        RunFFTBenchmark();
+        return 0;
+    }
+    if(gVerifyWaves){
+        bool passed = RunWaveVerification();
+        passed = RunWaveKernelVerification() && passed;
+        return passed ? 0 : 1;
+    }
+    if(gRunWaveBenchmark){
+        RunWaveBenchmark();
+        return 0;
+    }
+    if(gRunSurfaceQueryBenchmark){
+        return RunSurfaceQueryBenchmark() ? 0 : 1;
+    }
+    if(gRunBuoyancyBenchmark){
+        return RunBuoyancyBenchmark() ? 0 : 1;
+    }
+    if(gRunSoakTest){
+        return RunSoakTest() ? 0 : 1;
+    }
+    if(gVerifyFrameStats){
+        return RunFrameStatsCheck() ? 0 : 1;
+    }
+    if(gVerifyInput){
+        return RunInputTimelineCheck() ? 0 : 1;
+    }
+
+    // Zones are only recorded from here on, startup included
+    if(!gTraceFile.empty()){
+        Profiler::Enable();
+    }
+
     std::cout << "Use w and s keys to move forward and back\n";
     std::cout << "Use tab to toggle wireframe\n";
     std::cout << "Use mouse to rotate left or right\n";
     std::cout << "Press numbers 1-4 to control the number of gerstner waves\n";
+    std::cout << "Press up or down to change the wind speed of the sampled sea state\n";
+    std::cout << "Press f to cycle between the gerstner, FFT and baked loop ocean\n";
     std::cout << "Press left or right to cycle through various different environments\n";
+    std::cout << "Press p to pause or resume the waves\n";
+    std::cout << "Press h to print frame time percentiles\n";
     std::cout << "Press ESC to quit\n";
+    std::cout << "Gerstner ocean: " << OceanVertexCount(GerstnerTessLevel()) << " tessellated vertices per frame ("
+              << OceanVertexCount(gTessLevel) << " without the detail normal map)\n";
 
 	// 1. Setup the graphics program
-	InitializeProgram();
+	if(gHeadless){
+		InitializeHeadless();
+	}else{
+		InitializeProgram();
+	}
 	
 	// 2. Setup our geometry
 	VertexSpecification();
+	WaveBufferSpecification();
+	FFTOceanSpecification();
+	DetailNormalMapSpecification();
+	BodySpecification();
 	
 	// 3. Create our graphics pipeline
 	// 	- At a minimum, this means the vertex and fragment shader
 	CreateGraphicsPipeline();
+	FrameGraphSpecification();
+	// Setup binds objects directly, start the frame loop from unknown state
+	gGLState.Invalidate();
+	// Everything a simulation step touches exists from here on
+	gSimulation = new SimulationThread(SimulationStep, gUseSimulationThread);
 	
 	// 4. Call the main application loop
-	MainLoop();	
+	if(gHeadless){
+		HeadlessLoop();
+	}else{
+		MainLoop();
+	}
 
 	// 5. Call the cleanup function when our program terminates
 	CleanUp();
@@ -55,6 +55,10 @@ PPM::PPM(std::string fileName){
     }
 }
 
+// Constructor wraps 'width' x 'height' R,G,B pixels, top row first
+PPM::PPM(int width, int height, const std::vector<uint8_t>& pixelData)
+    : m_PixelData(pixelData), m_width(width), m_height(height), m_maxRange(255) {}
+
 // Destructor deletes(delete or delete[]) any memory that has been allocated
 // or otherwise calls any 'shutdown' or 'destroy' routines for this deletion
 // to occur.